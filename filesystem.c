@@ -4,485 +4,7478 @@
  * escritura, lectura, eliminación y listado de archivos.
  */
 
+#define _GNU_SOURCE                       /* memfd_create, madvise, pread/pwrite, clock_gettime */
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <stdarg.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <fnmatch.h>
+#include <signal.h>
+#include <poll.h>
+#include <stdatomic.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
 
 /* Constantes del Sistema */
 #define BLOCK_SIZE 512                    /* Tamaño de cada bloque en bytes */
 #define MAX_FILES 100                     /* Número máximo de archivos */
 #define MAX_STORAGE (1024 * 1024)         /* Almacenamiento máximo: 1 MB */
 #define MAX_BLOCKS (MAX_STORAGE / BLOCK_SIZE)  /* Número máximo de bloques: 2048 */
+#define BLOCK_STORE_SIZE ((size_t)MAX_BLOCKS * BLOCK_SIZE)  /* Bytes del almacén de bloques */
 #define MAX_FILENAME 256                  /* Longitud máxima del nombre de archivo */
 #define MAX_FILE_SIZE (1024 * 1024)       /* Tamaño máximo por archivo: 1 MB */
+#define MAX_FILE_BLOCKS (MAX_FILE_SIZE / BLOCK_SIZE)  /* Bloques máximos por archivo */
+#define BUDDY_MAX_ORDER 11                /* Orden máximo del buddy: 2^11 = 2048 bloques */
+#define NO_BLOCK UINT32_MAX               /* Índice inválido de bloque / hueco en un archivo */
+#define BLOCK_FREE 0u                     /* block_map: bloque libre y a cero */
+#define BLOCK_RESERVED UINT32_MAX         /* block_map: bloque fuera de la capacidad del volumen */
+#define EXTENT_BYTES 1024                 /* Lista de extents codificada por archivo */
+#define EXTENT_CACHE_SLOTS 4              /* Listas de bloques decodificadas en caché */
+#define NAME_INDEX_SLOTS 256              /* Huecos del índice de nombres (potencia de dos) */
+#define PARITY_GROUP 8                    /* Bloques de datos por grupo de paridad */
+#define PARITY_GROUPS (MAX_BLOCKS / PARITY_GROUP)  /* Número de grupos de paridad */
+#define IMAGE_MAGIC "SFSIMG01"            /* Firma de una imagen en disco */
+#define IMAGE_HEADER_SIZE 4096            /* Cabecera de la imagen (una página) */
+#define IMAGE_DATA_OFFSET IMAGE_HEADER_SIZE  /* Inicio de los bloques en la imagen */
+#define IMAGE_META_OFFSET (IMAGE_DATA_OFFSET + (uint64_t)MAX_BLOCKS * BLOCK_SIZE)  /* Inicio de los metadatos */
+#define MIRROR_QUEUE_LEN 4096             /* Registros pendientes máximos hacia el espejo */
+#define MIRROR_BATCH 256                  /* Registros aplicados por lote antes de sincronizar */
+#define REPL_MAGIC "SFSREPL1"             /* Firma de la instantánea de replicación */
+#define REPL_LOG_LEN 8192                 /* Registros que conserva el log de replicación */
+#define REPL_MAX_FOLLOWERS 8              /* Seguidores simultáneos */
+#define REPL_COMMIT_END 1u                /* Último registro de un comando */
+#define PAGE_SIZE_BYTES 4096              /* Página base: unidad de copia en escritura tras fork */
+#define RECLAIM_BATCH_PAGES 16            /* Páginas libres acumuladas antes de devolverlas al sistema */
+#define WATERMARK_LOW 80                  /* % del espacio físico que dispara el primer aviso */
+#define WATERMARK_HIGH 95                 /* % del espacio físico que dispara el aviso crítico */
+#define SLAB_MIN_SHIFT 6                  /* Clase de slab más pequeña: 64 bytes */
+#define SLAB_CLASSES 11                   /* Clases de 64 bytes a 64 KB (potencias de dos) */
+#define SLAB_CHUNK_SIZE (256 * 1024)      /* Memoria que se pide al sistema por vez */
+#define SLAB_CACHE_LEN 32                 /* Objetos en la caché por hilo de cada clase */
+#define SERVER_MAX_CLIENTS 64             /* Conexiones simultáneas en modo servidor */
+#define SERVER_LINE_MAX 1024              /* Longitud máxima de una línea de comando */
+#define SERVER_MAX_LOOPS 8                /* Bucles de eventos del servidor (--loops) */
+#define WATCH_QUEUE_LEN 128               /* Eventos pendientes por suscriptor (potencia de dos) */
+#define WATCH_PATTERNS 8                  /* Patrones por suscriptor */
+#define PIPE_QUEUE_LEN 256                /* Huecos de cada cola entre etapas del servidor (potencia de dos) */
+#define PIPE_BATCH 64                     /* Elementos que una etapa toma de su cola por vuelta */
+#define EXPORT_MAX_PIPES 16               /* Tuberías por EXPORT pendiente de enviar */
+#define EXPORT_PIPE_SIZE (1024 * 1024)    /* Capacidad pedida para cada tubería (F_SETPIPE_SZ) */
+#define EXPORT_MAX_PAGE (64 * 1024)       /* Página más grande con la que EXPORT evita copias */
+#define DICT_SIZE 4096                    /* Bytes máximos del diccionario compartido */
+#define DICT_MAX_FILE 4096                /* Archivos que se comprimen con el diccionario: hasta 4 KB */
+#define DICT_FILE_BLOCKS (DICT_MAX_FILE / BLOCK_SIZE)  /* Tramas por archivo comprimido */
+#define DICT_HASH_BITS 12                 /* Índice de posiciones del diccionario: 4096 listas */
+#define DICT_SAMPLE_MAX (64 * 1024)       /* Bytes de muestra para TRAINDICT */
+#define DICT_SEGMENT 32                   /* Bytes de cada tramo elegido para el diccionario */
+#define DICT_KMER 6                       /* Subcadenas que puntúan un tramo */
+#define DICT_TRAIN_BITS 16                /* Contadores de subcadenas al entrenar */
+#define LZ_MIN_MATCH 4                    /* Coincidencia más corta que se codifica */
+#define LZ_MAX_MATCH (LZ_MIN_MATCH + 127) /* Coincidencia más larga de un token */
+#define LZ_LOCAL_BITS 9                   /* Índice de posiciones dentro de la trama */
+#define LZ_CHAIN_DEPTH 16                 /* Candidatas revisadas por lista */
+#define LZ_FRAME_MAX (BLOCK_SIZE + BLOCK_SIZE / 128)  /* Trama de un bloque incompresible */
+#define LZ_SLACK 16                       /* Bytes que el decodificador copia de golpe (margen de sus buffers) */
+#define COLD_TICKS 4                      /* Pasadas del nivel frío por periodo de envejecimiento */
+#define COLD_MAX_SECONDS (7 * 24 * 3600)  /* Mayor antigüedad de --cold (y de COLDPASS en pruebas) */
+
+/* El sistema buddy requiere que el número de bloques sea potencia de dos */
+_Static_assert((MAX_BLOCKS & (MAX_BLOCKS - 1)) == 0, "MAX_BLOCKS debe ser potencia de dos");
+_Static_assert((1 << BUDDY_MAX_ORDER) == MAX_BLOCKS, "BUDDY_MAX_ORDER no coincide con MAX_BLOCKS");
+_Static_assert((PIPE_QUEUE_LEN & (PIPE_QUEUE_LEN - 1)) == 0 && PIPE_QUEUE_LEN >= PIPE_BATCH,
+               "PIPE_QUEUE_LEN debe ser potencia de dos y no menor que PIPE_BATCH");
+_Static_assert((NAME_INDEX_SLOTS & (NAME_INDEX_SLOTS - 1)) == 0 && NAME_INDEX_SLOTS >= 2 * MAX_FILES,
+               "NAME_INDEX_SLOTS debe ser potencia de dos y al menos el doble de MAX_FILES");
+
+/* Número de bloque físico: 32 bits bastan para MAX_BLOCKS */
+typedef uint32_t BlockNo;
+
+/* Políticas de asignación de bloques */
+typedef enum {
+    ALLOC_FIRST_FIT,                      /* Primer ajuste: consecutivos desde el bloque 0 */
+    ALLOC_NEXT_FIT,                       /* Siguiente ajuste: continúa desde un cursor rotatorio */
+    ALLOC_BEST_FIT,                       /* Mejor ajuste: el tramo libre más corto que sirva */
+    ALLOC_LOCALITY,                       /* Localidad: el tramo más cercano a un bloque objetivo */
+    ALLOC_BUDDY,                          /* Sistema buddy binario: extents potencia de dos alineados */
+    ALLOC_NUM_POLICIES
+} AllocPolicy;
 
-/* Estructura para representar un archivo */
+/* Interfaz de una política de asignación */
+typedef struct {
+    const char *name;                                                 /* Nombre (--policy=) */
+    size_t (*allocate)(size_t num_blocks, BlockNo *block_list, size_t goal);  /* Asignar bloques */
+    void (*release)(size_t start, size_t count);  /* Aviso al liberar un tramo, NULL si no lo necesita */
+    void (*reset)(void);                  /* Reconstruye su estado desde block_map, NULL si no tiene */
+    void (*format)(void);                 /* Estado de volumen vacío en O(1), NULL si basta reset */
+} AllocPolicyOps;
+
+/*
+ * Estructura para representar un archivo. Los bloques se guardan como
+ * lista de extents codificada (ver extents_encode) y se decodifican bajo
+ * demanda en una caché pequeña (ver file_blocks).
+ */
 typedef struct {
     char filename[MAX_FILENAME];          /* Nombre del archivo */
     size_t size;                          /* Tamaño del archivo en bytes */
-    size_t num_blocks;                    /* Número de bloques ocupados */
-    size_t blocks[MAX_BLOCKS];            /* Índices de bloques ocupados */
+    size_t num_blocks;                    /* Número de bloques lógicos del archivo */
+    uint32_t generation;                  /* Cambia con cada nueva lista de extents */
+    uint32_t format_gen;                  /* Generación del volumen al crear la entrada */
+    uint32_t extent_len;                  /* Bytes usados de extents */
+    uint32_t packed_len;                  /* Bytes comprimidos, 0 = sin comprimir */
+    uint16_t frame_end[DICT_FILE_BLOCKS]; /* Fin de cada trama (los mayores llevan una tabla en los datos) */
+    bool cold;                            /* Comprimido por el nivel frío: vuelve a bloques si se relee */
+    uint8_t extents[EXTENT_BYTES];        /* Extents en delta + varint, o las tramas si caben */
     bool in_use;                          /* Indica si la entrada está en uso */
 } FileEntry;
 
-/* Estructura principal del sistema de archivos */
+/* Lista de bloques decodificada de un archivo */
+typedef struct {
+    const FileEntry *file;                /* Entrada decodificada, NULL si el hueco está libre */
+    uint32_t generation;                  /* Generación de la entrada al decodificarla */
+    uint64_t last_use;                    /* Para reemplazar el menos usado */
+    BlockNo blocks[MAX_FILE_BLOCKS];      /* Bloques lógicos -> físicos (NO_BLOCK = hueco) */
+} ExtentCacheSlot;
+
+/*
+ * Hueco del índice de nombres. Solo guarda posiciones en file_table, sin
+ * punteros, así que el índice se guarda en la imagen y se usa tal cual
+ * al montarla.
+ */
+typedef struct {
+    uint32_t hash;                        /* FNV-1a del nombre */
+    uint16_t file;                        /* Índice en file_table + 1, 0 = hueco vacío */
+    uint32_t format_gen;                  /* Generación del volumen al insertarlo */
+} NameSlot;
+
+/*
+ * Estructura principal del sistema de archivos. FORMAT solo avanza
+ * format_gen: un bloque está ocupado si su entrada de block_map vale la
+ * generación actual, y una entrada de la tabla o del índice de nombres
+ * solo es válida si lleva la generación actual. Lo que queda de
+ * generaciones anteriores se recupera al volver a usarlo.
+ */
 typedef struct {
-    unsigned char blocks[MAX_BLOCKS][BLOCK_SIZE];  /* Bloques de almacenamiento */
-    bool block_map[MAX_BLOCKS];                    /* Mapa de bloques: true = ocupado, false = libre */
+    unsigned char (*blocks)[BLOCK_SIZE];           /* Bloques de almacenamiento (ver BlockStore) */
+    uint32_t block_map[MAX_BLOCKS];                /* Generación dueña, BLOCK_FREE o BLOCK_RESERVED */
     FileEntry file_table[MAX_FILES];               /* Tabla de archivos */
+    NameSlot name_index[NAME_INDEX_SLOTS];         /* Hash abierto de nombres -> file_table */
+    uint32_t dict_gen;                             /* Cambia con cada TRAINDICT */
+    uint32_t dict_len;                             /* Bytes del diccionario, 0 = sin diccionario */
+    unsigned char dict[DICT_SIZE];                 /* Diccionario compartido (ver TRAINDICT) */
     size_t num_files;                              /* Número de archivos actuales */
     size_t used_blocks;                            /* Número de bloques utilizados */
     size_t total_storage;                          /* Almacenamiento total utilizado */
+    AllocPolicy policy;                            /* Política de asignación activa */
+    size_t capacity_blocks;                        /* Bloques del volumen; [capacity, MAX_BLOCKS) reservados */
+    uint32_t format_gen;                           /* Generación del volumen (ver FORMAT) */
 } FileSystem;
 
-/* Variable global del sistema de archivos */
-static FileSystem fs;
+/*
+ * Estado del sistema buddy: una lista doblemente enlazada de bloques libres
+ * por orden. free_order[i] vale k si i es la cabeza de un bloque libre de
+ * 2^k bloques, o -1 en caso contrario; solo cuenta si free_gen[i] es la
+ * generación actual del volumen.
+ */
+typedef struct {
+    size_t free_head[BUDDY_MAX_ORDER + 1];         /* Cabeza de la lista libre de cada orden */
+    size_t next[MAX_BLOCKS];                       /* Siguiente bloque libre del mismo orden */
+    size_t prev[MAX_BLOCKS];                       /* Anterior bloque libre del mismo orden */
+    signed char free_order[MAX_BLOCKS];            /* Orden del bloque libre que empieza en i */
+    uint32_t free_gen[MAX_BLOCKS];                 /* Generación en que se anotó free_order[i] */
+} BuddyAllocator;
+
+/* Respaldo de memoria del almacén de bloques */
+typedef enum {
+    STORE_ANON,                           /* Mapeo anónimo privado */
+    STORE_MEMFD,                          /* memfd compartido: permite vistas MAPVIEW */
+    STORE_OVERLAY                         /* Imagen base mapeada en privado (--base) */
+} StoreKind;
+
+/* Almacén de bloques: MAX_BLOCKS * BLOCK_SIZE bytes mapeados aparte de fs */
+typedef struct {
+    StoreKind kind;                                /* Respaldo en uso */
+    int fd;                                        /* memfd, -1 con STORE_ANON */
+    size_t page_size;                              /* Tamaño de página del sistema */
+} BlockStore;
+
+/* Páginas del almacén pendientes de devolver al sistema operativo */
+typedef struct {
+    bool pending[MAX_BLOCKS];                      /* Página (por su primer bloque) con bloques liberados */
+    size_t pending_pages;                          /* Páginas marcadas en pending */
+    uint64_t released_pages;                       /* Páginas devueltas en total */
+    uint64_t release_calls;                        /* Llamadas a madvise/fallocate */
+} Reclaim;
+
+/*
+ * Volumen superpuesto a una imagen base de solo lectura. Los bloques son
+ * un mapeo MAP_PRIVATE de la imagen: las lecturas van a la caché de
+ * páginas de la base, compartida por todos los procesos que la usan, y
+ * la primera escritura en una página la copia a memoria anónima del
+ * proceso (la capa superior).
+ */
+typedef struct {
+    bool copied[MAX_BLOCKS];                       /* Página (por su primer bloque) ya copiada */
+    size_t copied_pages;                           /* Páginas de la capa superior */
+} Overlay;
+
+/*
+ * Exportación sin copias (EXPORT). Una página del almacén cargada en una
+ * tubería sigue referenciada por ella, y después por el socket, hasta que
+ * el cliente la lee; la primera modificación posterior la sustituye antes
+ * por una página nueva con el mismo contenido.
+ */
+typedef struct {
+    bool lent[MAX_BLOCKS];                /* Por primer bloque de página: prestada a una tubería */
+    size_t lent_pages;                    /* Páginas marcadas en lent */
+    uint64_t zero_copy;                   /* EXPORT servidos desde tuberías */
+    uint64_t copied;                      /* EXPORT servidos copiando */
+    uint64_t bytes;                       /* Bytes exportados */
+    uint64_t pages_replaced;              /* Páginas prestadas sustituidas al modificarse */
+} ExportState;
+
+/* Datos de un EXPORT cargados en tuberías, pendientes de enviar */
+typedef struct {
+    size_t num_pipes;
+    int fds[EXPORT_MAX_PIPES][2];         /* Extremos de lectura y escritura */
+    size_t lens[EXPORT_MAX_PIPES];        /* Bytes cargados en cada tubería */
+} ExportStream;
+
+/*
+ * Aprovisionamiento fino: el volumen anuncia MAX_STORAGE de capacidad
+ * lógica, pero solo dispone de physical_blocks bloques físicos
+ */
+typedef struct {
+    size_t physical_blocks;                        /* Bloques físicos disponibles */
+    int alert_level;                               /* 0, 1 (WATERMARK_LOW) o 2 (WATERMARK_HIGH) */
+    uint64_t alerts;                               /* Avisos emitidos */
+} ThinPool;
+
+/* Objeto libre de un slab (el enlace ocupa sus primeros bytes) */
+typedef struct SlabObject {
+    struct SlabObject *next;
+} SlabObject;
+
+/* Clase de tamaño del slab: lista libre compartida entre hilos */
+typedef struct {
+    pthread_mutex_t lock;
+    SlabObject *free_list;                         /* Objetos libres devueltos por las cachés */
+    size_t chunk_bytes;                            /* Memoria pedida al sistema para esta clase */
+} SlabClass;
+
+/* Caché de un hilo para una clase: se toma y devuelve sin bloqueo */
+typedef struct {
+    SlabObject *head;
+    size_t count;
+} SlabCache;
+
+/* Vista contigua de un archivo creada con MAPVIEW */
+typedef struct {
+    unsigned char *addr;                           /* Inicio de la vista */
+    size_t length;                                 /* Bytes útiles (tamaño del archivo) */
+    size_t map_len;                                /* Bytes reservados (múltiplo de página) */
+    size_t shared_pages;                           /* Páginas mapeadas del memfd sin copia */
+    size_t copied_pages;                           /* Páginas que hubo que copiar */
+} FileView;
+
+/*
+ * Variable global del sistema de archivos. Se alinea a página para que
+ * los metadatos (mapa, tabla y contadores, que cambian con cada comando)
+ * ocupen sus propias páginas, y así BGSAVE copie en escritura lo mínimo.
+ */
+static _Alignas(PAGE_SIZE_BYTES) FileSystem fs;
+
+/* Almacén de bloques */
+static BlockStore store = { .kind = STORE_ANON, .fd = -1 };
+
+/* Liberación diferida de páginas del almacén */
+static Reclaim reclaim;
+
+/* Capa superior del volumen superpuesto (solo con STORE_OVERLAY) */
+static Overlay overlay;
+
+/* Páginas prestadas a EXPORT y estadísticas */
+static ExportState exports;
+
+/* Espacio físico del volumen (sin sobreasignación por defecto) */
+static ThinPool thin = { .physical_blocks = MAX_BLOCKS };
+
+/* Bloques con los que se crea el volumen; GROW lo amplía hasta MAX_BLOCKS */
+static size_t initial_blocks = MAX_BLOCKS;
+
+/*
+ * Índice de posiciones del diccionario para buscar coincidencias: listas
+ * por hash de 4 bytes, de la posición más alta a la más baja. Se
+ * reconstruye cuando cambia fs.dict_gen.
+ */
+static struct {
+    uint32_t gen;                                  /* dict_gen indexado, 0 = sin construir */
+    int16_t head[1 << DICT_HASH_BITS];             /* Última posición de cada hash, -1 = ninguna */
+    int16_t prev[DICT_SIZE];                       /* Posición anterior con el mismo hash */
+} dict_index;
+
+/* Caché de listas de bloques decodificadas */
+static struct {
+    ExtentCacheSlot slots[EXTENT_CACHE_SLOTS];
+    uint64_t clock;
+    uint64_t hits;
+    uint64_t misses;
+} extent_cache;
+
+/*
+ * Slabs para las copias de los registros del espejo y de la replicación
+ * y para las peticiones, resultados, respuestas, exportaciones y
+ * suscripciones del servidor: se crean y liberan con fs_lock o en cada
+ * comando, así que se reciclan por clase de tamaño en vez de pasar por
+ * malloc/free
+ */
+static SlabClass slab_classes[SLAB_CLASSES] = {
+#define SLAB_CLASS_INIT { .lock = PTHREAD_MUTEX_INITIALIZER }
+    SLAB_CLASS_INIT, SLAB_CLASS_INIT, SLAB_CLASS_INIT, SLAB_CLASS_INIT, SLAB_CLASS_INIT,
+    SLAB_CLASS_INIT, SLAB_CLASS_INIT, SLAB_CLASS_INIT, SLAB_CLASS_INIT, SLAB_CLASS_INIT,
+    SLAB_CLASS_INIT
+#undef SLAB_CLASS_INIT
+};
+static _Thread_local SlabCache slab_cache[SLAB_CLASSES];
+static _Thread_local bool slab_cache_owned;        /* El hilo registró su caché en slab_exit_key */
+static pthread_key_t slab_exit_key;                /* Su destructor vacía la caché de un hilo que termina */
+static pthread_once_t slab_exit_once = PTHREAD_ONCE_INIT;
+
+/* Estado del asignador buddy (solo se usa con ALLOC_BUDDY) */
+static BuddyAllocator buddy;
+
+/*
+ * Paridad opcional por grupos de PARITY_GROUP bloques físicos consecutivos.
+ * Con nivel 1 se guarda P (XOR de los bloques del grupo); con nivel 2
+ * también Q (suma en GF(2^8) de g^i * D_i, como RAID-6). Cada bloque lleva
+ * un CRC-32 que se comprueba al leer; si falla, el bloque se reconstruye
+ * a partir de la paridad.
+ */
+typedef struct {
+    int level;                                     /* 0 = desactivada, 1 = P, 2 = P + Q */
+    unsigned char p[PARITY_GROUPS][BLOCK_SIZE];    /* Paridad XOR de cada grupo */
+    unsigned char q[PARITY_GROUPS][BLOCK_SIZE];    /* Paridad Reed-Solomon de cada grupo */
+    uint32_t block_crc[MAX_BLOCKS];                /* CRC-32 de cada bloque de datos */
+    uint32_t p_crc[PARITY_GROUPS];                 /* CRC-32 de cada bloque P */
+    uint32_t q_crc[PARITY_GROUPS];                 /* CRC-32 de cada bloque Q */
+    size_t data_bytes;                             /* Bytes de datos escritos */
+    size_t parity_bytes;                           /* Bytes de paridad actualizados */
+    size_t rebuilt_blocks;                         /* Bloques reconstruidos */
+} ParityState;
+
+/* Estado de la paridad (solo se usa con --parity) */
+static ParityState parity;
+
+/* Cabecera de una imagen en disco: bloques y luego metadatos de fs */
+typedef struct {
+    char magic[8];                                 /* IMAGE_MAGIC */
+    uint32_t block_size;                           /* BLOCK_SIZE con el que se creó */
+    uint32_t max_blocks;                           /* MAX_BLOCKS con el que se creó */
+    uint32_t max_files;                            /* MAX_FILES con el que se creó */
+    uint32_t meta_size;                            /* Bytes de metadatos tras los bloques */
+} ImageHeader;
+
+/*
+ * Registro de cambios de la operación en curso: qué bloques, qué tramo del
+ * mapa de bloques y qué entradas de la tabla se modificaron. Al terminar la
+ * operación, journal_commit() los convierte en registros (offset en la
+ * imagen, bytes) para los destinos activos.
+ */
+typedef struct {
+    bool active;                                   /* Hay algún destino de registros */
+    bool block_dirty[MAX_BLOCKS];                  /* Bloque modificado en la operación */
+    size_t dirty_blocks[MAX_BLOCKS];               /* Lista de bloques modificados */
+    size_t num_dirty_blocks;                       /* Elementos de dirty_blocks */
+    size_t map_lo, map_hi;                         /* Tramo modificado de block_map [lo, hi) */
+    size_t name_lo, name_hi;                       /* Tramo modificado de name_index [lo, hi) */
+    bool file_dirty[MAX_FILES];                    /* Entrada de la tabla modificada */
+    bool counters;                                 /* Contadores modificados sin nada más (FORMAT) */
+    bool dict;                                     /* Diccionario sustituido (TRAINDICT) */
+    uint64_t seq;                                  /* Registros emitidos */
+} Journal;
+
+/* Registro pendiente de aplicar en el espejo */
+typedef struct {
+    uint64_t offset;                               /* Offset en la imagen */
+    size_t len;                                    /* Bytes del registro */
+    unsigned char *bytes;                          /* Copia de los bytes */
+    long long enqueued_ns;                         /* Momento en que se encoló */
+} MirrorRecord;
+
+/*
+ * Espejo asíncrono: la operación en primer plano solo copia los bytes a
+ * una cola acotada; un hilo en segundo plano los escribe por lotes en la
+ * segunda imagen y sincroniza una vez por lote.
+ */
+typedef struct {
+    MirrorRecord ring[MIRROR_QUEUE_LEN];           /* Cola circular de registros */
+    size_t head;                                   /* Siguiente registro a aplicar */
+    size_t tail;                                   /* Siguiente hueco libre */
+    pthread_mutex_t lock;
+    pthread_cond_t not_empty;
+    pthread_cond_t not_full;
+    pthread_t thread;
+    int fd;                                        /* Imagen espejo */
+    bool active;                                   /* Hilo en marcha */
+    bool stopping;                                 /* Terminar al vaciar la cola */
+    bool out_of_sync;                              /* Se perdió un registro o falló una escritura */
+    uint64_t applied;                              /* Registros aplicados */
+    size_t batches;                                /* Lotes sincronizados */
+    long long last_lag_ns;                         /* Retraso del último lote aplicado */
+    long long max_lag_ns;                          /* Mayor retraso observado */
+} Mirror;
+
+/*
+ * Nivel frío en memoria (--cold). Un hilo en segundo plano comprime los
+ * archivos que llevan age_ns sin usarse en tramas dentro del propio
+ * volumen y libera sus bloques. READ descomprime trama a trama sin
+ * cambiar el volumen; es el mismo hilo quien, en su siguiente pasada,
+ * devuelve a bloques normales los archivos fríos que se han vuelto a
+ * leer. Los instantes de acceso no van en la imagen: al arrancar, todos
+ * los archivos cuentan como recién usados.
+ */
+typedef struct {
+    long long age_ns;                              /* Tiempo sin uso para comprimir, 0 = desactivado */
+    long long last_access[MAX_FILES];              /* Último acceso de cada entrada de file_table */
+    long long tried[MAX_FILES];                    /* last_access del último intento sin ahorro */
+    long long cooled[MAX_FILES];                   /* Instante en que pasó al nivel frío */
+    pthread_mutex_t lock;
+    pthread_cond_t wake;                           /* Con CLOCK_MONOTONIC (cold_start) */
+    pthread_t thread;
+    bool active;                                   /* Hilo en marcha */
+    bool stopping;                                 /* Terminar en la próxima espera */
+    uint64_t passes;                               /* Pasadas de envejecimiento */
+    uint64_t packed;                               /* Archivos comprimidos por el hilo */
+    uint64_t promoted;                             /* Archivos fríos devueltos a bloques tras leerlos */
+    uint64_t blocks_saved;                         /* Bloques liberados al comprimir */
+} ColdTier;
+
+/* Cabecera de la instantánea con la que arranca un seguidor */
+typedef struct {
+    char magic[8];                                 /* REPL_MAGIC */
+    uint64_t seq;                                  /* Último registro incluido */
+    uint64_t data_size;                            /* Bytes de bloques que siguen */
+    uint64_t meta_size;                            /* Bytes de metadatos que siguen */
+} ReplSnapshotHeader;
+
+/* Cabecera de un registro del log en el socket; le siguen len bytes */
+typedef struct {
+    uint64_t seq;                                  /* Número de secuencia */
+    uint64_t offset;                               /* Offset en la imagen */
+    uint32_t len;                                  /* Bytes del registro */
+    uint32_t flags;                                /* REPL_COMMIT_END */
+    int64_t appended_ns;                           /* Momento del commit en el primario */
+} ReplFrame;
+
+/* Registro conservado en el log del primario */
+typedef struct {
+    ReplFrame frame;
+    unsigned char *bytes;
+} ReplRecord;
+
+/* Seguidor conectado al primario */
+typedef struct {
+    int fd;                                        /* Socket del seguidor */
+    bool active;                                   /* Conectado */
+    uint64_t next_seq;                             /* Siguiente registro a enviar */
+    unsigned char *snapshot;                       /* Instantánea pendiente de enviar */
+    size_t snapshot_len;
+} Follower;
+
+/*
+ * Replicación por envío del log de cambios. El primario conserva los
+ * últimos REPL_LOG_LEN registros; cada seguidor recibe una instantánea
+ * tomada entre dos comandos y luego el log desde ese punto. Los
+ * seguidores aplican cada comando completo de una vez y atienden
+ * READ/LIST localmente.
+ */
+typedef struct {
+    /* Primario */
+    bool primary;                                  /* Este proceso es primario */
+    int listen_fd;                                 /* Socket de escucha */
+    const char *path;                              /* Ruta del socket */
+    ReplRecord log[REPL_LOG_LEN];                  /* Log circular indexado por seq */
+    uint64_t log_seq;                              /* Último seq agregado */
+    Follower followers[REPL_MAX_FOLLOWERS];
+    pthread_mutex_t lock;
+    pthread_cond_t appended;
+    /* Seguidor */
+    bool follower;                                 /* Este proceso es seguidor */
+    int fd;                                        /* Socket hacia el primario */
+    bool connected;                                /* Recibiendo del primario */
+    uint64_t applied_seq;                          /* Último registro aplicado */
+    uint64_t applied_commits;                      /* Comandos aplicados */
+    long long last_lag_ns;                         /* Retraso del último comando aplicado */
+    long long max_lag_ns;                          /* Mayor retraso observado */
+} Replication;
+
+/* Protege fs frente a los hilos de replicación: se toma por comando */
+static pthread_mutex_t fs_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* Guardado en segundo plano en curso (BGSAVE) */
+typedef struct {
+    pid_t pid;                                     /* Proceso hijo, 0 si no hay ninguno */
+    char path[MAX_FILENAME];                       /* Imagen destino */
+    long long started_ns;                          /* Inicio del guardado */
+    long long fork_ns;                             /* Duración del fork en el padre */
+} BgSave;
+
+static BgSave bgsave;
+
+/* Tipos de evento de WATCH */
+typedef enum {
+    WATCH_CREATE,
+    WATCH_WRITE,                          /* WRITE, FALLOCATE y PUNCH */
+    WATCH_DELETE,
+    WATCH_FORMAT                          /* Todos los archivos dejan de existir */
+} WatchKind;
+
+/* Evento pendiente de entregar */
+typedef struct {
+    WatchKind kind;
+    size_t file;                                   /* Índice en file_table */
+    char filename[MAX_FILENAME];                   /* Nombre en el momento del evento */
+} WatchEvent;
+
+/*
+ * Suscripción de un cliente (WATCH). La cola tiene un único productor (el
+ * hilo que ejecuta los comandos) y un único consumidor (el que escribe en
+ * el socket del cliente), así que no necesita bloqueos: cada lado solo
+ * avanza su propio índice. El eventfd despierta al consumidor. Una
+ * escritura sobre un archivo cuyo WRITE aún no se ha entregado no se
+ * encola: solo suma en write_count.
+ */
+typedef struct {
+    char patterns[WATCH_PATTERNS][MAX_FILENAME];   /* Nombres o patrones fnmatch */
+    size_t num_patterns;
+    WatchEvent ring[WATCH_QUEUE_LEN];              /* Cola circular de eventos */
+    _Atomic size_t head;                           /* Siguiente evento a entregar (consumidor) */
+    _Atomic size_t tail;                           /* Siguiente hueco libre (productor) */
+    _Atomic bool overflow;                         /* Se descartaron eventos por cola llena */
+    _Atomic bool write_pending[MAX_FILES];         /* Hay un WRITE encolado para el archivo */
+    _Atomic uint32_t write_count[MAX_FILES];       /* Escrituras acumuladas en ese WRITE */
+    _Atomic uint64_t coalesced;                    /* Escrituras que no generaron evento */
+    uint64_t delivered;                            /* Eventos entregados */
+    int efd;                                       /* eventfd de aviso */
+} WatchSub;
+_Static_assert(sizeof(WatchSub) <= (size_t)1 << (SLAB_MIN_SHIFT + SLAB_CLASSES - 1),
+               "WatchSub debe caber en la mayor clase de slab");
+
+/* Estado de la conexión de un hueco de cliente */
+typedef enum {
+    CLIENT_FREE,                          /* Hueco libre para un accept */
+    CLIENT_OPEN,                          /* El hilo de red lee del socket */
+    CLIENT_CLOSING                        /* Cierre en curso por la tubería */
+} ClientState;
+
+/*
+ * Conexión de un cliente en modo servidor. El hilo de red la abre y lee
+ * de ella; el de respuesta escribe y la cierra al final de la tubería,
+ * que es cuando el hueco vuelve a quedar libre.
+ */
+typedef struct {
+    int fd;                                        /* Socket de la conexión */
+    _Atomic int state;                             /* ClientState */
+    char in[SERVER_LINE_MAX];                      /* Línea recibida en curso (hilo de red) */
+    size_t in_len;                                 /* Bytes de in */
+    _Atomic(WatchSub *) watch;                     /* Suscripción, NULL sin WATCH */
+} ServerClient;
+
+/*
+ * Cola entre dos etapas del servidor. Como la de WATCH, tiene un único
+ * productor y un único consumidor y cada lado solo avanza su propio
+ * índice. El productor avisa por el eventfd una vez por lote.
+ */
+typedef struct {
+    void *slots[PIPE_QUEUE_LEN];
+    _Atomic size_t head;                           /* Siguiente elemento (consumidor) */
+    _Atomic size_t tail;                           /* Siguiente hueco libre (productor) */
+    int efd;                                       /* eventfd de aviso */
+} PipeQueue;
+
+/*
+ * Bucle de eventos del servidor: su propio socket de escucha, sus
+ * conexiones y sus hilos de red y de respuesta. Las conexiones no pasan
+ * de un bucle a otro.
+ */
+typedef struct {
+    int listen_fd;                                 /* Socket de escucha */
+    char path[sizeof(((struct sockaddr_un *)0)->sun_path)];
+    ServerClient clients[SERVER_MAX_CLIENTS];
+    PipeQueue to_exec;                             /* Red -> ejecución: PipeRequest */
+    PipeQueue to_respond;                          /* Ejecución -> respuesta: PipeReply */
+    pthread_t network;                             /* Etapa de red y análisis */
+    pthread_t responder;                           /* Etapa de respuesta */
+} ServerLoop;
+
+/* Modo servidor (--serve) */
+typedef struct {
+    ServerLoop loops[SERVER_MAX_LOOPS];
+    size_t num_loops;                              /* 0 con el servidor parado */
+    pthread_t executor;                            /* Etapa de ejecución, común a los bucles */
+    atomic_int stopping;                           /* SIGINT/SIGTERM o parada pedida */
+    uint64_t batches;                              /* Lotes ejecutados con un solo bloqueo */
+    uint64_t requests;                             /* Comandos ejecutados en esos lotes */
+    uint64_t reads_shared;                         /* READ atendidos con la respuesta de otro */
+    uint64_t bytes_shared;                         /* Bytes de respuesta que no se generaron */
+} Server;
+
+/*
+ * Respuesta de un comando, compartida por los READ idénticos de un lote.
+ * Los clientes pueden ser de bucles distintos, así que las referencias se
+ * sueltan desde varios hilos de respuesta a la vez.
+ */
+typedef struct {
+    atomic_size_t refs;                            /* Clientes que aún deben recibirla */
+    char *bytes;                                   /* Salida capturada */
+    size_t len;                                    /* Bytes de salida */
+} SharedReply;
+
+/* Comandos de la consola */
+typedef enum {
+    CMD_UNKNOWN,
+    CMD_CREATE,
+    CMD_WRITE,
+    CMD_READ,
+    CMD_FALLOCATE,
+    CMD_PUNCH,
+#ifdef FS_TEST_HOOKS
+    CMD_CORRUPT,
+    CMD_COLDPASS,
+#endif
+    CMD_DELETE_MATCH,
+    CMD_DELETE,
+    CMD_MAPVIEW,
+    CMD_GROW,
+    CMD_FORMAT,
+    CMD_WATCH,
+    CMD_UNWATCH,
+    CMD_MEMSTAT,
+    CMD_BGSAVE,
+    CMD_MIRROR,
+    CMD_REPLICA,
+    CMD_LIST,
+    CMD_EXIT,
+    CMD_EXPORT,
+    CMD_TRAINDICT,
+    CMD_TOO_LONG                          /* Línea sin fin en SERVER_LINE_MAX bytes (servidor) */
+} CommandOp;
+
+/* Comando analizado: parse_command() lo rellena y run_command() lo ejecuta */
+typedef struct {
+    CommandOp op;
+    bool mutating;                                 /* Modifica el volumen (una réplica lo rechaza) */
+    char filename[MAX_FILENAME];                   /* Archivo, patrón o imagen */
+    char data[SERVER_LINE_MAX];                    /* Datos de WRITE */
+    size_t offset;
+    size_t size;
+} Command;
+
+/* Resultado de la etapa de ejecución para la de respuesta */
+typedef struct {
+    size_t loop;                                   /* Bucle del cliente */
+    size_t client;                                 /* Hueco del cliente en su bucle */
+    SharedReply *reply;                            /* Salida a enviar, NULL si no hay */
+    WatchSub *retired;                             /* Suscripción a liberar tras entregar sus eventos */
+    ExportStream *stream;                          /* Datos de EXPORT a enviar tras reply */
+    bool hangup;                                   /* Cortar la conexión tras enviar (EXIT) */
+    bool release;                                  /* Cerrar el socket y liberar el hueco */
+    bool stop;                                     /* Fin de la tubería */
+} PipeReply;
+
+/* Petición de la etapa de red a la de ejecución */
+typedef struct {
+    size_t loop;                                   /* Bucle del cliente */
+    size_t client;                                 /* Hueco del cliente en su bucle */
+    bool release;                                  /* Fin de la conexión, sin comando */
+    bool stop;                                     /* Fin de la tubería (parada del servidor) */
+    Command cmd;
+    PipeReply *out;                                /* Resultado, reservado por la etapa de red */
+} PipeRequest;
+
+static Server server;
+
+/* Registro de cambios, espejo y replicación */
+static Replication repl = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .appended = PTHREAD_COND_INITIALIZER,
+    .listen_fd = -1,
+    .fd = -1
+};
+static Journal journal;
+static Mirror mirror = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .not_empty = PTHREAD_COND_INITIALIZER,
+    .not_full = PTHREAD_COND_INITIALIZER,
+    .fd = -1
+};
+
+/* Nivel frío en memoria */
+static ColdTier cold = {
+    .lock = PTHREAD_MUTEX_INITIALIZER
+};
+
+/*
+ * Áreas de trabajo para comprimir y descomprimir un archivo entero. Solo
+ * se usan con fs_lock tomado (consola, hilo de ejecución del servidor o
+ * nivel frío), así que basta una de cada y nadie reserva 1 MB con el
+ * bloqueo tomado.
+ */
+static unsigned char pack_content[MAX_FILE_BLOCKS * BLOCK_SIZE];
+static unsigned char pack_frames[MAX_FILE_BLOCKS * sizeof(uint32_t) + MAX_FILE_BLOCKS * LZ_FRAME_MAX];
+
+/*
+ * Hilo sin consola (el del nivel frío): su salida caería en la consola en
+ * mitad de otro comando, así que sus errores solo se devuelven como código
+ * y los avisos quedan para el siguiente comando
+ */
+static _Thread_local bool quiet_thread;
+
+/*
+ * Salida de los comandos del hilo (NULL = stdout). El hilo de ejecución
+ * del servidor la apunta a la respuesta del cliente y el benchmark a
+ * /dev/null, sin cambiar stdout, que comparten todos los hilos.
+ */
+static _Thread_local FILE *thread_out;
+
+/**
+ * Flujo en el que escriben los comandos del hilo
+ * @return thread_out o, si no hay, stdout
+ */
+static FILE *cmd_out(void) {
+    return thread_out != NULL ? thread_out : stdout;
+}
+
+/**
+ * printf sobre la salida de los comandos del hilo (cmd_out)
+ * @param format Formato de printf
+ * @return Caracteres escritos o negativo si hay error
+ */
+static int out_printf(const char *format, ...) __attribute__((format(printf, 1, 2)));
+static int out_printf(const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    int written = vfprintf(cmd_out(), format, args);
+    va_end(args);
+    return written;
+}
+
+/* Tabla de políticas de asignación (definida junto a las políticas) */
+static const AllocPolicyOps alloc_policies[ALLOC_NUM_POLICIES];
 
 /* Prototipos de funciones */
-void init_filesystem(void);
+void init_filesystem(AllocPolicy policy);
 int create_file(const char *filename, size_t size);
 int write_file(const char *filename, size_t offset, const char *data);
 int read_file(const char *filename, size_t offset, size_t size, char *buffer);
 int delete_file(const char *filename);
+int delete_matching(const char *pattern);
+int fallocate_file(const char *filename, size_t offset, size_t length);
+int punch_hole(const char *filename, size_t offset, size_t length);
+int grow_volume(size_t kb);
+int format_volume(void);
+#ifdef FS_TEST_HOOKS
+int corrupt_block(size_t block);
+int cold_test_pass(size_t seconds);
+#endif
+int train_dictionary(const char *pattern);
 void list_files(void);
 FileEntry* find_file(const char *filename);
-size_t allocate_blocks(size_t num_blocks, size_t *block_list);
-void free_blocks(size_t num_blocks, const size_t *block_list);
+size_t allocate_blocks(size_t num_blocks, BlockNo *block_list);
+size_t allocate_blocks_near(size_t num_blocks, BlockNo *block_list, size_t goal);
+bool policy_from_name(const char *name, AllocPolicy *policy);
+size_t growth_goal(const FileEntry *file);
+size_t placement_goal(const char *filename);
+void free_blocks(size_t num_blocks, const BlockNo *block_list);
+void run_benchmark(void);
+void journal_block(size_t block);
+void journal_map(size_t block);
+void journal_name(size_t slot);
+void journal_file(const FileEntry *file);
+void journal_counters(void);
+void journal_dict(void);
+void journal_commit(void);
+void watch_notify(WatchKind kind, const FileEntry *file);
+int server_run(const char *path, size_t num_loops);
+void bench_server(void);
+int mount_image(const char *path, bool over_base);
+int mirror_start(const char *path);
+void mirror_stop(void);
+void mirror_status(void);
+int cold_start(size_t seconds);
+void cold_stop(void);
+int repl_start_primary(const char *path);
+int repl_start_follower(const char *path);
+void repl_status(void);
+void repl_stop(void);
+int bgsave_start(const char *path);
+int block_store_init(StoreKind kind);
+int map_file_view(const char *filename, FileView *view);
+void unmap_file_view(FileView *view);
+void mapview_command(const char *filename);
+void memory_status(void);
+void bgsave_poll(bool wait_child);
 
 /**
- * Inicializa el sistema de archivos
+ * Indica si un bloque no se puede asignar: pertenece a la generación
+ * actual o está fuera de la capacidad del volumen
+ * @param block Bloque físico
+ * @return true si está ocupado o reservado
  */
-void init_filesystem(void) {
-    /* Limpiar todos los bloques */
-    memset(fs.blocks, 0, sizeof(fs.blocks));
-    
-    /* Marcar todos los bloques como libres */
-    for (size_t i = 0; i < MAX_BLOCKS; i++) {
-        fs.block_map[i] = false;
+static bool block_taken(size_t block) {
+    return fs.block_map[block] == fs.format_gen || fs.block_map[block] == BLOCK_RESERVED;
+}
+
+/**
+ * Orden del bloque libre que empieza en un bloque
+ * @param start Bloque
+ * @return Orden, -1 si no es la cabeza de un bloque libre en esta generación
+ */
+static int buddy_order(size_t start) {
+    return buddy.free_gen[start] == fs.format_gen ? buddy.free_order[start] : -1;
+}
+
+/**
+ * Inserta un bloque libre de orden k en su lista
+ * @param start Primer bloque del bloque libre
+ * @param order Orden del bloque libre (2^order bloques)
+ */
+static void buddy_push(size_t start, int order) {
+    buddy.free_order[start] = (signed char)order;
+    buddy.free_gen[start] = fs.format_gen;
+    buddy.prev[start] = NO_BLOCK;
+    buddy.next[start] = buddy.free_head[order];
+    if (buddy.free_head[order] != NO_BLOCK) {
+        buddy.prev[buddy.free_head[order]] = start;
     }
-    
-    /* Limpiar tabla de archivos */
-    for (size_t i = 0; i < MAX_FILES; i++) {
-        fs.file_table[i].in_use = false;
-        fs.file_table[i].filename[0] = '\0';
-        fs.file_table[i].size = 0;
-        fs.file_table[i].num_blocks = 0;
+    buddy.free_head[order] = start;
+}
+
+/**
+ * Quita un bloque libre de su lista
+ * @param start Primer bloque del bloque libre
+ */
+static void buddy_unlink(size_t start) {
+    int order = buddy.free_order[start];
+    if (buddy.prev[start] != NO_BLOCK) {
+        buddy.next[buddy.prev[start]] = buddy.next[start];
+    } else {
+        buddy.free_head[order] = buddy.next[start];
     }
-    
-    fs.num_files = 0;
-    fs.used_blocks = 0;
-    fs.total_storage = 0;
-    
-    printf("Sistema de archivos inicializado.\n");
-    printf("  - Tamano de bloque: %d bytes\n", BLOCK_SIZE);
-    printf("  - Numero maximo de archivos: %d\n", MAX_FILES);
-    printf("  - Almacenamiento maximo: %d bytes (%d KB)\n", MAX_STORAGE, MAX_STORAGE / 1024);
-    printf("  - Numero maximo de bloques: %d\n\n", MAX_BLOCKS);
+    if (buddy.next[start] != NO_BLOCK) {
+        buddy.prev[buddy.next[start]] = buddy.prev[start];
+    }
+    buddy.free_order[start] = -1;
 }
 
 /**
- * Busca un archivo en la tabla de archivos
- * @param filename Nombre del archivo a buscar
- * @return Puntero al archivo si existe, NULL en caso contrario
+ * Devuelve un bloque libre alineado al sistema buddy, fusionándolo con su
+ * compañero mientras éste también esté libre
+ * @param block Primer bloque del bloque libre
+ * @param order Orden del bloque libre (2^order bloques)
  */
-FileEntry* find_file(const char *filename) {
-    for (size_t i = 0; i < MAX_FILES; i++) {
-        if (fs.file_table[i].in_use && 
-            strcmp(fs.file_table[i].filename, filename) == 0) {
-            return &fs.file_table[i];
+static void buddy_merge(size_t block, int order) {
+    while (order < BUDDY_MAX_ORDER) {
+        size_t mate = block ^ ((size_t)1 << order);
+        if (buddy_order(mate) != order) {
+            break;
         }
+        buddy_unlink(mate);
+        if (mate < block) {
+            block = mate;
+        }
+        order++;
     }
-    return NULL;
+    buddy_push(block, order);
 }
 
 /**
- * Asigna bloques consecutivos para un archivo
- * @param num_blocks Número de bloques a asignar
- * @param block_list Array donde se guardarán los índices de bloques asignados
- * @return Número de bloques asignados exitosamente, 0 si no hay espacio suficiente
+ * Devuelve un tramo de bloques al sistema buddy, descomponiéndolo en los
+ * mayores bloques alineados que contiene, de modo que un tramo largo se
+ * fusiona con pocas operaciones en vez de bloque a bloque
+ * @param start Primer bloque liberado
+ * @param count Número de bloques
  */
-size_t allocate_blocks(size_t num_blocks, size_t *block_list) {
-    if (num_blocks == 0 || num_blocks > MAX_BLOCKS) {
-        return 0;
+static void buddy_release(size_t start, size_t count) {
+    size_t end = start + count;
+    while (start < end) {
+        int order = 0;
+        while (order < BUDDY_MAX_ORDER && (start & ((size_t)1 << order)) == 0 &&
+               start + ((size_t)2 << order) <= end) {
+            order++;
+        }
+        buddy_merge(start, order);
+        start += (size_t)1 << order;
     }
-    
-    if (fs.used_blocks + num_blocks > MAX_BLOCKS) {
-        return 0;  /* No hay suficiente espacio */
+}
+
+/**
+ * Reserva un bloque alineado de 2^order bloques, partiendo bloques
+ * mayores si es necesario
+ * @param order Orden solicitado
+ * @return Primer bloque reservado, NO_BLOCK si no hay ninguno disponible
+ */
+static size_t buddy_take(int order) {
+    int k = order;
+    while (k <= BUDDY_MAX_ORDER && buddy.free_head[k] == NO_BLOCK) {
+        k++;
     }
-    
-    size_t allocated = 0;
-    
-    /* Buscar bloques libres consecutivos */
-    for (size_t i = 0; i < MAX_BLOCKS && allocated < num_blocks; i++) {
-        if (!fs.block_map[i]) {
-            /* Encontrar una secuencia de bloques libres */
-            bool found_sequence = true;
-            for (size_t j = 0; j < num_blocks; j++) {
-                if (i + j >= MAX_BLOCKS || fs.block_map[i + j]) {
-                    found_sequence = false;
-                    break;
-                }
-            }
-            
-            if (found_sequence) {
-                /* Asignar los bloques */
-                for (size_t j = 0; j < num_blocks; j++) {
-                    fs.block_map[i + j] = true;
-                    block_list[j] = i + j;
-                }
-                allocated = num_blocks;
-                fs.used_blocks += num_blocks;
-                return allocated;
-            }
+    if (k > BUDDY_MAX_ORDER) {
+        return NO_BLOCK;
+    }
+
+    size_t start = buddy.free_head[k];
+    buddy_unlink(start);
+
+    /* Partir en mitades, devolviendo la mitad superior a su lista */
+    while (k > order) {
+        k--;
+        buddy_push(start + ((size_t)1 << k), k);
+    }
+    return start;
+}
+
+/**
+ * Reconstruye las listas del buddy a partir del mapa de bloques
+ */
+static void buddy_rebuild(void) {
+    for (int k = 0; k <= BUDDY_MAX_ORDER; k++) {
+        buddy.free_head[k] = NO_BLOCK;
+    }
+    for (size_t i = 0; i < MAX_BLOCKS; i++) {
+        buddy.free_order[i] = -1;
+    }
+    for (size_t i = 0; i < MAX_BLOCKS; i++) {
+        if (!block_taken(i)) {
+            buddy_merge(i, 0);
+        }
+    }
+}
+
+/**
+ * Deja el buddy como en un volumen vacío sin recorrer los bloques: la
+ * capacidad se descompone en bloques alineados (a lo sumo uno por orden
+ * más uno) y los free_order de la generación anterior dejan de contar
+ * porque free_gen ya no coincide
+ */
+static void buddy_format(void) {
+    for (int k = 0; k <= BUDDY_MAX_ORDER; k++) {
+        buddy.free_head[k] = NO_BLOCK;
+    }
+    size_t start = 0;
+    while (start < fs.capacity_blocks) {
+        int order = BUDDY_MAX_ORDER;
+        while (order > 0 && ((start & (((size_t)1 << order) - 1)) != 0 ||
+                             start + ((size_t)1 << order) > fs.capacity_blocks)) {
+            order--;
+        }
+        buddy_push(start, order);
+        start += (size_t)1 << order;
+    }
+}
+
+/* Tablas de CRC-32 y de GF(2^8) (polinomio 0x11d, generador 2) */
+static uint32_t crc_table[256];
+static unsigned char gf_exp[512];
+static unsigned char gf_log[256];
+
+/**
+ * Prepara las tablas de CRC-32 y de aritmética en GF(2^8)
+ */
+static void parity_tables_init(void) {
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t c = i;
+        for (int k = 0; k < 8; k++) {
+            c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
         }
+        crc_table[i] = c;
     }
     
-    /* Si no hay bloques consecutivos, asignar bloques dispersos */
-    allocated = 0;
-    for (size_t i = 0; i < MAX_BLOCKS && allocated < num_blocks; i++) {
-        if (!fs.block_map[i]) {
-            fs.block_map[i] = true;
-            block_list[allocated] = i;
-            allocated++;
-            fs.used_blocks++;
+    unsigned int x = 1;
+    for (int i = 0; i < 255; i++) {
+        gf_exp[i] = (unsigned char)x;
+        gf_log[x] = (unsigned char)i;
+        x <<= 1;
+        if (x & 0x100) {
+            x ^= 0x11d;
+        }
+    }
+    for (int i = 255; i < 512; i++) {
+        gf_exp[i] = gf_exp[i - 255];
+    }
+}
+
+/**
+ * CRC-32 de un bloque
+ * @param data Contenido del bloque (BLOCK_SIZE bytes)
+ */
+static uint32_t block_checksum(const unsigned char *data) {
+    uint32_t c = 0xFFFFFFFFu;
+    for (size_t i = 0; i < BLOCK_SIZE; i++) {
+        c = crc_table[(c ^ data[i]) & 0xFF] ^ (c >> 8);
+    }
+    return c ^ 0xFFFFFFFFu;
+}
+
+/**
+ * Multiplicación en GF(2^8)
+ */
+static unsigned char gf_mul(unsigned char a, unsigned char b) {
+    if (a == 0 || b == 0) {
+        return 0;
+    }
+    return gf_exp[gf_log[a] + gf_log[b]];
+}
+
+/**
+ * dst ^= src sobre len bytes. Con GCC/Clang se procesan 16 bytes por
+ * instrucción (SSE2/NEON) mediante vectores del compilador.
+ */
+static void xor_into(unsigned char *dst, const unsigned char *src, size_t len) {
+    size_t i = 0;
+#if defined(__GNUC__)
+    typedef unsigned char v16 __attribute__((vector_size(16)));
+    for (; i + 16 <= len; i += 16) {
+        v16 a, b;
+        memcpy(&a, dst + i, 16);
+        memcpy(&b, src + i, 16);
+        a ^= b;
+        memcpy(dst + i, &a, 16);
+    }
+#endif
+    for (; i < len; i++) {
+        dst[i] ^= src[i];
+    }
+}
+
+/**
+ * dst ^= coef * src en GF(2^8) sobre len bytes
+ */
+static void gf_mul_xor_into(unsigned char *dst, const unsigned char *src, size_t len,
+                            unsigned char coef) {
+    if (coef == 0) {
+        return;
+    }
+    unsigned int log_coef = gf_log[coef];
+    for (size_t i = 0; i < len; i++) {
+        if (src[i] != 0) {
+            dst[i] ^= gf_exp[gf_log[src[i]] + log_coef];
+        }
+    }
+}
+
+/**
+ * Reinicia la paridad para un almacenamiento completamente a cero
+ */
+static void parity_reset(void) {
+    if (parity.level == 0) {
+        return;
+    }
+    static const unsigned char zero_block[BLOCK_SIZE];
+    uint32_t zero_crc = block_checksum(zero_block);
+    
+    memset(parity.p, 0, sizeof(parity.p));
+    memset(parity.q, 0, sizeof(parity.q));
+    for (size_t i = 0; i < MAX_BLOCKS; i++) {
+        parity.block_crc[i] = zero_crc;
+    }
+    for (size_t g = 0; g < PARITY_GROUPS; g++) {
+        parity.p_crc[g] = zero_crc;
+        parity.q_crc[g] = zero_crc;
+    }
+}
+
+/**
+ * Sustituye las páginas prestadas a EXPORT que contienen un tramo de
+ * bloques por páginas nuevas con el mismo contenido, antes de modificarlo.
+ * Las tuberías y sockets conservan la página antigua. Se llama antes de
+ * cualquier escritura directa en el almacén.
+ * @param block Primer bloque del tramo
+ * @param count Número de bloques
+ */
+static void export_unlend(size_t block, size_t count) {
+    static unsigned char saved[EXPORT_MAX_PAGE];
+    if (exports.lent_pages == 0) {
+        return;
+    }
+    size_t per_page = store.page_size / BLOCK_SIZE;
+    for (size_t page = block - block % per_page; page < block + count; page += per_page) {
+        if (!exports.lent[page]) {
+            continue;
+        }
+        unsigned char *addr = fs.blocks[page];
+        memcpy(saved, addr, store.page_size);
+        if (store.kind == STORE_MEMFD) {
+            fallocate(store.fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE,
+                      (off_t)(page * BLOCK_SIZE), (off_t)store.page_size);
+        } else {
+            /* En el superpuesto reaparece la base; se sobrescribe enseguida */
+            madvise(addr, store.page_size, MADV_DONTNEED);
+        }
+        memcpy(addr, saved, store.page_size);
+        exports.lent[page] = false;
+        exports.lent_pages--;
+        exports.pages_replaced++;
+    }
+}
+
+/**
+ * Reconstruye los bloques dañados del grupo de un bloque a partir de P
+ * y, con nivel 2, de Q
+ * @param block Bloque cuyo grupo se repara
+ * @return true si el grupo quedó íntegro
+ */
+static bool rebuild_group(size_t block) {
+    size_t group = block / PARITY_GROUP;
+    size_t base = group * PARITY_GROUP;
+    size_t failed[PARITY_GROUP];
+    size_t num_failed = 0;
+    
+    for (size_t i = 0; i < PARITY_GROUP; i++) {
+        if (block_checksum(fs.blocks[base + i]) != parity.block_crc[base + i]) {
+            failed[num_failed++] = i;
+        }
+    }
+    if (num_failed == 0) {
+        return true;
+    }
+    
+    bool p_ok = block_checksum(parity.p[group]) == parity.p_crc[group];
+    bool q_ok = parity.level == 2 && block_checksum(parity.q[group]) == parity.q_crc[group];
+    
+    /* Síndromes sin los bloques dañados: Pxy = P ^ sum(D_j), Qxy = Q ^ sum(g^j D_j) */
+    unsigned char pxy[BLOCK_SIZE], qxy[BLOCK_SIZE];
+    memcpy(pxy, parity.p[group], BLOCK_SIZE);
+    memcpy(qxy, parity.q[group], BLOCK_SIZE);
+    for (size_t j = 0, f = 0; j < PARITY_GROUP; j++) {
+        if (f < num_failed && failed[f] == j) {
+            f++;
+            continue;
+        }
+        xor_into(pxy, fs.blocks[base + j], BLOCK_SIZE);
+        if (q_ok) {
+            gf_mul_xor_into(qxy, fs.blocks[base + j], BLOCK_SIZE, gf_exp[j]);
+        }
+    }
+    
+    for (size_t f = 0; f < num_failed; f++) {
+        export_unlend(base + failed[f], 1);
+    }
+    if (num_failed == 1 && p_ok) {
+        memcpy(fs.blocks[base + failed[0]], pxy, BLOCK_SIZE);
+    } else if (num_failed == 1 && q_ok) {
+        /* D_x = Qx * g^-x */
+        size_t x = failed[0];
+        memset(fs.blocks[base + x], 0, BLOCK_SIZE);
+        gf_mul_xor_into(fs.blocks[base + x], qxy, BLOCK_SIZE, gf_exp[255 - x]);
+    } else if (num_failed == 2 && p_ok && q_ok) {
+        /* D_x = A * Pxy + B * Qxy, D_y = Pxy + D_x */
+        size_t x = failed[0], y = failed[1];
+        unsigned char gyx = gf_exp[y - x];
+        unsigned char inv = gf_exp[255 - gf_log[gyx ^ 1]];
+        unsigned char a = gf_mul(gyx, inv);
+        unsigned char b = gf_mul(gf_exp[255 - x], inv);
+        unsigned char *dx = fs.blocks[base + x];
+        unsigned char *dy = fs.blocks[base + y];
+        memset(dx, 0, BLOCK_SIZE);
+        gf_mul_xor_into(dx, pxy, BLOCK_SIZE, a);
+        gf_mul_xor_into(dx, qxy, BLOCK_SIZE, b);
+        memcpy(dy, pxy, BLOCK_SIZE);
+        xor_into(dy, dx, BLOCK_SIZE);
+    } else {
+        return false;
+    }
+    
+    for (size_t f = 0; f < num_failed; f++) {
+        if (block_checksum(fs.blocks[base + failed[f]]) != parity.block_crc[base + failed[f]]) {
+            return false;
+        }
+    }
+    parity.rebuilt_blocks += num_failed;
+    return true;
+}
+
+/**
+ * Comprueba el CRC de un bloque y lo reconstruye si está dañado
+ * @param block Bloque físico
+ * @return true si el bloque es (o vuelve a ser) válido
+ */
+static bool ensure_block_intact(size_t block) {
+    if (parity.level == 0 ||
+        block_checksum(fs.blocks[block]) == parity.block_crc[block]) {
+        return true;
+    }
+    return rebuild_group(block);
+}
+
+/**
+ * Recalcula desde cero la paridad y los CRC de un grupo
+ * @param group Grupo de paridad
+ */
+static void recompute_group_parity(size_t group) {
+    size_t base = group * PARITY_GROUP;
+    memset(parity.p[group], 0, BLOCK_SIZE);
+    memset(parity.q[group], 0, BLOCK_SIZE);
+    for (size_t j = 0; j < PARITY_GROUP; j++) {
+        xor_into(parity.p[group], fs.blocks[base + j], BLOCK_SIZE);
+        gf_mul_xor_into(parity.q[group], fs.blocks[base + j], BLOCK_SIZE, gf_exp[j]);
+        parity.block_crc[base + j] = block_checksum(fs.blocks[base + j]);
+    }
+    parity.p_crc[group] = block_checksum(parity.p[group]);
+    parity.q_crc[group] = block_checksum(parity.q[group]);
+}
+
+/**
+ * Anota la página de un bloque que se va a escribir: en un volumen
+ * superpuesto, la primera escritura hace que el kernel la copie de la
+ * imagen base a la capa superior
+ * @param block Bloque físico
+ */
+static void overlay_note(size_t block) {
+    size_t per_page = store.page_size / BLOCK_SIZE > 0 ? store.page_size / BLOCK_SIZE : 1;
+    size_t first = block - block % per_page;
+    if (!overlay.copied[first]) {
+        overlay.copied[first] = true;
+        overlay.copied_pages++;
+    }
+}
+
+/**
+ * Modifica bytes de un bloque de datos manteniendo la paridad: la paridad
+ * se actualiza de forma incremental con el delta (antiguo XOR nuevo), sin
+ * releer el resto del grupo
+ * @param block Bloque físico
+ * @param pos Posición dentro del bloque
+ * @param src Bytes nuevos, NULL para escribir ceros
+ * @param len Número de bytes
+ */
+static void store_bytes(size_t block, size_t pos, const void *src, size_t len) {
+    unsigned char *dst = &fs.blocks[block][pos];
+    
+    export_unlend(block, 1);
+    journal_block(block);
+    if (store.kind == STORE_OVERLAY) {
+        overlay_note(block);
+    }
+    
+    if (parity.level == 0) {
+        if (src != NULL) {
+            memcpy(dst, src, len);
+        } else {
+            memset(dst, 0, len);
+        }
+        return;
+    }
+    
+    size_t group = block / PARITY_GROUP;
+    if (!ensure_block_intact(block)) {
+        /* Los datos antiguos se perdieron: recalcular la paridad del grupo */
+        if (src != NULL) {
+            memcpy(dst, src, len);
+        } else {
+            memset(dst, 0, len);
+        }
+        recompute_group_parity(group);
+        return;
+    }
+    
+    unsigned char delta[BLOCK_SIZE];
+    if (src != NULL) {
+        memcpy(delta, src, len);
+    } else {
+        memset(delta, 0, len);
+    }
+    xor_into(delta, dst, len);      /* delta = nuevo ^ antiguo */
+    xor_into(dst, delta, len);      /* dst = nuevo */
+    
+    xor_into(&parity.p[group][pos], delta, len);
+    parity.p_crc[group] = block_checksum(parity.p[group]);
+    parity.parity_bytes += len;
+    if (parity.level == 2) {
+        gf_mul_xor_into(&parity.q[group][pos], delta, len, gf_exp[block % PARITY_GROUP]);
+        parity.q_crc[group] = block_checksum(parity.q[group]);
+        parity.parity_bytes += len;
+    }
+    parity.block_crc[block] = block_checksum(fs.blocks[block]);
+    parity.data_bytes += len;
+}
+
+/**
+ * Devuelve al sistema un tramo de páginas del almacén. Los bloques ya
+ * están a cero, así que el contenido (y con él CRC y paridad) no cambia:
+ * la próxima lectura obtiene páginas a cero nuevas.
+ * @param first Primer bloque del tramo (alineado a página)
+ * @param pages Número de páginas
+ * @return 0 si es exitoso, -1 en caso de error
+ */
+static int reclaim_release(size_t first, size_t pages) {
+    size_t len = pages * store.page_size;
+    int rc;
+    if (store.kind == STORE_OVERLAY) {
+        return -1;  /* Soltar la copia privada devolvería el contenido de la base */
+    }
+    if (store.kind == STORE_MEMFD) {
+        rc = fallocate(store.fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE,
+                       (off_t)(first * BLOCK_SIZE), (off_t)len);
+    } else {
+        rc = madvise(fs.blocks[first], len, MADV_DONTNEED);
+    }
+    reclaim.release_calls++;
+    if (rc != 0) {
+        return -1;
+    }
+    reclaim.released_pages += pages;
+    return 0;
+}
+
+/**
+ * Devuelve las páginas pendientes que siguen completamente libres,
+ * agrupando las consecutivas en una sola llamada. Las páginas que se
+ * volvieron a asignar entretanto simplemente se descartan.
+ */
+static void reclaim_flush(void) {
+    size_t per_page = store.page_size / BLOCK_SIZE;
+    size_t run_start = 0, run_pages = 0;
+    
+    for (size_t first = 0; first < MAX_BLOCKS; first += per_page) {
+        bool release = false;
+        if (reclaim.pending[first]) {
+            reclaim.pending[first] = false;
+            release = true;
+            for (size_t j = 0; j < per_page && release; j++) {
+                release = fs.block_map[first + j] == BLOCK_FREE;
+            }
+        }
+        if (release) {
+            if (run_pages == 0) {
+                run_start = first;
+            }
+            run_pages++;
+        } else if (run_pages > 0) {
+            reclaim_release(run_start, run_pages);
+            run_pages = 0;
+        }
+    }
+    if (run_pages > 0) {
+        reclaim_release(run_start, run_pages);
+    }
+    reclaim.pending_pages = 0;
+}
+
+/**
+ * Anota las páginas de un tramo de bloques recién liberado y, cuando se
+ * acumulan RECLAIM_BATCH_PAGES páginas, las devuelve todas de una vez
+ * para no hacer una llamada al sistema por bloque ni soltar páginas que
+ * se reutilizan enseguida
+ * @param start Primer bloque liberado
+ * @param count Número de bloques
+ */
+static void reclaim_note(size_t start, size_t count) {
+    if (fs.blocks == NULL || store.kind == STORE_OVERLAY ||
+        store.page_size % BLOCK_SIZE != 0 || store.page_size > BLOCK_STORE_SIZE) {
+        return;
+    }
+    size_t per_page = store.page_size / BLOCK_SIZE;
+    for (size_t first = start - start % per_page; first < start + count; first += per_page) {
+        if (!reclaim.pending[first]) {
+            reclaim.pending[first] = true;
+            if (++reclaim.pending_pages >= RECLAIM_BATCH_PAGES) {
+                reclaim_flush();
+            }
+        }
+    }
+}
+
+/**
+ * Devuelve al sistema todo el almacén con una sola llamada, descartando
+ * las páginas pendientes: todos los bloques pasan a leerse como ceros
+ * @return 0 si es exitoso, -1 si el almacén no lo permite (superpuesto)
+ */
+static int reclaim_all(void) {
+    export_unlend(0, MAX_BLOCKS);
+    memset(reclaim.pending, 0, sizeof(reclaim.pending));
+    reclaim.pending_pages = 0;
+    if (BLOCK_STORE_SIZE % store.page_size != 0) {
+        return -1;
+    }
+    return reclaim_release(0, BLOCK_STORE_SIZE / store.page_size);
+}
+
+/**
+ * Reinicia el almacenamiento y los metadatos sin mostrar mensajes
+ * @param policy Política de asignación de bloques a utilizar
+ */
+static void reset_filesystem(AllocPolicy policy) {
+    /* Limpiar todos los bloques, devolviendo sus páginas si es posible */
+    if (reclaim_all() != 0) {
+        memset(fs.blocks, 0, BLOCK_STORE_SIZE);
+    }
+    
+    /*
+     * Marcar los bloques del volumen como libres. Los que quedan fuera de
+     * la capacidad se marcan reservados (sin contarlos en used_blocks) para
+     * que ninguna política los asigne hasta que GROW los libere.
+     */
+    for (size_t i = 0; i < MAX_BLOCKS; i++) {
+        fs.block_map[i] = i >= initial_blocks ? BLOCK_RESERVED : BLOCK_FREE;
+    }
+    fs.capacity_blocks = initial_blocks;
+    fs.format_gen = 1;
+    
+    /* Limpiar tabla de archivos */
+    for (size_t i = 0; i < MAX_FILES; i++) {
+        fs.file_table[i].in_use = false;
+        fs.file_table[i].filename[0] = '\0';
+        fs.file_table[i].size = 0;
+        fs.file_table[i].num_blocks = 0;
+        fs.file_table[i].extent_len = 0;
+        fs.file_table[i].packed_len = 0;
+        fs.file_table[i].cold = false;
+        fs.file_table[i].format_gen = 0;
+    }
+    memset(fs.name_index, 0, sizeof(fs.name_index));
+    
+    fs.num_files = 0;
+    fs.used_blocks = 0;
+    fs.total_storage = 0;
+    fs.policy = policy;
+    parity_reset();
+    
+    if (alloc_policies[policy].reset != NULL) {
+        alloc_policies[policy].reset();
+    }
+}
+
+/**
+ * Inicializa el sistema de archivos
+ * @param policy Política de asignación de bloques a utilizar
+ */
+void init_filesystem(AllocPolicy policy) {
+    reset_filesystem(policy);
+    
+    out_printf("Sistema de archivos inicializado.\n");
+    out_printf("  - Tamano de bloque: %d bytes\n", BLOCK_SIZE);
+    out_printf("  - Numero maximo de archivos: %d\n", MAX_FILES);
+    out_printf("  - Almacenamiento maximo: %zu bytes (%zu KB)\n",
+               fs.capacity_blocks * BLOCK_SIZE, fs.capacity_blocks * BLOCK_SIZE / 1024);
+    out_printf("  - Numero maximo de bloques: %zu\n", fs.capacity_blocks);
+    if (fs.capacity_blocks < MAX_BLOCKS) {
+        out_printf("  - Ampliable con GROW hasta: %d KB\n", MAX_STORAGE / 1024);
+    }
+    if (thin.physical_blocks < fs.capacity_blocks) {
+        out_printf("  - Espacio fisico: %zu KB (aprovisionamiento fino)\n",
+                   thin.physical_blocks * BLOCK_SIZE / 1024);
+    }
+    out_printf("  - Politica de asignacion: %s\n", alloc_policies[policy].name);
+    out_printf("  - Paridad: %s\n\n", parity.level == 0 ? "desactivada"
+                                 : parity.level == 1 ? "P (XOR)" : "P + Q (RAID-6)");
+}
+
+/**
+ * Hash FNV-1a de un nombre de archivo
+ * @param filename Nombre
+ * @return Hash de 32 bits
+ */
+static uint32_t name_hash(const char *filename) {
+    uint32_t hash = 2166136261u;
+    for (const unsigned char *c = (const unsigned char *)filename; *c != '\0'; c++) {
+        hash = (hash ^ *c) * 16777619u;
+    }
+    return hash;
+}
+
+/**
+ * Indica si un hueco del índice de nombres pertenece a la generación
+ * actual del volumen; los de generaciones anteriores se tratan como
+ * marcas de borrado hasta que una inserción los reutiliza
+ * @param slot Hueco del índice
+ * @return true si el hueco está ocupado y es válido
+ */
+static bool name_slot_live(size_t slot) {
+    return fs.name_index[slot].file != 0 && fs.name_index[slot].format_gen == fs.format_gen;
+}
+
+/**
+ * Indica si una entrada de la tabla de archivos está en uso en la
+ * generación actual del volumen
+ * @param file Entrada
+ * @return true si la entrada es un archivo vigente
+ */
+static bool file_live(const FileEntry *file) {
+    return file->in_use && file->format_gen == fs.format_gen;
+}
+
+/**
+ * Agrega una entrada de la tabla de archivos al índice de nombres
+ * (sondeo lineal). Ocupa el primer hueco vacío o de una generación
+ * anterior.
+ * @param file_index Posición en file_table
+ */
+static void name_index_insert(size_t file_index) {
+    uint32_t hash = name_hash(fs.file_table[file_index].filename);
+    size_t slot = hash & (NAME_INDEX_SLOTS - 1);
+    while (name_slot_live(slot)) {
+        slot = (slot + 1) & (NAME_INDEX_SLOTS - 1);
+    }
+    fs.name_index[slot].hash = hash;
+    fs.name_index[slot].file = (uint16_t)(file_index + 1);
+    fs.name_index[slot].format_gen = fs.format_gen;
+    journal_name(slot);
+}
+
+/**
+ * Quita una entrada del índice de nombres. Los huecos siguientes de la
+ * misma secuencia de sondeo se desplazan hacia atrás, de modo que el
+ * índice nunca acumula marcas de borrado (salvo las que deja FORMAT, que
+ * se desplazan igual que las demás).
+ * @param file_index Posición en file_table
+ */
+static void name_index_remove(size_t file_index) {
+    uint32_t hash = name_hash(fs.file_table[file_index].filename);
+    size_t slot = hash & (NAME_INDEX_SLOTS - 1);
+    for (size_t n = 0; !(fs.name_index[slot].file == file_index + 1 && name_slot_live(slot)); n++) {
+        if (fs.name_index[slot].file == 0 || n == NAME_INDEX_SLOTS) {
+            return;  /* No estaba indexada */
+        }
+        slot = (slot + 1) & (NAME_INDEX_SLOTS - 1);
+    }
+    
+    size_t hole = slot;
+    size_t next = (hole + 1) & (NAME_INDEX_SLOTS - 1);
+    for (size_t n = 1; n < NAME_INDEX_SLOTS && fs.name_index[next].file != 0; n++) {
+        /* Se mueve si su posición ideal no está entre el hueco y él */
+        size_t home = fs.name_index[next].hash & (NAME_INDEX_SLOTS - 1);
+        if (((next - home) & (NAME_INDEX_SLOTS - 1)) >= ((next - hole) & (NAME_INDEX_SLOTS - 1))) {
+            fs.name_index[hole] = fs.name_index[next];
+            journal_name(hole);
+            hole = next;
+        }
+        next = (next + 1) & (NAME_INDEX_SLOTS - 1);
+    }
+    fs.name_index[hole].hash = 0;
+    fs.name_index[hole].file = 0;
+    fs.name_index[hole].format_gen = 0;
+    journal_name(hole);
+}
+
+/**
+ * Busca un archivo por su nombre a través del índice de nombres. Tras
+ * varios FORMAT el índice puede no tener huecos vacíos, así que el
+ * sondeo se limita a NAME_INDEX_SLOTS pasos.
+ * @param filename Nombre del archivo a buscar
+ * @return Puntero al archivo si existe, NULL en caso contrario
+ */
+FileEntry* find_file(const char *filename) {
+    uint32_t hash = name_hash(filename);
+    size_t slot = hash & (NAME_INDEX_SLOTS - 1);
+    for (size_t n = 0; n < NAME_INDEX_SLOTS && fs.name_index[slot].file != 0; n++) {
+        FileEntry *file = &fs.file_table[fs.name_index[slot].file - 1];
+        if (name_slot_live(slot) && fs.name_index[slot].hash == hash && file_live(file) &&
+            strcmp(file->filename, filename) == 0) {
+            return file;
+        }
+        slot = (slot + 1) & (NAME_INDEX_SLOTS - 1);
+    }
+    return NULL;
+}
+
+/**
+ * Marca un bloque libre como ocupado en la generación actual. Si lo
+ * ocupaba una generación anterior todavía guarda sus datos, así que se
+ * limpia ahora en lugar de hacerlo en FORMAT.
+ * @param block Bloque físico
+ */
+static void claim_block(size_t block) {
+    if (fs.block_map[block] != BLOCK_FREE) {
+        store_bytes(block, 0, NULL, BLOCK_SIZE);
+    }
+    fs.block_map[block] = fs.format_gen;
+}
+
+/**
+ * Asigna bloques con el sistema buddy. La petición se descompone en
+ * potencias de dos (p. ej. 13 = 8 + 4 + 1) y cada trozo es un extent
+ * alineado a su tamaño; si no queda un bloque del orden pedido se piden
+ * dos del orden inferior.
+ * @param num_blocks Número de bloques a asignar
+ * @param block_list Array donde se guardarán los índices de bloques asignados
+ * @param goal Ignorado: la posición la determina el orden del trozo
+ * @return Número de bloques asignados exitosamente
+ */
+static size_t buddy_allocate(size_t num_blocks, BlockNo *block_list, size_t goal) {
+    (void)goal;
+    size_t need[BUDDY_MAX_ORDER + 1];
+    for (int k = 0; k <= BUDDY_MAX_ORDER; k++) {
+        need[k] = (num_blocks >> k) & 1;
+    }
+    
+    size_t allocated = 0;
+    for (int k = BUDDY_MAX_ORDER; k >= 0; k--) {
+        while (need[k] > 0) {
+            size_t start = buddy_take(k);
+            if (start == NO_BLOCK) {
+                if (k == 0) {
+                    return allocated;  /* Sin espacio */
+                }
+                need[k - 1] += 2 * need[k];
+                need[k] = 0;
+                break;
+            }
+            
+            for (size_t j = 0; j < ((size_t)1 << k); j++) {
+                claim_block(start + j);
+                block_list[allocated++] = (BlockNo)(start + j);
+            }
+            fs.used_blocks += (size_t)1 << k;
+            need[k]--;
+        }
+    }
+    
+    return allocated;
+}
+
+/**
+ * Marca como ocupado un tramo de bloques consecutivos
+ * @param start Primer bloque del tramo
+ * @param count Número de bloques del tramo
+ * @param block_list Array donde se guardarán los índices asignados
+ */
+static void claim_run(size_t start, size_t count, BlockNo *block_list) {
+    for (size_t j = 0; j < count; j++) {
+        claim_block(start + j);
+        block_list[j] = (BlockNo)(start + j);
+    }
+    fs.used_blocks += count;
+}
+
+/**
+ * Mide el tramo libre que empieza en un bloque
+ * @param start Primer bloque del tramo
+ * @param limit Longitud a partir de la cual se deja de contar
+ * @return Longitud del tramo libre (como máximo limit)
+ */
+static size_t free_run_at(size_t start, size_t limit) {
+    size_t len = 0;
+    while (start + len < MAX_BLOCKS && len < limit && !block_taken(start + len)) {
+        len++;
+    }
+    return len;
+}
+
+/**
+ * Busca, recorriendo el mapa circularmente desde un bloque, el primer
+ * tramo libre de al menos num_blocks bloques
+ * @param from Bloque donde comienza la búsqueda
+ * @param num_blocks Longitud mínima del tramo
+ * @return Primer bloque del tramo, NO_BLOCK si no existe
+ */
+static size_t find_run_from(size_t from, size_t num_blocks) {
+    size_t i = from % MAX_BLOCKS;
+    size_t scanned = 0;
+    
+    while (scanned < MAX_BLOCKS) {
+        if (block_taken(i)) {
+            i = (i + 1) % MAX_BLOCKS;
+            scanned++;
+            continue;
+        }
+        size_t len = free_run_at(i, num_blocks);
+        if (len >= num_blocks) {
+            return i;
+        }
+        /* Saltar el tramo corto completo */
+        scanned += len;
+        i = (i + len) % MAX_BLOCKS;
+    }
+    return NO_BLOCK;
+}
+
+/**
+ * Asigna bloques dispersos recorriendo el mapa circularmente desde un bloque
+ * @param num_blocks Número de bloques a asignar
+ * @param block_list Array donde se guardarán los índices asignados
+ * @param from Bloque donde comienza el recorrido
+ * @return Número de bloques asignados
+ */
+static size_t scatter_allocate(size_t num_blocks, BlockNo *block_list, size_t from) {
+    size_t allocated = 0;
+    for (size_t n = 0; n < MAX_BLOCKS && allocated < num_blocks; n++) {
+        size_t i = (from + n) % MAX_BLOCKS;
+        if (!block_taken(i)) {
+            claim_block(i);
+            block_list[allocated] = (BlockNo)i;
+            allocated++;
+            fs.used_blocks++;
+        }
+    }
+    return allocated;
+}
+
+/**
+ * Primer ajuste: primer tramo consecutivo desde el bloque 0; si no existe,
+ * bloques dispersos
+ * @param num_blocks Número de bloques a asignar
+ * @param block_list Array donde se guardarán los índices asignados
+ * @param goal Ignorado por esta política
+ * @return Número de bloques asignados
+ */
+static size_t first_fit_allocate(size_t num_blocks, BlockNo *block_list, size_t goal) {
+    (void)goal;
+    size_t start = find_run_from(0, num_blocks);
+    if (start != NO_BLOCK) {
+        claim_run(start, num_blocks, block_list);
+        return num_blocks;
+    }
+    return scatter_allocate(num_blocks, block_list, 0);
+}
+
+/* Cursor rotatorio de next-fit: bloque siguiente a la última asignación */
+static size_t next_fit_cursor;
+
+/**
+ * Reinicia el cursor de next-fit
+ */
+static void next_fit_reset(void) {
+    next_fit_cursor = 0;
+}
+
+/**
+ * Siguiente ajuste: como primer ajuste, pero la búsqueda continúa donde
+ * terminó la asignación anterior
+ * @param num_blocks Número de bloques a asignar
+ * @param block_list Array donde se guardarán los índices asignados
+ * @param goal Ignorado por esta política
+ * @return Número de bloques asignados
+ */
+static size_t next_fit_allocate(size_t num_blocks, BlockNo *block_list, size_t goal) {
+    (void)goal;
+    size_t allocated;
+    size_t start = find_run_from(next_fit_cursor, num_blocks);
+    if (start != NO_BLOCK) {
+        claim_run(start, num_blocks, block_list);
+        allocated = num_blocks;
+    } else {
+        allocated = scatter_allocate(num_blocks, block_list, next_fit_cursor);
+    }
+    if (allocated > 0) {
+        next_fit_cursor = (block_list[allocated - 1] + 1) % MAX_BLOCKS;
+    }
+    return allocated;
+}
+
+/**
+ * Mejor ajuste: el tramo libre más corto que aún admite la petición
+ * @param num_blocks Número de bloques a asignar
+ * @param block_list Array donde se guardarán los índices asignados
+ * @param goal Ignorado por esta política
+ * @return Número de bloques asignados
+ */
+static size_t best_fit_allocate(size_t num_blocks, BlockNo *block_list, size_t goal) {
+    (void)goal;
+    size_t best = NO_BLOCK;
+    size_t best_len = 0;
+    
+    for (size_t i = 0; i < MAX_BLOCKS; ) {
+        if (block_taken(i)) {
+            i++;
+            continue;
+        }
+        size_t len = free_run_at(i, MAX_BLOCKS);
+        if (len >= num_blocks && (best == NO_BLOCK || len < best_len)) {
+            best = i;
+            best_len = len;
+            if (len == num_blocks) {
+                break;  /* Ajuste exacto */
+            }
+        }
+        i += len;
+    }
+    
+    if (best != NO_BLOCK) {
+        claim_run(best, num_blocks, block_list);
+        return num_blocks;
+    }
+    return scatter_allocate(num_blocks, block_list, 0);
+}
+
+/**
+ * Ubicación por localidad: coloca el tramo lo más cerca posible del bloque
+ * objetivo. La búsqueda avanza hacia ambos lados desde el objetivo y se
+ * detiene en el primer tramo suficiente de cada lado, por lo que su coste
+ * depende de la distancia y no del tamaño del volumen.
+ * @param num_blocks Número de bloques a asignar
+ * @param block_list Array donde se guardarán los índices asignados
+ * @param goal Bloque objetivo, NO_BLOCK si no hay preferencia
+ * @return Número de bloques asignados
+ */
+static size_t locality_allocate(size_t num_blocks, BlockNo *block_list, size_t goal) {
+    if (goal == NO_BLOCK || goal >= MAX_BLOCKS) {
+        return first_fit_allocate(num_blocks, block_list, goal);
+    }
+    
+    /* Tramo libre que contiene al objetivo */
+    size_t lo = goal;
+    size_t hi = goal;
+    while (lo > 0 && !block_taken(lo - 1)) {
+        lo--;
+    }
+    while (hi < MAX_BLOCKS && !block_taken(hi)) {
+        hi++;
+    }
+    if (hi - lo >= num_blocks) {
+        size_t start = goal + num_blocks <= hi ? goal : hi - num_blocks;
+        claim_run(start, num_blocks, block_list);
+        return num_blocks;
+    }
+    
+    /* Hacia adelante: primer tramo suficiente que empiece después */
+    size_t fwd = NO_BLOCK;
+    for (size_t i = hi; i < MAX_BLOCKS; ) {
+        if (block_taken(i)) {
+            i++;
+            continue;
+        }
+        size_t len = free_run_at(i, num_blocks);
+        if (len >= num_blocks) {
+            fwd = i;
+            break;
+        }
+        i += len;
+    }
+    
+    /* Hacia atrás: último tramo suficiente que termine antes */
+    size_t bwd = NO_BLOCK;
+    for (size_t end = lo; end > 0; ) {
+        if (block_taken(end - 1)) {
+            end--;
+            continue;
+        }
+        size_t len = 0;
+        while (len < end && len < num_blocks && !block_taken(end - len - 1)) {
+            len++;
+        }
+        if (len >= num_blocks) {
+            bwd = end - num_blocks;
+            break;
+        }
+        end -= len;
+    }
+    
+    size_t best = fwd;
+    if (bwd != NO_BLOCK && (fwd == NO_BLOCK || goal - bwd < fwd - goal)) {
+        best = bwd;
+    }
+    if (best != NO_BLOCK) {
+        claim_run(best, num_blocks, block_list);
+        return num_blocks;
+    }
+    return scatter_allocate(num_blocks, block_list, goal);
+}
+
+/* Tabla de políticas de asignación, indexada por AllocPolicy */
+static const AllocPolicyOps alloc_policies[ALLOC_NUM_POLICIES] = {
+    [ALLOC_FIRST_FIT] = { "first-fit", first_fit_allocate, NULL, NULL, NULL },
+    [ALLOC_NEXT_FIT]  = { "next-fit", next_fit_allocate, NULL, next_fit_reset, NULL },
+    [ALLOC_BEST_FIT]  = { "best-fit", best_fit_allocate, NULL, NULL, NULL },
+    [ALLOC_LOCALITY]  = { "locality", locality_allocate, NULL, NULL, NULL },
+    [ALLOC_BUDDY]     = { "buddy", buddy_allocate, buddy_release, buddy_rebuild, buddy_format },
+};
+
+/**
+ * Busca una política por su nombre
+ * @param name Nombre de la política (p. ej. "best-fit")
+ * @param policy Donde se guarda la política encontrada
+ * @return true si existe, false en caso contrario
+ */
+bool policy_from_name(const char *name, AllocPolicy *policy) {
+    for (int i = 0; i < ALLOC_NUM_POLICIES; i++) {
+        if (strcmp(alloc_policies[i].name, name) == 0) {
+            *policy = (AllocPolicy)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Muestra un error de una operación que también usa el hilo del nivel
+ * frío; en un hilo sin consola (quiet_thread) no escribe nada y el error
+ * solo llega como código de retorno
+ * @param format Formato de printf
+ */
+static void console_error(const char *format, ...) {
+    if (quiet_thread) {
+        return;
+    }
+    va_list args;
+    va_start(args, format);
+    vfprintf(cmd_out(), format, args);
+    va_end(args);
+}
+
+/**
+ * Compara la ocupación física con las marcas de agua de un volumen fino y
+ * avisa una vez al cruzar cada marca hacia arriba; la alerta se rearma
+ * cuando la ocupación vuelve a bajar
+ */
+static void thin_check_watermarks(void) {
+    if (thin.physical_blocks >= fs.capacity_blocks) {
+        return;  /* Sin sobreasignación no hay nada que vigilar */
+    }
+    if (quiet_thread) {
+        return;  /* El siguiente comando dará el aviso si sigue haciendo falta */
+    }
+    
+    size_t pct = fs.used_blocks * 100 / thin.physical_blocks;
+    int level = pct >= WATERMARK_HIGH ? 2 : pct >= WATERMARK_LOW ? 1 : 0;
+    if (level > thin.alert_level) {
+        out_printf("Aviso: el volumen usa el %zu%% del espacio fisico (%zu de %zu bloques)%s.\n",
+                   pct, fs.used_blocks, thin.physical_blocks,
+                   level == 2 ? "; liberar espacio o ampliar el respaldo" : "");
+        thin.alerts++;
+    }
+    thin.alert_level = level;
+}
+
+/**
+ * Asigna bloques para un archivo según la política activa, indicando un
+ * bloque objetivo cerca del cual conviene ubicarlos
+ * @param num_blocks Número de bloques a asignar
+ * @param block_list Array donde se guardarán los índices de bloques asignados
+ * @param goal Bloque objetivo, NO_BLOCK si no hay preferencia
+ * @return Número de bloques asignados exitosamente, 0 si no hay espacio suficiente
+ */
+size_t allocate_blocks_near(size_t num_blocks, BlockNo *block_list, size_t goal) {
+    if (num_blocks == 0 || num_blocks > MAX_BLOCKS) {
+        return 0;
+    }
+    
+    if (fs.used_blocks + num_blocks > fs.capacity_blocks) {
+        return 0;  /* No hay suficiente espacio */
+    }
+    if (fs.used_blocks + num_blocks > thin.physical_blocks) {
+        console_error("Error: Espacio fisico agotado (%zu de %zu bloques en uso).\n",
+                      fs.used_blocks, thin.physical_blocks);
+        return 0;
+    }
+    
+    size_t allocated = alloc_policies[fs.policy].allocate(num_blocks, block_list, goal);
+    for (size_t i = 0; i < allocated; i++) {
+        journal_map(block_list[i]);
+    }
+    thin_check_watermarks();
+    return allocated;
+}
+
+/**
+ * Asigna bloques para un archivo según la política activa
+ * @param num_blocks Número de bloques a asignar
+ * @param block_list Array donde se guardarán los índices de bloques asignados
+ * @return Número de bloques asignados exitosamente, 0 si no hay espacio suficiente
+ */
+size_t allocate_blocks(size_t num_blocks, BlockNo *block_list) {
+    return allocate_blocks_near(num_blocks, block_list, NO_BLOCK);
+}
+
+/**
+ * Escribe un entero como varint (7 bits por byte, el bit alto indica que
+ * sigue otro byte)
+ * @param dst Buffer de destino
+ * @param pos Posición donde escribir
+ * @param value Valor
+ * @return Posición tras el varint
+ */
+static size_t varint_put(uint8_t *dst, size_t pos, uint32_t value) {
+    while (value >= 0x80) {
+        dst[pos++] = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    dst[pos++] = (uint8_t)value;
+    return pos;
+}
+
+/**
+ * Lee un varint escrito con varint_put
+ * @param src Buffer de origen
+ * @param pos Posición de lectura, se avanza tras el varint
+ * @return Valor leído
+ */
+static uint32_t varint_get(const uint8_t *src, size_t *pos) {
+    uint32_t value = 0;
+    for (int shift = 0; shift < 35; shift += 7) {
+        uint8_t byte = src[(*pos)++];
+        value |= (uint32_t)(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) {
+            break;
+        }
+    }
+    return value;
+}
+
+/**
+ * Codifica una lista de bloques como tramos. Cada tramo empieza con el
+ * varint (longitud - 1) << 1 | hueco; los tramos de datos añaden el
+ * desplazamiento (zigzag) de su primer bloque respecto al final del tramo
+ * de datos anterior, que en un archivo contiguo es 0. Un extent ocupa así
+ * 2 bytes en el caso habitual, frente a 8 por bloque con size_t.
+ * @param blocks Bloques lógicos -> físicos
+ * @param num_blocks Número de bloques
+ * @param out Buffer de al menos EXTENT_BYTES + 16 bytes
+ * @return Bytes escritos, -1 si no caben en EXTENT_BYTES
+ */
+static int extents_encode(const BlockNo *blocks, size_t num_blocks, uint8_t *out) {
+    size_t pos = 0;
+    int64_t prev_end = 0;
+    
+    for (size_t i = 0; i < num_blocks; ) {
+        size_t run = 1;
+        if (blocks[i] == NO_BLOCK) {
+            while (i + run < num_blocks && blocks[i + run] == NO_BLOCK) {
+                run++;
+            }
+            pos = varint_put(out, pos, (uint32_t)((run - 1) << 1 | 1));
+        } else {
+            while (i + run < num_blocks && blocks[i + run] == blocks[i] + run) {
+                run++;
+            }
+            int64_t delta = (int64_t)blocks[i] - prev_end;
+            pos = varint_put(out, pos, (uint32_t)((run - 1) << 1));
+            pos = varint_put(out, pos, (uint32_t)(delta < 0 ? -2 * delta - 1 : 2 * delta));
+            prev_end = (int64_t)blocks[i] + (int64_t)run;
+        }
+        if (pos > EXTENT_BYTES) {
+            return -1;  /* Cada tramo escribe como mucho 10 bytes: el margen basta */
+        }
+        i += run;
+    }
+    return (int)pos;
+}
+
+/**
+ * Decodifica la lista de extents de una entrada
+ * @param file Archivo
+ * @param blocks Destino, al menos file->num_blocks elementos
+ */
+static void extents_decode(const FileEntry *file, BlockNo *blocks) {
+    size_t pos = 0, n = 0;
+    int64_t prev_end = 0;
+    
+    while (pos < file->extent_len && n < file->num_blocks) {
+        uint32_t header = varint_get(file->extents, &pos);
+        size_t run = (header >> 1) + 1;
+        if (run > file->num_blocks - n) {
+            run = file->num_blocks - n;
+        }
+        if (header & 1) {
+            for (size_t j = 0; j < run; j++) {
+                blocks[n++] = NO_BLOCK;
+            }
+        } else {
+            uint32_t zz = varint_get(file->extents, &pos);
+            int64_t start = prev_end + ((zz & 1) ? -(int64_t)(zz >> 1) - 1 : (int64_t)(zz >> 1));
+            for (size_t j = 0; j < run; j++) {
+                blocks[n++] = (BlockNo)(start + (int64_t)j);
+            }
+            prev_end = start + (int64_t)run;
+        }
+    }
+    while (n < file->num_blocks) {
+        blocks[n++] = NO_BLOCK;  /* Entrada truncada: el resto se lee como hueco */
+    }
+}
+
+/**
+ * Busca el hueco de la caché de una entrada, o el menos usado para
+ * reemplazarlo
+ * @param file Archivo
+ * @param found Se pone a true si el hueco ya contiene la entrada
+ * @return Hueco de la caché
+ */
+static ExtentCacheSlot *extent_cache_slot(const FileEntry *file, bool *found) {
+    ExtentCacheSlot *victim = &extent_cache.slots[0];
+    for (size_t i = 0; i < EXTENT_CACHE_SLOTS; i++) {
+        ExtentCacheSlot *slot = &extent_cache.slots[i];
+        if (slot->file == file) {
+            *found = slot->generation == file->generation;
+            slot->last_use = ++extent_cache.clock;
+            return slot;
+        }
+        if (slot->last_use < victim->last_use) {
+            victim = slot;
+        }
+    }
+    *found = false;
+    victim->file = file;
+    victim->last_use = ++extent_cache.clock;
+    return victim;
+}
+
+/**
+ * Lista de bloques de un archivo, decodificada desde la caché. El puntero
+ * apunta a un hueco de la caché: deja de ser válido en cuanto se llama a
+ * file_blocks() o file_set_blocks() con otro archivo (puede reutilizar el
+ * hueco) o a file_set_blocks() con este. Quien necesite la lista después
+ * de algo así debe copiarla antes, como hacen file_compress() y
+ * file_unpack() con los bloques que liberan al final.
+ * @param file Archivo
+ * @return Bloques lógicos -> físicos (NO_BLOCK = hueco)
+ */
+static const BlockNo *file_blocks(const FileEntry *file) {
+    bool found;
+    ExtentCacheSlot *slot = extent_cache_slot(file, &found);
+    if (found) {
+        extent_cache.hits++;
+    } else {
+        extent_cache.misses++;
+        extents_decode(file, slot->blocks);
+        slot->generation = file->generation;
+    }
+    return slot->blocks;
+}
+
+/**
+ * Sustituye la lista de bloques de un archivo, codificándola en su
+ * entrada; la copia decodificada queda en la caché
+ * @param file Archivo
+ * @param blocks Nueva lista (NO_BLOCK = hueco)
+ * @param num_blocks Número de bloques lógicos
+ * @return 0 si es exitoso, -1 si la lista no cabe (archivo demasiado fragmentado)
+ */
+static int file_set_blocks(FileEntry *file, const BlockNo *blocks, size_t num_blocks) {
+    uint8_t encoded[EXTENT_BYTES + 16];
+    int len = extents_encode(blocks, num_blocks, encoded);
+    if (len < 0) {
+        console_error("Error: La lista de extents de '%s' no cabe (archivo demasiado fragmentado).\n",
+                      file->filename);
+        return -1;
+    }
+    
+    memcpy(file->extents, encoded, (size_t)len);
+    file->extent_len = (uint32_t)len;
+    file->num_blocks = num_blocks;
+    file->generation++;
+    journal_file(file);
+    
+    bool found;
+    ExtentCacheSlot *slot = extent_cache_slot(file, &found);
+    if (num_blocks > 0 && slot->blocks != blocks) {
+        memcpy(slot->blocks, blocks, num_blocks * sizeof(BlockNo));
+    }
+    slot->generation = file->generation;
+    return 0;
+}
+
+/**
+ * Vacía la caché de extents (tras sustituir la tabla de archivos entera)
+ */
+static void extent_cache_clear(void) {
+    memset(extent_cache.slots, 0, sizeof(extent_cache.slots));
+}
+
+/**
+ * Cuenta los extents (tramos de bloques consecutivos) de una lista de
+ * bloques; los huecos no cuentan como extent
+ * @param num_blocks Número de bloques de la lista
+ * @param block_list Índices de bloques
+ * @return Número de extents
+ */
+static size_t count_extents(size_t num_blocks, const BlockNo *block_list) {
+    size_t extents = 0;
+    for (size_t i = 0; i < num_blocks; i++) {
+        if (block_list[i] != NO_BLOCK &&
+            (i == 0 || block_list[i] != block_list[i - 1] + 1)) {
+            extents++;
+        }
+    }
+    return extents;
+}
+
+/**
+ * Libera un tramo de bloques consecutivos de la generación actual: el
+ * contenido se limpia bloque a bloque (el journal y la paridad lo
+ * necesitan), pero la política y la devolución de páginas reciben el
+ * tramo entero de una vez
+ * @param start Primer bloque
+ * @param count Número de bloques
+ */
+static void free_run(size_t start, size_t count) {
+    for (size_t b = start; b < start + count; b++) {
+        fs.block_map[b] = BLOCK_FREE;
+        store_bytes(b, 0, NULL, BLOCK_SIZE);
+    }
+    journal_map(start);
+    journal_map(start + count - 1);
+    fs.used_blocks -= count;
+    if (alloc_policies[fs.policy].release != NULL) {
+        alloc_policies[fs.policy].release(start, count);
+    }
+    reclaim_note(start, count);
+}
+
+/**
+ * Libera bloques de memoria, agrupando los consecutivos de la lista en
+ * tramos
+ * @param num_blocks Número de bloques a liberar
+ * @param block_list Array con los índices de bloques a liberar
+ */
+void free_blocks(size_t num_blocks, const BlockNo *block_list) {
+    size_t run_start = 0, run_len = 0;
+    for (size_t i = 0; i < num_blocks; i++) {
+        size_t block = block_list[i];
+        if (block >= MAX_BLOCKS || fs.block_map[block] != fs.format_gen) {
+            continue;
+        }
+        if (run_len > 0 && block == run_start + run_len) {
+            run_len++;
+            continue;
+        }
+        if (run_len > 0) {
+            free_run(run_start, run_len);
+        }
+        run_start = block;
+        run_len = 1;
+    }
+    if (run_len > 0) {
+        free_run(run_start, run_len);
+    }
+    thin_check_watermarks();
+}
+
+/**
+ * Bloque objetivo para hacer crecer un archivo: el siguiente a su último
+ * extent, para que los bloques nuevos continúen el mismo tramo
+ * @param file Archivo que crece
+ * @return Bloque objetivo, NO_BLOCK si el archivo no tiene bloques asignados
+ */
+size_t growth_goal(const FileEntry *file) {
+    const BlockNo *blocks = file_blocks(file);
+    for (size_t i = file->num_blocks; i > 0; i--) {
+        if (blocks[i - 1] != NO_BLOCK) {
+            return (blocks[i - 1] + 1) % MAX_BLOCKS;
+        }
+    }
+    return NO_BLOCK;
+}
+
+/**
+ * Bloque objetivo para un archivo nuevo: detrás del archivo del mismo
+ * directorio (prefijo hasta la última '/') que termina más adelante en el
+ * volumen, de modo que los archivos relacionados queden juntos
+ * @param filename Nombre del archivo nuevo
+ * @return Bloque objetivo, NO_BLOCK si no hay archivos hermanos
+ */
+size_t placement_goal(const char *filename) {
+    const char *slash = strrchr(filename, '/');
+    size_t dir_len = slash != NULL ? (size_t)(slash - filename) + 1 : 0;
+    size_t goal = NO_BLOCK;
+    
+    for (size_t i = 0; i < MAX_FILES; i++) {
+        const FileEntry *sibling = &fs.file_table[i];
+        if (!file_live(sibling) || sibling->num_blocks == 0) {
+            continue;
+        }
+        const char *sibling_slash = strrchr(sibling->filename, '/');
+        size_t sibling_dir_len = sibling_slash != NULL
+                               ? (size_t)(sibling_slash - sibling->filename) + 1 : 0;
+        if (sibling_dir_len != dir_len ||
+            strncmp(sibling->filename, filename, dir_len) != 0) {
+            continue;
+        }
+        size_t candidate = growth_goal(sibling);
+        if (goal == NO_BLOCK || candidate > goal) {
+            goal = candidate;
+        }
+    }
+    return goal;
+}
+
+/**
+ * Asigna bloques físicos a los huecos de un rango de bloques lógicos de
+ * un archivo. Todos los huecos se piden en una sola asignación, con el
+ * bloque siguiente al anterior bloque asignado como objetivo, para que
+ * el rango quede contiguo si es posible.
+ * Si el rango supera el final del archivo, los bloques lógicos nuevos
+ * empiezan como huecos y el archivo crece hasta last.
+ * @param file Archivo
+ * @param first Primer bloque lógico del rango
+ * @param last Último bloque lógico del rango (inclusive)
+ * @return 0 si es exitoso, -1 si no hay espacio suficiente
+ */
+static int fill_holes(FileEntry *file, size_t first, size_t last) {
+    BlockNo blocks[MAX_FILE_BLOCKS];
+    size_t num_blocks = last + 1 > file->num_blocks ? last + 1 : file->num_blocks;
+    memcpy(blocks, file_blocks(file), file->num_blocks * sizeof(BlockNo));
+    for (size_t i = file->num_blocks; i < num_blocks; i++) {
+        blocks[i] = NO_BLOCK;
+    }
+    
+    size_t missing = 0;
+    for (size_t i = first; i <= last; i++) {
+        if (blocks[i] == NO_BLOCK) {
+            missing++;
+        }
+    }
+    if (missing == 0) {
+        return num_blocks == file->num_blocks ? 0 : file_set_blocks(file, blocks, num_blocks);
+    }
+    
+    size_t goal = NO_BLOCK;
+    for (size_t i = first; i > 0 && goal == NO_BLOCK; i--) {
+        if (blocks[i - 1] != NO_BLOCK) {
+            goal = (blocks[i - 1] + 1) % MAX_BLOCKS;
+        }
+    }
+    if (goal == NO_BLOCK) {
+        goal = placement_goal(file->filename);
+    }
+    
+    BlockNo new_blocks[MAX_FILE_BLOCKS];
+    size_t allocated = allocate_blocks_near(missing, new_blocks, goal);
+    if (allocated < missing) {
+        free_blocks(allocated, new_blocks);
+        return -1;
+    }
+    
+    size_t next = 0;
+    for (size_t i = first; i <= last; i++) {
+        if (blocks[i] == NO_BLOCK) {
+            blocks[i] = new_blocks[next++];
+        }
+    }
+    if (file_set_blocks(file, blocks, num_blocks) != 0) {
+        free_blocks(allocated, new_blocks);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Reloj monotónico en nanosegundos
+ */
+static long long now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/**
+ * Hash de los 4 bytes que empiezan en una posición
+ * @param p Bytes
+ * @param bits Bits del resultado
+ * @return Hash de bits bits
+ */
+static uint32_t lz_hash(const unsigned char *p, int bits) {
+    uint32_t v = (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+    return (v * 2654435761u) >> (32 - bits);
+}
+
+/**
+ * Longitud de la coincidencia entre dos tramos
+ * @param a Primer tramo
+ * @param b Segundo tramo
+ * @param limit Longitud máxima
+ * @return Bytes iguales desde el principio
+ */
+static size_t lz_match_len(const unsigned char *a, const unsigned char *b, size_t limit) {
+    size_t n = 0;
+    while (n < limit && a[n] == b[n]) {
+        n++;
+    }
+    return n;
+}
+
+/**
+ * Reconstruye el índice de posiciones si el diccionario cambió
+ */
+static void dict_index_refresh(void) {
+    if (dict_index.gen == fs.dict_gen) {
+        return;
+    }
+    memset(dict_index.head, 0xFF, sizeof(dict_index.head));
+    for (size_t i = 0; i + LZ_MIN_MATCH <= fs.dict_len; i++) {
+        uint32_t h = lz_hash(&fs.dict[i], DICT_HASH_BITS);
+        dict_index.prev[i] = dict_index.head[h];
+        dict_index.head[h] = (int16_t)i;
+    }
+    dict_index.gen = fs.dict_gen;
+}
+
+/**
+ * Comprime un bloque lógico como una trama independiente. Es un LZ77 cuya
+ * ventana es el diccionario seguido de lo ya codificado de la trama, así
+ * que un archivo pequeño encuentra coincidencias desde el primer byte.
+ * Tokens: 0x00-0x7F, literales (token + 1 bytes a continuación);
+ * 0x80-0xFF, coincidencia de (token & 0x7F) + LZ_MIN_MATCH bytes seguida
+ * de la distancia hacia atrás en 2 bytes (little endian).
+ * @param src Datos del bloque
+ * @param len Bytes (como mucho BLOCK_SIZE)
+ * @param dst Destino, al menos LZ_FRAME_MAX bytes
+ * @return Bytes de la trama
+ */
+static size_t lz_encode(const unsigned char *src, size_t len, unsigned char *dst) {
+    int16_t head[1 << LZ_LOCAL_BITS];
+    int16_t prev[BLOCK_SIZE];
+    size_t out = 0, literals = 0, i = 0;
+    
+    memset(head, 0xFF, sizeof(head));
+    while (i < len) {
+        size_t best_len = 0, best_dist = 0;
+        if (i + LZ_MIN_MATCH <= len) {
+            size_t limit = len - i < LZ_MAX_MATCH ? len - i : LZ_MAX_MATCH;
+            int depth = LZ_CHAIN_DEPTH;
+            for (int p = head[lz_hash(&src[i], LZ_LOCAL_BITS)]; p >= 0 && depth-- > 0; p = prev[p]) {
+                size_t n = lz_match_len(&src[p], &src[i], limit);
+                if (n > best_len) {
+                    best_len = n;
+                    best_dist = i - (size_t)p;
+                }
+            }
+            depth = LZ_CHAIN_DEPTH;
+            for (int p = dict_index.head[lz_hash(&src[i], DICT_HASH_BITS)];
+                 p >= 0 && (size_t)p < fs.dict_len && depth-- > 0; p = dict_index.prev[p]) {
+                size_t room = fs.dict_len - (size_t)p;
+                size_t n = lz_match_len(&fs.dict[p], &src[i], limit < room ? limit : room);
+                if (n > best_len) {
+                    best_len = n;
+                    best_dist = fs.dict_len - (size_t)p + i;
+                }
+            }
+        }
+        if (best_len < LZ_MIN_MATCH) {
+            best_len = 1;
+            literals++;
+        }
+        
+        /* Volcar los literales pendientes antes de una coincidencia o al llenar un token */
+        bool match = best_len >= LZ_MIN_MATCH;
+        if (literals > 0 && (match || literals == 128 || i + 1 == len)) {
+            size_t start = i + (match ? 0 : 1) - literals;
+            dst[out++] = (unsigned char)(literals - 1);
+            memcpy(&dst[out], &src[start], literals);
+            out += literals;
+            literals = 0;
+        }
+        if (match) {
+            dst[out++] = (unsigned char)(0x80 | (best_len - LZ_MIN_MATCH));
+            dst[out++] = (unsigned char)(best_dist & 0xFF);
+            dst[out++] = (unsigned char)(best_dist >> 8);
+        }
+        
+        for (size_t end = i + best_len; i < end; i++) {
+            if (i + LZ_MIN_MATCH <= len) {
+                uint32_t h = lz_hash(&src[i], LZ_LOCAL_BITS);
+                prev[i] = head[h];
+                head[h] = (int16_t)i;
+            }
+        }
+    }
+    return out;
+}
+
+/**
+ * Descomprime una trama de lz_encode. Los literales y las copias largas
+ * se mueven de LZ_SLACK en LZ_SLACK bytes, así que tras src deben poder
+ * leerse LZ_SLACK bytes inicializados y tras dst escribirse otros tantos.
+ * @param src Trama
+ * @param len Bytes de la trama
+ * @param dst Destino
+ * @param cap Bytes disponibles en dst
+ * @return Bytes producidos, -1 si la trama no es válida
+ */
+static int lz_decode(const unsigned char *src, size_t len, unsigned char *dst, size_t cap) {
+    const unsigned char *dict = fs.dict;
+    size_t dict_len = fs.dict_len;
+    size_t in = 0, out = 0;
+    while (in < len) {
+        unsigned char token = src[in++];
+        if (token < 0x80) {
+            size_t n = (size_t)token + 1;
+            if (n > len - in || n > cap - out) {
+                return -1;
+            }
+            for (size_t k = 0; k < n; k += LZ_SLACK) {
+                memcpy(&dst[out + k], &src[in + k], LZ_SLACK);
+            }
+            in += n;
+            out += n;
+            continue;
+        }
+        
+        size_t n = (size_t)(token & 0x7F) + LZ_MIN_MATCH;
+        if (len - in < 2) {
+            return -1;
+        }
+        size_t dist = (size_t)src[in] | (size_t)src[in + 1] << 8;
+        in += 2;
+        if (dist == 0 || dist > dict_len + out || n > cap - out) {
+            return -1;
+        }
+        /* Posición en la ventana diccionario + trama: primero la parte del
+           diccionario (exacta si está al final del arreglo), luego la de la
+           trama (byte a byte solo si se solapa con lo que produce) */
+        size_t from = dict_len + out - dist;
+        size_t k = 0;
+        if (from < dict_len) {
+            k = dict_len - from < n ? dict_len - from : n;
+            if (from + k + LZ_SLACK <= DICT_SIZE) {
+                for (size_t i = 0; i < k; i += LZ_SLACK) {
+                    memcpy(&dst[out + i], &dict[from + i], LZ_SLACK);
+                }
+            } else {
+                memcpy(&dst[out], &dict[from], k);
+            }
+        }
+        if (k < n && dist >= LZ_SLACK) {
+            for (size_t i = k; i < n; i += LZ_SLACK) {
+                memcpy(&dst[out + i], &dst[from + i - dict_len], LZ_SLACK);
+            }
+        } else {
+            for (size_t i = k; i < n; i++) {
+                dst[out + i] = dst[from + i - dict_len];
+            }
+        }
+        out += n;
+    }
+    return (int)out;
+}
+
+/**
+ * Bloques lógicos de un archivo. En uno comprimido no coinciden con
+ * num_blocks, que cuenta los bloques físicos que guardan sus tramas.
+ * @param file Archivo
+ * @return Número de bloques lógicos
+ */
+static size_t file_logical_blocks(const FileEntry *file) {
+    return file->packed_len > 0 ? (file->size + BLOCK_SIZE - 1) / BLOCK_SIZE : file->num_blocks;
+}
+
+/**
+ * Copia un tramo de los datos comprimidos de un archivo, de su entrada o
+ * de los bloques que los guardan
+ * @param file Archivo comprimido
+ * @param pos Offset en los datos comprimidos
+ * @param len Bytes a copiar
+ * @param dst Destino
+ * @return 0 si es exitoso, -1 si un bloque está dañado
+ */
+static int packed_read(const FileEntry *file, size_t pos, size_t len, unsigned char *dst) {
+    if (file->num_blocks == 0) {
+        memcpy(dst, &file->extents[pos], len);
+        return 0;
+    }
+    const BlockNo *blocks = file_blocks(file);
+    for (size_t done = 0; done < len; ) {
+        BlockNo block = blocks[(pos + done) / BLOCK_SIZE];
+        size_t at = (pos + done) % BLOCK_SIZE;
+        size_t chunk = BLOCK_SIZE - at < len - done ? BLOCK_SIZE - at : len - done;
+        if (!ensure_block_intact(block)) {
+            console_error("Error: El bloque %u esta danado y no se puede reconstruir.\n", block);
+            return -1;
+        }
+        memcpy(&dst[done], &fs.blocks[block][at], chunk);
+        done += chunk;
+    }
+    return 0;
+}
+
+/**
+ * Descomprime un bloque lógico de un archivo comprimido. Solo se leen los
+ * bytes de su trama (y, en un archivo de más de DICT_FILE_BLOCKS bloques,
+ * su fin en la tabla que encabeza los datos).
+ * @param file Archivo comprimido
+ * @param b Bloque lógico
+ * @param out Destino de BLOCK_SIZE bytes (lo que sigue al fin del archivo queda a cero)
+ * @return 0 si es exitoso, -1 si un bloque está dañado o la trama no es válida
+ */
+static int file_frame(const FileEntry *file, size_t b, unsigned char *out) {
+    unsigned char gathered[LZ_FRAME_MAX + LZ_SLACK];
+    unsigned char decoded[BLOCK_SIZE + LZ_SLACK];
+    size_t logical = file_logical_blocks(file);
+    size_t room = file->num_blocks > 0 ? file->num_blocks * BLOCK_SIZE : EXTENT_BYTES;
+    size_t table = logical > DICT_FILE_BLOCKS ? logical * sizeof(uint32_t) : 0;
+    bool valid = file->packed_len <= room && table <= file->packed_len;
+    size_t start = 0, end = 0;
+    
+    if (valid && table == 0) {
+        start = b > 0 ? file->frame_end[b - 1] : 0;
+        end = file->frame_end[b];
+    } else if (valid) {
+        /* La trama 0 empieza tras la tabla; la b termina en su entrada */
+        uint32_t ends[2];
+        size_t first = b > 0 ? b - 1 : 0;
+        if (packed_read(file, first * sizeof(uint32_t), (b - first + 1) * sizeof(uint32_t),
+                        (unsigned char *)ends) != 0) {
+            return -1;
+        }
+        start = b > 0 ? ends[0] : table;
+        end = ends[b - first];
+    }
+    if (!valid || end < start || end > file->packed_len || end - start > LZ_FRAME_MAX) {
+        console_error("Error: La trama del bloque %zu de '%s' esta danada.\n", b, file->filename);
+        return -1;
+    }
+    if (packed_read(file, start, end - start, gathered) != 0) {
+        return -1;
+    }
+    memset(&gathered[end - start], 0, LZ_SLACK);  /* lz_decode lee de más en los literales */
+    
+    int n = lz_decode(gathered, end - start, decoded, BLOCK_SIZE);
+    if (n < 0) {
+        console_error("Error: La trama del bloque %zu de '%s' esta danada.\n", b, file->filename);
+        return -1;
+    }
+    memcpy(out, decoded, (size_t)n);
+    memset(&out[n], 0, BLOCK_SIZE - (size_t)n);
+    return 0;
+}
+
+/**
+ * Carga el contenido de los primeros bloques lógicos de un archivo,
+ * comprimido o no
+ * @param file Archivo
+ * @param content Destino, max_blocks * BLOCK_SIZE bytes
+ * @param max_blocks Bloques lógicos a cargar como mucho
+ * @return 0 si es exitoso, -1 si un bloque está dañado
+ */
+static int file_load(const FileEntry *file, unsigned char *content, size_t max_blocks) {
+    size_t logical = file_logical_blocks(file);
+    const BlockNo *blocks = file_blocks(file);
+    for (size_t b = 0; b < logical && b < max_blocks; b++) {
+        unsigned char *dst = &content[b * BLOCK_SIZE];
+        if (file->packed_len > 0) {
+            if (file_frame(file, b, dst) != 0) {
+                return -1;
+            }
+        } else if (blocks[b] == NO_BLOCK) {
+            memset(dst, 0, BLOCK_SIZE);
+        } else if (!ensure_block_intact(blocks[b])) {
+            console_error("Error: El bloque %u esta danado y no se puede reconstruir.\n", blocks[b]);
+            return -1;
+        } else {
+            memcpy(dst, fs.blocks[blocks[b]], BLOCK_SIZE);
+        }
+    }
+    return 0;
+}
+
+/**
+ * Comprime un archivo si así ocupa menos bloques, con el diccionario si
+ * lo hay. Cada bloque lógico es una trama independiente y las tramas van
+ * seguidas: en la propia entrada, en el espacio de la lista de extents,
+ * si caben (el archivo no ocupa bloques), o en los bloques que hagan
+ * falta. Sus fines van en frame_end o, si el archivo tiene más de
+ * DICT_FILE_BLOCKS bloques, en una tabla al principio de los datos. Si no
+ * se ahorra ningún bloque el archivo queda como estaba.
+ * @param file Archivo sin comprimir
+ * @return 0 si es exitoso (se haya comprimido o no), -1 si un bloque está dañado
+ */
+static int file_compress(FileEntry *file) {
+    size_t logical = (file->size + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    if (file->packed_len > 0 || file->size == 0 || file->num_blocks != logical) {
+        return 0;
+    }
+    
+    size_t table = logical > DICT_FILE_BLOCKS ? logical * sizeof(uint32_t) : 0;
+    unsigned char *content = pack_content;
+    unsigned char *packed = pack_frames;
+    if (file_load(file, content, logical) != 0) {
+        return -1;
+    }
+    dict_index_refresh();
+    uint16_t frame_end[DICT_FILE_BLOCKS];
+    size_t len = table;
+    for (size_t b = 0; b < logical; b++) {
+        size_t n = file->size - b * BLOCK_SIZE < BLOCK_SIZE ? file->size - b * BLOCK_SIZE : BLOCK_SIZE;
+        len += lz_encode(&content[b * BLOCK_SIZE], n, &packed[len]);
+        if (table > 0) {
+            uint32_t end = (uint32_t)len;
+            memcpy(&packed[b * sizeof(end)], &end, sizeof(end));
+        } else {
+            frame_end[b] = (uint16_t)len;
+        }
+    }
+    
+    /* Bloques que ocupa hoy (sin huecos), copiados porque file_set_blocks
+     * sustituye la lista, frente a los que ocuparía comprimido */
+    BlockNo old[MAX_FILE_BLOCKS];
+    size_t held = 0;
+    const BlockNo *blocks = file_blocks(file);
+    for (size_t b = 0; b < logical; b++) {
+        if (blocks[b] != NO_BLOCK) {
+            old[held++] = blocks[b];
+        }
+    }
+    size_t need = len <= EXTENT_BYTES ? 0 : (len + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    BlockNo new_blocks[MAX_FILE_BLOCKS];
+    size_t allocated = need > 0 && need < held ?
+                       allocate_blocks_near(need, new_blocks, placement_goal(file->filename)) : 0;
+    if (need >= held || allocated < need) {
+        free_blocks(allocated, new_blocks);
+        return 0;
+    }
+    for (size_t i = 0; i < need; i++) {
+        size_t chunk = len - i * BLOCK_SIZE < BLOCK_SIZE ? len - i * BLOCK_SIZE : BLOCK_SIZE;
+        store_bytes(new_blocks[i], 0, &packed[i * BLOCK_SIZE], chunk);
+    }
+    if (file_set_blocks(file, new_blocks, need) != 0) {
+        free_blocks(need, new_blocks);
+        return 0;
+    }
+    if (need == 0) {
+        memcpy(file->extents, packed, len);
+        file->extent_len = (uint32_t)len;
+    }
+    file->packed_len = (uint32_t)len;
+    if (table == 0) {
+        memcpy(file->frame_end, frame_end, logical * sizeof(frame_end[0]));
+    }
+    free_blocks(held, old);
+    return 0;
+}
+
+/**
+ * Comprime con el diccionario un archivo pequeño (ver file_compress)
+ * @param file Archivo sin comprimir
+ * @return 0 si es exitoso (se haya comprimido o no), -1 si un bloque está dañado
+ */
+static int file_pack(FileEntry *file) {
+    if (fs.dict_len == 0 || file->size > DICT_MAX_FILE) {
+        return 0;
+    }
+    return file_compress(file);
+}
+
+/**
+ * Descomprime un archivo comprimido en bloques normales, antes de una
+ * operación que trabaja con sus bloques lógicos (WRITE, FALLOCATE, PUNCH)
+ * @param file Archivo (si no está comprimido no se hace nada)
+ * @return 0 si es exitoso, -1 si no hay espacio o un bloque está dañado
+ */
+static int file_unpack(FileEntry *file) {
+    if (file->packed_len == 0) {
+        return 0;
+    }
+    
+    size_t logical = file_logical_blocks(file);
+    unsigned char *content = pack_content;
+    if (file_load(file, content, logical) != 0) {
+        return -1;
+    }
+    BlockNo new_blocks[MAX_FILE_BLOCKS];
+    size_t allocated = allocate_blocks_near(logical, new_blocks, placement_goal(file->filename));
+    if (allocated < logical) {
+        free_blocks(allocated, new_blocks);
+        console_error("Error: No hay espacio para descomprimir '%s'.\n", file->filename);
+        return -1;
+    }
+    for (size_t b = 0; b < logical; b++) {
+        store_bytes(new_blocks[b], 0, &content[b * BLOCK_SIZE], BLOCK_SIZE);
+    }
+    
+    BlockNo old[MAX_FILE_BLOCKS];
+    size_t held = file->num_blocks;
+    memcpy(old, file_blocks(file), held * sizeof(BlockNo));
+    if (file_set_blocks(file, new_blocks, logical) != 0) {
+        free_blocks(logical, new_blocks);
+        return -1;
+    }
+    file->packed_len = 0;
+    file->cold = false;
+    free_blocks(held, old);
+    return 0;
+}
+
+/**
+ * Anota un uso de un archivo para el envejecimiento del nivel frío
+ * @param file Archivo
+ */
+static void cold_touch(const FileEntry *file) {
+    cold.last_access[file - fs.file_table] = now_ns();
+}
+
+/**
+ * Crea un nuevo archivo en el sistema
+ * @param filename Nombre del archivo
+ * @param size Tamaño del archivo en bytes
+ * @return 0 si es exitoso, -1 en caso de error
+ */
+int create_file(const char *filename, size_t size) {
+    /* Validaciones */
+    if (filename == NULL || strlen(filename) == 0) {
+        out_printf("Error: Nombre de archivo inválido.\n");
+        return -1;
+    }
+    
+    if (size == 0) {
+        out_printf("Error: El tamano del archivo debe ser mayor que cero.\n");
+        return -1;
+    }
+    
+    if (size > MAX_FILE_SIZE) {
+        out_printf("Error: El tamano del archivo excede el límite maximo (%d bytes).\n", MAX_FILE_SIZE);
+        return -1;
+    }
+    
+    /* Verificar si el archivo ya existe */
+    if (find_file(filename) != NULL) {
+        out_printf("Error: El archivo '%s' ya existe.\n", filename);
+        return -1;
+    }
+    
+    /* Verificar si hay espacio para más archivos */
+    if (fs.num_files >= MAX_FILES) {
+        out_printf("Error: Se ha alcanzado el numero maximo de archivos (%d).\n", MAX_FILES);
+        return -1;
+    }
+    
+    /* Calcular número de bloques necesarios */
+    size_t num_blocks = (size + BLOCK_SIZE - 1) / BLOCK_SIZE;  /* Redondeo hacia arriba */
+    
+    /* Verificar espacio disponible */
+    if (fs.used_blocks + num_blocks > fs.capacity_blocks) {
+        out_printf("Error: No hay suficiente espacio en el sistema de archivos.\n");
+        out_printf("  Bloques disponibles: %zu\n", fs.capacity_blocks - fs.used_blocks);
+        out_printf("  Bloques requeridos: %zu\n", num_blocks);
+        return -1;
+    }
+    
+    /* Buscar una entrada libre en la tabla de archivos */
+    size_t file_index = MAX_FILES;
+    for (size_t i = 0; i < MAX_FILES; i++) {
+        if (!file_live(&fs.file_table[i])) {
+            file_index = i;
+            break;
+        }
+    }
+    
+    if (file_index == MAX_FILES) {
+        out_printf("Error: No hay espacio en la tabla de archivos.\n");
+        return -1;
+    }
+    
+    /* Asignar bloques */
+    BlockNo blocks[MAX_FILE_BLOCKS];
+    size_t allocated = allocate_blocks_near(num_blocks, blocks, placement_goal(filename));
+    if (allocated < num_blocks) {
+        out_printf("Error: No se pudieron asignar todos los bloques necesarios.\n");
+        /* Liberar bloques ya asignados */
+        if (allocated > 0) {
+            free_blocks(allocated, blocks);
+        }
+        return -1;
+    }
+    
+    /* Crear entrada del archivo */
+    FileEntry *file = &fs.file_table[file_index];
+    strncpy(file->filename, filename, MAX_FILENAME - 1);
+    file->filename[MAX_FILENAME - 1] = '\0';
+    file->packed_len = 0;
+    file->cold = false;
+    if (file_set_blocks(file, blocks, num_blocks) != 0) {
+        free_blocks(allocated, blocks);
+        return -1;
+    }
+    file->size = size;
+    file->format_gen = fs.format_gen;
+    file->in_use = true;
+    name_index_insert(file_index);
+    cold_touch(file);
+    
+    fs.num_files++;
+    fs.total_storage += size;
+    watch_notify(WATCH_CREATE, file);
+    
+    out_printf("Archivo '%s' creado exitosamente (%zu bytes, %zu bloques).\n", 
+               filename, size, num_blocks);
+    return 0;
+}
+
+/**
+ * Escribe datos en un archivo
+ * @param filename Nombre del archivo
+ * @param offset Offset donde comenzar a escribir
+ * @param data Datos a escribir
+ * @return 0 si es exitoso, -1 en caso de error
+ */
+int write_file(const char *filename, size_t offset, const char *data) {
+    if (filename == NULL || data == NULL) {
+        out_printf("Error: Parámetros inválidos.\n");
+        return -1;
+    }
+    
+    /* Buscar el archivo */
+    FileEntry *file = find_file(filename);
+    if (file == NULL) {
+        out_printf("Error: El archivo '%s' no existe.\n", filename);
+        return -1;
+    }
+    cold_touch(file);
+    
+    /* Validar offset */
+    if (offset > file->size) {
+        out_printf("Error: Offset (%zu) excede el tamano del archivo (%zu bytes).\n", 
+                   offset, file->size);
+        return -1;
+    }
+    
+    size_t data_len = strlen(data);
+    
+    /* Validar que no se exceda el tamaño del archivo */
+    if (offset + data_len > file->size) {
+        out_printf("Error: La escritura excede el tamano del archivo.\n");
+        out_printf("  Tamano del archivo: %zu bytes\n", file->size);
+        out_printf("  Intento de escritura: offset %zu + %zu bytes\n", offset, data_len);
+        return -1;
+    }
+    
+    /* Un archivo comprimido se escribe descomprimido y se vuelve a comprimir al final */
+    if (file_unpack(file) != 0) {
+        return -1;
+    }
+    
+    /* Calcular en qué bloque y posición dentro del bloque comenzar */
+    size_t start_block = offset / BLOCK_SIZE;
+    size_t start_pos = offset % BLOCK_SIZE;
+    
+    /* Los huecos del rango reciben bloques antes de escribir */
+    if (data_len > 0 &&
+        fill_holes(file, start_block, (offset + data_len - 1) / BLOCK_SIZE) != 0) {
+        out_printf("Error: No hay suficiente espacio para rellenar los huecos del rango.\n");
+        return -1;
+    }
+    
+    const BlockNo *blocks = file_blocks(file);
+    size_t bytes_written = 0;
+    size_t current_block = start_block;
+    size_t current_pos = start_pos;
+    
+    /* Escribir los datos bloque por bloque */
+    while (bytes_written < data_len && current_block < file->num_blocks) {
+        size_t block_index = blocks[current_block];
+        size_t bytes_to_write = data_len - bytes_written;
+        
+        /* Limitar la escritura al espacio disponible en el bloque actual */
+        if (current_pos + bytes_to_write > BLOCK_SIZE) {
+            bytes_to_write = BLOCK_SIZE - current_pos;
+        }
+        
+        /* Escribir en el bloque */
+        if (!ensure_block_intact(block_index)) {
+            out_printf("Error: El bloque %zu esta danado y no se puede reconstruir.\n", block_index);
+            return -1;
+        }
+        store_bytes(block_index, current_pos, &data[bytes_written], bytes_to_write);
+        
+        bytes_written += bytes_to_write;
+        current_block++;
+        current_pos = 0;
+    }
+    
+    /* Si no se puede comprimir, el archivo queda sin comprimir */
+    file_pack(file);
+    watch_notify(WATCH_WRITE, file);
+    
+    out_printf("Escritos %zu bytes en '%s' (offset %zu).\n", 
+               bytes_written, filename, offset);
+    return 0;
+}
+
+/**
+ * Lee datos de un archivo
+ * @param filename Nombre del archivo
+ * @param offset Offset donde comenzar a leer
+ * @param size Cantidad de bytes a leer
+ * @param buffer Buffer donde almacenar los datos leídos
+ * @return 0 si es exitoso, -1 en caso de error
+ */
+int read_file(const char *filename, size_t offset, size_t size, char *buffer) {
+    if (filename == NULL || buffer == NULL || size == 0) {
+        out_printf("Error: Parámetros inválidos.\n");
+        return -1;
+    }
+    
+    /* Buscar el archivo */
+    FileEntry *file = find_file(filename);
+    if (file == NULL) {
+        out_printf("Error: El archivo '%s' no existe.\n", filename);
+        return -1;
+    }
+    
+    /* Validar offset */
+    if (offset >= file->size) {
+        out_printf("Error: Offset (%zu) excede el tamano del archivo (%zu bytes).\n", 
+                   offset, file->size);
+        return -1;
+    }
+    
+    /* Ajustar el tamaño a leer si se excede el tamaño del archivo */
+    size_t bytes_to_read = size;
+    if (offset + bytes_to_read > file->size) {
+        bytes_to_read = file->size - offset;
+        out_printf("Advertencia: Se leerán %zu bytes en lugar de %zu (fin del archivo).\n", 
+                   bytes_to_read, size);
+    }
+    
+    /* Un archivo del nivel frío se lee de sus tramas; el hilo lo promociona */
+    cold_touch(file);
+    
+    /* Calcular en qué bloque y posición dentro del bloque comenzar */
+    size_t start_block = offset / BLOCK_SIZE;
+    size_t start_pos = offset % BLOCK_SIZE;
+    
+    const BlockNo *blocks = file_blocks(file);
+    size_t logical_blocks = file_logical_blocks(file);
+    size_t bytes_read = 0;
+    size_t current_block = start_block;
+    size_t current_pos = start_pos;
+    unsigned char frame[BLOCK_SIZE];
+    
+    /* Leer los datos bloque por bloque */
+    while (bytes_read < bytes_to_read && current_block < logical_blocks) {
+        size_t block_index = file->packed_len > 0 ? NO_BLOCK : blocks[current_block];
+        size_t bytes_to_read_now = bytes_to_read - bytes_read;
+        
+        /* Limitar la lectura al espacio disponible en el bloque actual */
+        if (current_pos + bytes_to_read_now > BLOCK_SIZE) {
+            bytes_to_read_now = BLOCK_SIZE - current_pos;
+        }
+        
+        /* Leer del bloque; un hueco se lee como ceros y uno comprimido se descomprime */
+        if (file->packed_len > 0) {
+            if (file_frame(file, current_block, frame) != 0) {
+                return -1;
+            }
+            memcpy(&buffer[bytes_read], &frame[current_pos], bytes_to_read_now);
+        } else if (block_index == NO_BLOCK) {
+            memset(&buffer[bytes_read], 0, bytes_to_read_now);
+        } else if (!ensure_block_intact(block_index)) {
+            out_printf("Error: El bloque %zu esta danado y no se puede reconstruir.\n", block_index);
+            return -1;
+        } else {
+            memcpy(&buffer[bytes_read], 
+                   &fs.blocks[block_index][current_pos], 
+                   bytes_to_read_now);
+        }
+        
+        bytes_read += bytes_to_read_now;
+        current_block++;
+        current_pos = 0;
+    }
+    
+    buffer[bytes_read] = '\0';  /* Agregar terminador de cadena */
+    
+    out_printf("Leídos %zu bytes de '%s' (offset %zu).\n", 
+               bytes_read, filename, offset);
+    return 0;
+}
+
+/**
+ * Elimina un archivo del sistema
+ * @param filename Nombre del archivo a eliminar
+ * @return 0 si es exitoso, -1 en caso de error
+ */
+int delete_file(const char *filename) {
+    if (filename == NULL) {
+        out_printf("Error: Nombre de archivo inválido.\n");
+        return -1;
+    }
+    
+    /* Buscar el archivo */
+    FileEntry *file = find_file(filename);
+    if (file == NULL) {
+        out_printf("Error: El archivo '%s' no existe.\n", filename);
+        return -1;
+    }
+    
+    /* Liberar bloques */
+    free_blocks(file->num_blocks, file_blocks(file));
+    
+    /* Actualizar estadísticas */
+    fs.total_storage -= file->size;
+    fs.num_files--;
+    
+    /* Limpiar entrada */
+    watch_notify(WATCH_DELETE, file);
+    name_index_remove((size_t)(file - fs.file_table));
+    file->in_use = false;
+    file->filename[0] = '\0';
+    file->size = 0;
+    file_set_blocks(file, NULL, 0);
+    
+    out_printf("Archivo '%s' eliminado exitosamente.\n", filename);
+    return 0;
+}
+
+/**
+ * Elimina todos los archivos cuyo nombre coincide con un patrón glob. Los
+ * archivos se enumeran recorriendo el índice de nombres, sus bloques se
+ * reúnen en un mapa y se liberan en una sola pasada ordenada, por tramos
+ * consecutivos (free_blocks), y los contadores se actualizan una vez.
+ * @param pattern Patrón (fnmatch: *, ?, [...])
+ * @return 0 si es exitoso, -1 en caso de error
+ */
+int delete_matching(const char *pattern) {
+    /* Estáticos (se usan con fs_lock) para no cargar la pila del hilo que ejecuta */
+    static bool doomed[MAX_BLOCKS];
+    static BlockNo sorted[MAX_BLOCKS];
+    if (pattern == NULL || pattern[0] == '\0') {
+        out_printf("Error: Patron invalido.\n");
+        return -1;
+    }
+    
+    size_t victims[MAX_FILES];
+    size_t num_victims = 0, bytes = 0;
+    
+    /* Enumerar primero: quitar entradas del índice desplaza sus huecos */
+    for (size_t slot = 0; slot < NAME_INDEX_SLOTS; slot++) {
+        if (!name_slot_live(slot)) {
+            continue;
+        }
+        size_t index = fs.name_index[slot].file - 1;
+        const FileEntry *file = &fs.file_table[index];
+        if (!file_live(file) || fnmatch(pattern, file->filename, 0) != 0) {
+            continue;
+        }
+        const BlockNo *blocks = file_blocks(file);  /* Solo vale en esta vuelta */
+        for (size_t i = 0; i < file->num_blocks; i++) {
+            if (blocks[i] != NO_BLOCK) {
+                doomed[blocks[i]] = true;
+            }
+        }
+        victims[num_victims++] = index;
+        bytes += file->size;
+    }
+    
+    if (num_victims == 0) {
+        out_printf("No hay archivos que coincidan con '%s'.\n", pattern);
+        return 0;
+    }
+    
+    /* Recorrer el mapa produce la lista ya ordenada por bloque físico y lo
+     * deja limpio para la siguiente llamada */
+    size_t num_blocks = 0;
+    for (size_t b = 0; b < MAX_BLOCKS; b++) {
+        if (doomed[b]) {
+            sorted[num_blocks++] = (BlockNo)b;
+            doomed[b] = false;
+        }
+    }
+    free_blocks(num_blocks, sorted);
+    
+    for (size_t v = 0; v < num_victims; v++) {
+        FileEntry *file = &fs.file_table[victims[v]];
+        watch_notify(WATCH_DELETE, file);
+        name_index_remove(victims[v]);
+        file->in_use = false;
+        file->filename[0] = '\0';
+        file->size = 0;
+        file_set_blocks(file, NULL, 0);
+    }
+    fs.num_files -= num_victims;
+    fs.total_storage -= bytes;
+    
+    out_printf("Eliminados %zu archivo(s) que coinciden con '%s' (%zu bloques, %zu bytes).\n",
+               num_victims, pattern, num_blocks, bytes);
+    return 0;
+}
+
+/**
+ * Reserva bloques físicos para un rango de un archivo sin alterar su
+ * contenido visible. Si el rango supera el final del archivo, el tamaño
+ * crece y la parte nueva se lee como ceros.
+ * @param filename Nombre del archivo
+ * @param offset Inicio del rango
+ * @param length Longitud del rango en bytes
+ * @return 0 si es exitoso, -1 en caso de error
+ */
+int fallocate_file(const char *filename, size_t offset, size_t length) {
+    if (filename == NULL || length == 0) {
+        out_printf("Error: Parámetros inválidos.\n");
+        return -1;
+    }
+    
+    FileEntry *file = find_file(filename);
+    if (file == NULL) {
+        out_printf("Error: El archivo '%s' no existe.\n", filename);
+        return -1;
+    }
+    cold_touch(file);
+    
+    if (offset > MAX_FILE_SIZE || length > MAX_FILE_SIZE - offset) {
+        out_printf("Error: El rango excede el tamano maximo de archivo (%d bytes).\n", MAX_FILE_SIZE);
+        return -1;
+    }
+    
+    size_t first = offset / BLOCK_SIZE;
+    size_t last = (offset + length - 1) / BLOCK_SIZE;
+    
+    if (file_unpack(file) != 0) {
+        return -1;
+    }
+    if (fill_holes(file, first, last) != 0) {
+        out_printf("Error: No hay suficiente espacio en el sistema de archivos.\n");
+        out_printf("  Bloques disponibles: %zu\n", fs.capacity_blocks - fs.used_blocks);
+        return -1;
+    }
+    
+    if (offset + length > file->size) {
+        fs.total_storage += offset + length - file->size;
+        file->size = offset + length;
+    }
+    journal_file(file);
+    watch_notify(WATCH_WRITE, file);
+    
+    out_printf("Reservados bloques %zu-%zu de '%s' (%zu extents, tamano %zu bytes).\n",
+               first, last, filename, count_extents(file->num_blocks, file_blocks(file)), file->size);
+    return 0;
+}
+
+/**
+ * Libera los bloques de un rango de un archivo sin cambiar su tamaño.
+ * Los bloques cubiertos por completo vuelven al mapa de bloques libres;
+ * en los bloques de los bordes solo se ponen a cero los bytes del rango.
+ * @param filename Nombre del archivo
+ * @param offset Inicio del rango
+ * @param length Longitud del rango en bytes
+ * @return 0 si es exitoso, -1 en caso de error
+ */
+int punch_hole(const char *filename, size_t offset, size_t length) {
+    if (filename == NULL || length == 0) {
+        out_printf("Error: Parámetros inválidos.\n");
+        return -1;
+    }
+    
+    FileEntry *file = find_file(filename);
+    if (file == NULL) {
+        out_printf("Error: El archivo '%s' no existe.\n", filename);
+        return -1;
+    }
+    cold_touch(file);
+    
+    if (offset >= file->size) {
+        out_printf("Error: Offset (%zu) excede el tamano del archivo (%zu bytes).\n", 
+                   offset, file->size);
+        return -1;
+    }
+    
+    if (file_unpack(file) != 0) {
+        return -1;
+    }
+
+    size_t end = length > file->size - offset ? file->size : offset + length;
+    size_t freed = 0;
+    BlockNo blocks[MAX_FILE_BLOCKS];
+    BlockNo released[MAX_FILE_BLOCKS];
+    memcpy(blocks, file_blocks(file), file->num_blocks * sizeof(BlockNo));
+    
+    for (size_t pos = offset; pos < end; ) {
+        size_t slot = pos / BLOCK_SIZE;
+        size_t in_block = pos % BLOCK_SIZE;
+        size_t chunk = BLOCK_SIZE - in_block;
+        if (chunk > end - pos) {
+            chunk = end - pos;
+        }
+        
+        if (blocks[slot] != NO_BLOCK) {
+            if (chunk == BLOCK_SIZE) {
+                released[freed++] = blocks[slot];
+                blocks[slot] = NO_BLOCK;
+            } else {
+                store_bytes(blocks[slot], in_block, NULL, chunk);
+            }
+        }
+        pos += chunk;
+    }
+    
+    /* Los bloques se liberan solo si la nueva lista de extents cabe */
+    if (freed > 0) {
+        if (file_set_blocks(file, blocks, file->num_blocks) != 0) {
+            return -1;
+        }
+        free_blocks(freed, released);
+    }
+    watch_notify(WATCH_WRITE, file);
+    
+    out_printf("Liberados %zu bloques de '%s' (offset %zu, %zu bytes).\n",
+               freed, filename, offset, end - offset);
+    return 0;
+}
+
+#ifdef FS_TEST_HOOKS
+/**
+ * Daña el contenido de un bloque sin pasar por la paridad, para probar la
+ * detección y reconstrucción. Es un gancho de pruebas: solo existe al
+ * compilar con -DFS_TEST_HOOKS (make test). Como un fallo de memoria
+ * local, no pasa por el journal: el espejo y las réplicas conservan el
+ * bloque bueno.
+ * @param block Bloque físico a dañar
+ * @return 0 si es exitoso, -1 en caso de error
+ */
+int corrupt_block(size_t block) {
+    if (block >= fs.capacity_blocks) {
+        out_printf("Error: Bloque %zu fuera de rango (0-%zu).\n", block, fs.capacity_blocks - 1);
+        return -1;
+    }
+    export_unlend(block, 1);
+    for (size_t i = 0; i < BLOCK_SIZE; i += 7) {
+        fs.blocks[block][i] ^= 0x5A;
+    }
+    out_printf("Bloque %zu danado.\n", block);
+    return 0;
+}
+#endif
+
+/**
+ * Amplía la capacidad del volumen en caliente. Los bloques nuevos ya
+ * están dentro del rango virtual reservado del almacén, así que no se
+ * mueve ningún dato ni cambia ningún índice: basta con liberarlos en el
+ * mapa y entregarlos al asignador.
+ * @param kb Kilobytes a añadir
+ * @return 0 si es exitoso, -1 en caso de error
+ */
+int grow_volume(size_t kb) {
+    /* Comparar en KB antes de multiplicar: kb * 1024 podría desbordarse */
+    size_t free_kb = (MAX_BLOCKS - fs.capacity_blocks) * BLOCK_SIZE / 1024;
+    if (kb > free_kb) {
+        out_printf("Error: La ampliacion excede el rango reservado (%zu KB libres de %d KB).\n",
+                   free_kb, MAX_STORAGE / 1024);
+        return -1;
+    }
+    size_t add = kb * 1024 / BLOCK_SIZE;
+    if (add == 0) {
+        out_printf("Error: Ampliacion invalida.\n");
+        return -1;
+    }
+    
+    long long start_ns = now_ns();
+    size_t old_capacity = fs.capacity_blocks;
+    fs.capacity_blocks += add;
+    for (size_t i = old_capacity; i < fs.capacity_blocks; i++) {
+        fs.block_map[i] = BLOCK_FREE;
+    }
+    journal_map(old_capacity);
+    journal_map(fs.capacity_blocks - 1);
+    if (alloc_policies[fs.policy].release != NULL) {
+        alloc_policies[fs.policy].release(old_capacity, add);
+    }
+    thin_check_watermarks();
+    
+    out_printf("Volumen ampliado de %zu KB a %zu KB en %.3f ms.\n",
+               old_capacity * BLOCK_SIZE / 1024, fs.capacity_blocks * BLOCK_SIZE / 1024,
+               (double)(now_ns() - start_ns) / 1e6);
+    return 0;
+}
+
+/**
+ * Vacía el volumen en tiempo constante. En vez de recorrer bloques y
+ * entradas se avanza la generación del volumen: todo lo que llevaba la
+ * anterior deja de ser válido a la vez y se recupera cuando se vuelve a
+ * usar (los bloques se limpian al asignarse, ver claim_block). Las
+ * páginas de la generación anterior se devuelven al sistema con una sola
+ * llamada sobre todo el almacén. Se conservan la capacidad y la política.
+ * @return 0 si es exitoso
+ */
+int format_volume(void) {
+    long long start_ns = now_ns();
+    
+    if (fs.format_gen + 1 == BLOCK_RESERVED) {
+        /* Generaciones agotadas: limpieza completa, que vuelve a la 1 */
+        initial_blocks = fs.capacity_blocks;
+        reset_filesystem(fs.policy);
+        for (size_t i = 0; i < MAX_BLOCKS; i++) {
+            journal_block(i);
+            journal_map(i);
+        }
+        for (size_t i = 0; i < NAME_INDEX_SLOTS; i++) {
+            journal_name(i);
+        }
+        for (size_t i = 0; i < MAX_FILES; i++) {
+            journal_file(&fs.file_table[i]);
+        }
+    } else {
+        fs.format_gen++;
+        fs.num_files = 0;
+        fs.used_blocks = 0;
+        fs.total_storage = 0;
+        if (alloc_policies[fs.policy].format != NULL) {
+            alloc_policies[fs.policy].format();
+        } else if (alloc_policies[fs.policy].reset != NULL) {
+            alloc_policies[fs.policy].reset();
+        }
+        journal_counters();
+        
+        /* Sin esto, los datos antiguos seguirían residentes hasta reutilizarse */
+        if (reclaim_all() == 0) {
+            parity_reset();
+        }
+    }
+    thin_check_watermarks();
+    watch_notify(WATCH_FORMAT, NULL);
+    
+    out_printf("Volumen formateado (generacion %u, %zu KB) en %.3f ms.\n",
+               fs.format_gen, fs.capacity_blocks * BLOCK_SIZE / 1024,
+               (double)(now_ns() - start_ns) / 1e6);
+    return 0;
+}
+
+/**
+ * Hash de la subcadena de DICT_KMER bytes que empieza en una posición
+ * @param p Bytes
+ * @return Índice en los contadores de entrenamiento
+ */
+static uint32_t dict_kmer_hash(const unsigned char *p) {
+    uint32_t v = (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+    uint32_t w = (uint32_t)p[4] | (uint32_t)p[5] << 8;
+    return (v * 2654435761u ^ w * 2246822519u) >> (32 - DICT_TRAIN_BITS);
+}
+
+/**
+ * Puntuación de una subcadena: cuenta solo si aparece en varias muestras
+ * @param freq Muestras en que aparece
+ * @return Puntuación
+ */
+static uint64_t dict_kmer_score(uint32_t freq) {
+    return freq >= 2 ? freq : 0;
+}
+
+/**
+ * Elige el contenido del diccionario. Como en el algoritmo COVER, se
+ * forma con los tramos de DICT_SEGMENT bytes cuyas subcadenas de
+ * DICT_KMER bytes aparecen en más muestras distintas; tras elegir un
+ * tramo sus subcadenas dejan de puntuar, para no repetir contenido. Los
+ * mejores tramos quedan al final, más cerca de los datos.
+ * @param sample Muestras seguidas
+ * @param ends Fin de cada muestra en sample
+ * @param num_samples Número de muestras
+ * @param dict Destino, DICT_SIZE bytes
+ * @return Bytes del diccionario, 0 si no hay contenido común o memoria
+ */
+static size_t dict_train(const unsigned char *sample, const size_t *ends, size_t num_samples,
+                         unsigned char *dict) {
+    uint32_t *freq = calloc((size_t)1 << DICT_TRAIN_BITS, sizeof(uint32_t));
+    uint16_t *seen = calloc((size_t)1 << DICT_TRAIN_BITS, sizeof(uint16_t));
+    uint32_t *kmer = malloc(ends[num_samples - 1] * sizeof(uint32_t));
+    bool ready = freq != NULL && seen != NULL && kmer != NULL;
+    size_t picks[DICT_SIZE / DICT_SEGMENT];
+    size_t num_picks = 0;
+    
+    /* En cuántas muestras aparece cada subcadena (su hash se guarda para puntuar) */
+    for (size_t s = 0, from = 0; ready && s < num_samples; from = ends[s++]) {
+        for (size_t pos = from; pos + DICT_KMER <= ends[s]; pos++) {
+            uint32_t h = dict_kmer_hash(&sample[pos]);
+            kmer[pos] = h;
+            if (seen[h] != s + 1) {
+                seen[h] = (uint16_t)(s + 1);
+                freq[h]++;
+            }
+        }
+    }
+    
+    /* Elegir tramos mientras alguno tenga subcadenas comunes a varias muestras */
+    while (ready && num_picks < DICT_SIZE / DICT_SEGMENT) {
+        size_t best = 0;
+        uint64_t best_score = 0;
+        for (size_t s = 0, from = 0; s < num_samples; from = ends[s++]) {
+            if (ends[s] - from < DICT_SEGMENT) {
+                continue;
+            }
+            /* Ventana deslizante: al avanzar un byte sale una subcadena y entra otra */
+            uint64_t score = 0;
+            for (size_t k = from; k + DICT_KMER <= from + DICT_SEGMENT; k++) {
+                score += dict_kmer_score(freq[kmer[k]]);
+            }
+            for (size_t pos = from; ; pos++) {
+                if (score > best_score) {
+                    best_score = score;
+                    best = pos;
+                }
+                if (pos + DICT_SEGMENT >= ends[s]) {
+                    break;
+                }
+                score -= dict_kmer_score(freq[kmer[pos]]);
+                score += dict_kmer_score(freq[kmer[pos + DICT_SEGMENT - DICT_KMER + 1]]);
+            }
+        }
+        if (best_score == 0) {
+            break;
+        }
+        for (size_t k = best; k + DICT_KMER <= best + DICT_SEGMENT; k++) {
+            freq[kmer[k]] = 0;
+        }
+        picks[num_picks++] = best;
+    }
+    free(freq);
+    free(seen);
+    free(kmer);
+    
+    size_t len = num_picks * DICT_SEGMENT;
+    for (size_t i = 0; i < num_picks; i++) {
+        memcpy(&dict[len - (i + 1) * DICT_SEGMENT], &sample[picks[i]], DICT_SEGMENT);
+    }
+    return len;
+}
+
+/**
+ * Comando TRAINDICT: entrena el diccionario compartido con el principio
+ * (hasta DICT_MAX_FILE bytes) de los archivos que coinciden con un patrón
+ * y vuelve a comprimir con él todos los archivos pequeños
+ * @param pattern Patrón (fnmatch) de los archivos de muestra
+ * @return 0 si es exitoso, -1 en caso de error
+ */
+int train_dictionary(const char *pattern) {
+    long long start_ns = now_ns();
+    unsigned char *sample = malloc(DICT_SAMPLE_MAX);
+    unsigned char dict[DICT_SIZE];
+    size_t ends[MAX_FILES];
+    size_t num_samples = 0, sample_len = 0;
+    
+    /* Muestra: el principio de cada archivo que coincide y se puede leer */
+    for (size_t i = 0; i < MAX_FILES && sample != NULL; i++) {
+        const FileEntry *file = &fs.file_table[i];
+        unsigned char content[DICT_MAX_FILE];
+        if (!file_live(file) || file->size == 0 || fnmatch(pattern, file->filename, 0) != 0) {
+            continue;
+        }
+        size_t len = file->size < DICT_MAX_FILE ? file->size : DICT_MAX_FILE;
+        if (sample_len + len > DICT_SAMPLE_MAX) {
+            break;
+        }
+        if (file_load(file, content, (len + BLOCK_SIZE - 1) / BLOCK_SIZE) != 0) {
+            continue;  /* Dañado: file_load ya avisó y no aporta muestra */
+        }
+        memcpy(&sample[sample_len], content, len);
+        sample_len += len;
+        ends[num_samples++] = sample_len;
+    }
+    if (sample == NULL) {
+        out_printf("Error: No hay memoria para entrenar el diccionario.\n");
+        return -1;
+    }
+    if (num_samples < 2) {
+        out_printf("Error: Se necesitan al menos 2 archivos de muestra (hay %zu).\n", num_samples);
+        free(sample);
+        return -1;
+    }
+    size_t dict_len = dict_train(sample, ends, num_samples, dict);
+    free(sample);
+    if (dict_len == 0) {
+        out_printf("Error: Las muestras no tienen contenido comun; el diccionario no cambia.\n");
+        return -1;
+    }
+    
+    /* Los archivos comprimidos con el diccionario anterior se descomprimen antes */
+    for (size_t i = 0; i < MAX_FILES; i++) {
+        if (file_live(&fs.file_table[i]) && file_unpack(&fs.file_table[i]) != 0) {
+            return -1;
+        }
+    }
+    memcpy(fs.dict, dict, dict_len);
+    fs.dict_len = (uint32_t)dict_len;
+    fs.dict_gen++;
+    journal_dict();
+    
+    size_t packed = 0, before = 0, after = 0;
+    for (size_t i = 0; i < MAX_FILES; i++) {
+        FileEntry *file = &fs.file_table[i];
+        if (!file_live(file) || file->size > DICT_MAX_FILE) {
+            continue;
+        }
+        before += file->num_blocks;
+        file_pack(file);
+        after += file->num_blocks;
+        packed += file->packed_len > 0;
+    }
+    
+    out_printf("Diccionario entrenado: %zu bytes con %zu archivo(s) de muestra (%zu KB) en %.3f ms.\n",
+               dict_len, num_samples, sample_len / 1024, (double)(now_ns() - start_ns) / 1e6);
+    out_printf("  %zu archivo(s) pequenos comprimidos: %zu bloques en lugar de %zu.\n", packed, after, before);
+    return 0;
+}
+
+/**
+ * Indica si un archivo lleva sin usarse lo bastante para pasar al nivel
+ * frío. Uno que no se pudo comprimir no se reintenta hasta que se use.
+ * El llamador tiene fs_lock.
+ * @param i Índice en file_table
+ * @param now Instante de la pasada
+ * @return true si hay que intentar comprimirlo
+ */
+static bool cold_candidate(size_t i, long long now) {
+    const FileEntry *file = &fs.file_table[i];
+    return file_live(file) && file->packed_len == 0 && file->size > 0 &&
+           now - cold.last_access[i] >= cold.age_ns && cold.tried[i] != cold.last_access[i];
+}
+
+/**
+ * Indica si un archivo frío se ha vuelto a leer desde que se comprimió y
+ * debe volver a bloques normales. Si no cabe se lee de sus tramas y no
+ * se reintenta hasta el siguiente uso. El llamador tiene fs_lock.
+ * @param i Índice en file_table
+ * @return true si hay que descomprimirlo
+ */
+static bool cold_reheated(size_t i) {
+    const FileEntry *file = &fs.file_table[i];
+    size_t limit = fs.capacity_blocks < thin.physical_blocks ? fs.capacity_blocks : thin.physical_blocks;
+    return file_live(file) && file->cold && cold.last_access[i] > cold.cooled[i] &&
+           fs.used_blocks + file_logical_blocks(file) <= limit;
+}
+
+/**
+ * Devuelve a bloques normales un archivo frío si se ha vuelto a leer.
+ * El llamador tiene fs_lock.
+ * @param i Índice en file_table
+ */
+static void cold_promote(size_t i) {
+    if (!cold_reheated(i)) {
+        return;
+    }
+    if (file_unpack(&fs.file_table[i]) == 0) {
+        cold.promoted++;
+    } else {
+        cold.cooled[i] = cold.last_access[i];
+    }
+    journal_commit();
+}
+
+/**
+ * Comprime el archivo más antiguo de los que llevan age_ns sin usarse o,
+ * si no queda ninguno, cierra la pasada devolviendo al sistema las
+ * páginas libres. El llamador tiene fs_lock.
+ * @param packed Se incrementa si el archivo se comprimió
+ * @return true si queda algún archivo por mirar, false al cerrar la pasada
+ */
+static bool cold_compress_oldest(size_t *packed) {
+    long long now = now_ns();
+    size_t pick = MAX_FILES;
+    for (size_t i = 0; i < MAX_FILES; i++) {
+        if (cold_candidate(i, now) && (pick == MAX_FILES || cold.last_access[i] < cold.last_access[pick])) {
+            pick = i;
+        }
+    }
+    if (pick < MAX_FILES) {
+        FileEntry *file = &fs.file_table[pick];
+        size_t before = file->num_blocks;
+        file_compress(file);
+        if (file->packed_len > 0) {
+            file->cold = true;
+            cold.cooled[pick] = now_ns();
+            cold.packed++;
+            cold.blocks_saved += before - file->num_blocks;
+            (*packed)++;
+        } else {
+            cold.tried[pick] = cold.last_access[pick];
+        }
+    } else {
+        reclaim_flush();
+        cold.passes++;
+    }
+    /* Como cualquier comando, el cambio va al espejo y a las réplicas */
+    journal_commit();
+    return pick < MAX_FILES;
+}
+
+/**
+ * Pasada de envejecimiento del nivel frío: primero devuelve a bloques
+ * normales los archivos fríos que se han vuelto a leer (READ solo los
+ * decodifica, para no cambiar el volumen en un comando de lectura);
+ * después comprime los que llevan age_ns sin usarse, del más antiguo al
+ * más reciente, y devuelve al sistema las páginas que quedan libres.
+ * fs_lock se toma para cada archivo, de modo que los comandos se
+ * intercalan entre uno y otro.
+ * @return Archivos comprimidos
+ */
+static size_t cold_pass(void) {
+    size_t packed = 0;
+    bool more = true;
+    
+    for (size_t i = 0; i < MAX_FILES; i++) {
+        pthread_mutex_lock(&fs_lock);
+        cold_promote(i);
+        pthread_mutex_unlock(&fs_lock);
+    }
+    while (more) {
+        pthread_mutex_lock(&fs_lock);
+        more = cold_compress_oldest(&packed);
+        pthread_mutex_unlock(&fs_lock);
+    }
+    return packed;
+}
+
+#ifdef FS_TEST_HOOKS
+/**
+ * Comando COLDPASS: envejece todos los archivos y hace una pasada del
+ * nivel frío en el hilo del comando, que ya tiene fs_lock, para probar el
+ * nivel frío sin esperas. Es un gancho de pruebas: solo existe al
+ * compilar con -DFS_TEST_HOOKS (make test).
+ * @param seconds Segundos que envejecen los archivos
+ * @return 0 si es exitoso, -1 en caso de error
+ */
+int cold_test_pass(size_t seconds) {
+    if (!cold.active) {
+        out_printf("Error: El nivel frio no esta activo (--cold).\n");
+        return -1;
+    }
+    if (seconds > COLD_MAX_SECONDS) {
+        out_printf("Error: Como maximo %d segundos.\n", COLD_MAX_SECONDS);
+        return -1;
+    }
+    long long shift = (long long)seconds * 1000000000LL;
+    for (size_t i = 0; i < MAX_FILES; i++) {
+        cold.last_access[i] -= shift;
+        cold.cooled[i] -= shift;
+        cold.tried[i] -= shift;
+    }
+    
+    uint64_t promoted = cold.promoted;
+    size_t packed = 0;
+    for (size_t i = 0; i < MAX_FILES; i++) {
+        cold_promote(i);
+    }
+    while (cold_compress_oldest(&packed)) {
+        continue;
+    }
+    out_printf("Pasada del nivel frio: %zu archivo(s) comprimidos, %llu devueltos a bloques.\n",
+               packed, (unsigned long long)(cold.promoted - promoted));
+    return 0;
+}
+#endif
+
+/**
+ * Hilo del nivel frío: una pasada cada age_ns / COLD_TICKS
+ * @param arg No se usa
+ * @return NULL
+ */
+static void *cold_thread(void *arg) {
+    (void)arg;
+    long long period = cold.age_ns / COLD_TICKS;
+    
+    quiet_thread = true;  /* Nunca escribe en la consola ni en una respuesta */
+    pthread_mutex_lock(&cold.lock);
+    while (!cold.stopping) {
+        struct timespec deadline;
+        clock_gettime(CLOCK_MONOTONIC, &deadline);
+        long long ns = deadline.tv_nsec + period % 1000000000LL;
+        deadline.tv_sec += (time_t)(period / 1000000000LL + ns / 1000000000LL);
+        deadline.tv_nsec = (long)(ns % 1000000000LL);
+        pthread_cond_timedwait(&cold.wake, &cold.lock, &deadline);
+        if (!cold.stopping) {
+            pthread_mutex_unlock(&cold.lock);
+            cold_pass();
+            pthread_mutex_lock(&cold.lock);
+        }
+    }
+    pthread_mutex_unlock(&cold.lock);
+    return NULL;
+}
+
+/**
+ * Activa el nivel frío: todos los archivos cuentan como recién usados y
+ * arranca el hilo que los envejece
+ * @param seconds Tiempo sin uso tras el que un archivo se comprime
+ * @return 0 si es exitoso, -1 en caso de error
+ */
+int cold_start(size_t seconds) {
+    cold.age_ns = (long long)seconds * 1000000000LL;
+    long long now = now_ns();
+    for (size_t i = 0; i < MAX_FILES; i++) {
+        cold.last_access[i] = now;
+        cold.cooled[i] = now;  /* Los fríos de la imagen no cuentan como releídos */
+    }
+    
+    /* Los plazos de la espera no deben moverse si cambia la hora del sistema */
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&cold.wake, &attr);
+    pthread_condattr_destroy(&attr);
+    if (pthread_create(&cold.thread, NULL, cold_thread, NULL) != 0) {
+        out_printf("Error: No se pudo iniciar el hilo del nivel frio.\n");
+        cold.age_ns = 0;
+        return -1;
+    }
+    cold.active = true;
+    
+    out_printf("Nivel frio activo: los archivos sin usar en %zu s se comprimen en memoria.\n\n", seconds);
+    return 0;
+}
+
+/**
+ * Detiene el hilo del nivel frío; los archivos ya comprimidos siguen así
+ */
+void cold_stop(void) {
+    if (!cold.active) {
+        return;
+    }
+    pthread_mutex_lock(&cold.lock);
+    cold.stopping = true;
+    pthread_cond_signal(&cold.wake);
+    pthread_mutex_unlock(&cold.lock);
+    
+    pthread_join(cold.thread, NULL);
+    cold.active = false;
+}
+
+/**
+ * Lista todos los archivos en el sistema
+ */
+void list_files(void) {
+    if (fs.num_files == 0) {
+        out_printf("(no hay archivos)\n");
+        return;
+    }
+    
+    out_printf("\nArchivos en el sistema:\n");
+    out_printf("----------------------------------------\n");
+    out_printf("%-30s %12s\n", "Nombre", "Tamano (bytes)");
+    out_printf("----------------------------------------\n");
+    
+    for (size_t i = 0; i < MAX_FILES; i++) {
+        const FileEntry *file = &fs.file_table[i];
+        if (!file_live(file)) {
+            continue;
+        }
+        if (file->packed_len > 0) {
+            out_printf("%-30s %12zu  (comprimido: %u bytes%s)\n",
+                       file->filename, file->size, file->packed_len, file->cold ? ", frio" : "");
+        } else {
+            out_printf("%-30s %12zu\n", file->filename, file->size);
+        }
+    }
+    
+    out_printf("----------------------------------------\n");
+    out_printf("Total: %zu archivo(s), %zu bytes, %zu bloques utilizados\n\n", 
+               fs.num_files, fs.total_storage, fs.used_blocks);
+}
+
+/**
+ * Tamaño de la sección de metadatos de la imagen: todo fs salvo los bloques
+ */
+static size_t image_meta_size(void) {
+    return sizeof(FileSystem) - offsetof(FileSystem, block_map);
+}
+
+/**
+ * Traduce una dirección dentro de fs a su offset en la imagen en disco
+ * @param addr Dirección dentro de fs
+ * @return Offset en la imagen
+ */
+static uint64_t image_offset_of(const void *addr) {
+    const unsigned char *p = addr;
+    const unsigned char *data = (const unsigned char *)fs.blocks;
+    if (p >= data && p < data + BLOCK_STORE_SIZE) {
+        return IMAGE_DATA_OFFSET + (uint64_t)(p - data);
+    }
+    return IMAGE_META_OFFSET + (uint64_t)(p - (const unsigned char *)fs.block_map);
+}
+
+/**
+ * pwrite completo, reintentando escrituras parciales
+ * @return 0 si es exitoso, -1 en caso de error
+ */
+static int pwrite_all(int fd, const void *buf, size_t len, uint64_t offset) {
+    const unsigned char *p = buf;
+    while (len > 0) {
+        ssize_t n = pwrite(fd, p, len, (off_t)offset);
+        if (n <= 0) {
+            return -1;
+        }
+        p += n;
+        len -= (size_t)n;
+        offset += (uint64_t)n;
+    }
+    return 0;
+}
+
+/**
+ * pread completo, reintentando lecturas parciales
+ * @return 0 si es exitoso, -1 en caso de error o fin de archivo
+ */
+static int pread_all(int fd, void *buf, size_t len, uint64_t offset) {
+    unsigned char *p = buf;
+    while (len > 0) {
+        ssize_t n = pread(fd, p, len, (off_t)offset);
+        if (n <= 0) {
+            return -1;
+        }
+        p += n;
+        len -= (size_t)n;
+        offset += (uint64_t)n;
+    }
+    return 0;
+}
+
+/**
+ * Escribe una imagen completa de fs (cabecera, bloques y metadatos) en un
+ * archivo vacío. Solo se escriben los tramos de bloques asignados; los
+ * libres quedan como huecos del archivo, que se leen como ceros, así que
+ * la imagen ocupa en disco lo que ocupan los datos. Solo usa pwrite y
+ * ftruncate, sin reservar memoria.
+ * @param fd Descriptor de la imagen
+ * @param data Contenido de los bloques a escribir (normalmente fs.blocks)
+ * @return 0 si es exitoso, -1 en caso de error
+ */
+static int write_image(int fd, const void *data) {
+    ImageHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, IMAGE_MAGIC, sizeof(header.magic));
+    header.block_size = BLOCK_SIZE;
+    header.max_blocks = MAX_BLOCKS;
+    header.max_files = MAX_FILES;
+    header.meta_size = (uint32_t)image_meta_size();
+    
+    if (ftruncate(fd, (off_t)(IMAGE_META_OFFSET + image_meta_size())) != 0 ||
+        pwrite_all(fd, &header, sizeof(header), 0) != 0) {
+        return -1;
+    }
+    
+    const unsigned char *bytes = data;
+    for (size_t start = 0; start < fs.capacity_blocks; ) {
+        if (fs.block_map[start] != fs.format_gen) {
+            start++;
+            continue;
+        }
+        size_t end = start;
+        while (end < fs.capacity_blocks && fs.block_map[end] == fs.format_gen) {
+            end++;
+        }
+        if (pwrite_all(fd, bytes + start * BLOCK_SIZE, (end - start) * BLOCK_SIZE,
+                       IMAGE_DATA_OFFSET + (uint64_t)start * BLOCK_SIZE) != 0) {
+            return -1;
+        }
+        start = end;
+    }
+    
+    if (pwrite_all(fd, fs.block_map, image_meta_size(), IMAGE_META_OFFSET) != 0) {
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Carga una imagen en disco y reconstruye el estado derivado (listas del
+ * asignador y paridad)
+ * @param path Ruta de la imagen
+ * @param over_base true para no leer los bloques sino mapear la imagen
+ *                  como base de solo lectura de un volumen superpuesto
+ * @return 0 si es exitoso, -1 en caso de error
+ */
+int mount_image(const char *path, bool over_base) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        out_printf("Error: No se pudo abrir la imagen '%s'.\n", path);
+        return -1;
+    }
+    
+    ImageHeader header;
+    if (pread_all(fd, &header, sizeof(header), 0) != 0 ||
+        memcmp(header.magic, IMAGE_MAGIC, sizeof(header.magic)) != 0 ||
+        header.block_size != BLOCK_SIZE || header.max_blocks != MAX_BLOCKS ||
+        header.max_files != MAX_FILES || header.meta_size != image_meta_size()) {
+        out_printf("Error: '%s' no es una imagen compatible.\n", path);
+        close(fd);
+        return -1;
+    }
+    
+    /* Metadatos primero: solo se leen los tramos de bloques asignados */
+    bool complete = pread_all(fd, fs.block_map, image_meta_size(), IMAGE_META_OFFSET) == 0;
+    extent_cache_clear();
+    dict_index.gen = 0;
+    if (complete && over_base) {
+        if (IMAGE_DATA_OFFSET % store.page_size != 0 ||
+            mmap(fs.blocks, BLOCK_STORE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED,
+                 fd, IMAGE_DATA_OFFSET) == MAP_FAILED) {
+            out_printf("Error: No se pudo mapear la imagen base '%s'.\n", path);
+            close(fd);
+            return -1;
+        }
+        if (store.fd >= 0) {
+            close(store.fd);
+            store.fd = -1;
+        }
+        store.kind = STORE_OVERLAY;
+    }
+    for (size_t start = 0; complete && !over_base && start < fs.capacity_blocks; ) {
+        if (fs.block_map[start] != fs.format_gen) {
+            start++;
+            continue;
+        }
+        size_t end = start;
+        while (end < fs.capacity_blocks && fs.block_map[end] == fs.format_gen) {
+            end++;
+        }
+        complete = pread_all(fd, fs.blocks[start], (end - start) * BLOCK_SIZE,
+                             IMAGE_DATA_OFFSET + (uint64_t)start * BLOCK_SIZE) == 0;
+        start = end;
+    }
+    close(fd);
+    if (!complete) {
+        out_printf("Error: La imagen '%s' esta incompleta.\n", path);
+        return -1;
+    }
+    
+    if (alloc_policies[fs.policy].reset != NULL) {
+        alloc_policies[fs.policy].reset();
+    }
+    if (parity.level > 0) {
+        for (size_t g = 0; g < PARITY_GROUPS; g++) {
+            recompute_group_parity(g);
+        }
+    }
+    
+    out_printf("Imagen '%s' montada%s: %zu archivo(s), %zu bloques utilizados, politica %s.\n\n",
+               path, over_base ? " como base de solo lectura" : "",
+               fs.num_files, fs.used_blocks, alloc_policies[fs.policy].name);
+    thin_check_watermarks();
+    return 0;
+}
+
+/**
+ * Clase de slab para un tamaño
+ * @param len Bytes pedidos
+ * @return Índice de la clase, -1 si no cabe en la mayor (se usa malloc)
+ */
+static int slab_class_of(size_t len) {
+    int cls = 0;
+    while (cls < SLAB_CLASSES && ((size_t)1 << (SLAB_MIN_SHIFT + cls)) < len) {
+        cls++;
+    }
+    return cls < SLAB_CLASSES ? cls : -1;
+}
+
+/**
+ * Devuelve a las listas compartidas todos los objetos de la caché de un
+ * hilo que termina, para que no se pierdan con él
+ * @param caches Cachés del hilo (su slab_cache)
+ */
+static void slab_drain(void *caches) {
+    SlabCache *cache = caches;
+    for (int cls = 0; cls < SLAB_CLASSES; cls++) {
+        if (cache[cls].head == NULL) {
+            continue;
+        }
+        SlabObject *last = cache[cls].head;
+        while (last->next != NULL) {
+            last = last->next;
+        }
+        SlabClass *sc = &slab_classes[cls];
+        pthread_mutex_lock(&sc->lock);
+        last->next = sc->free_list;
+        sc->free_list = cache[cls].head;
+        pthread_mutex_unlock(&sc->lock);
+        cache[cls].head = NULL;
+        cache[cls].count = 0;
+    }
+}
+
+/**
+ * Crea la clave cuyo destructor vacía las cachés de los hilos
+ */
+static void slab_exit_key_create(void) {
+    pthread_key_create(&slab_exit_key, slab_drain);
+}
+
+/**
+ * Registra la caché del hilo la primera vez que guarda objetos, para
+ * vaciarla cuando el hilo termine
+ */
+static void slab_cache_own(void) {
+    if (slab_cache_owned) {
+        return;
+    }
+    pthread_once(&slab_exit_once, slab_exit_key_create);
+    slab_cache_owned = pthread_setspecific(slab_exit_key, slab_cache) == 0;
+}
+
+/**
+ * Rellena la caché del hilo con hasta la mitad de su capacidad, tomando
+ * el bloqueo de la clase una sola vez. Si la lista compartida está vacía
+ * se trocea un chunk nuevo.
+ * @param cls Clase de tamaño
+ */
+static void slab_refill(int cls) {
+    SlabClass *sc = &slab_classes[cls];
+    SlabCache *cache = &slab_cache[cls];
+    size_t size = (size_t)1 << (SLAB_MIN_SHIFT + cls);
+    
+    slab_cache_own();
+    pthread_mutex_lock(&sc->lock);
+    if (sc->free_list == NULL) {
+        unsigned char *chunk = mmap(NULL, SLAB_CHUNK_SIZE, PROT_READ | PROT_WRITE,
+                                    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (chunk != MAP_FAILED) {
+            for (size_t off = SLAB_CHUNK_SIZE; off >= size; off -= size) {
+                SlabObject *obj = (SlabObject *)(chunk + off - size);
+                obj->next = sc->free_list;
+                sc->free_list = obj;
+            }
+            sc->chunk_bytes += SLAB_CHUNK_SIZE;
+        }
+    }
+    while (sc->free_list != NULL && cache->count < SLAB_CACHE_LEN / 2) {
+        SlabObject *obj = sc->free_list;
+        sc->free_list = obj->next;
+        obj->next = cache->head;
+        cache->head = obj;
+        cache->count++;
+    }
+    pthread_mutex_unlock(&sc->lock);
+}
+
+/**
+ * Reserva memoria para un registro
+ * @param len Bytes necesarios
+ * @return Puntero a la memoria, NULL si no hay memoria
+ */
+static void *slab_alloc(size_t len) {
+    int cls = slab_class_of(len);
+    if (cls < 0) {
+        return malloc(len);
+    }
+    SlabCache *cache = &slab_cache[cls];
+    if (cache->head == NULL) {
+        slab_refill(cls);
+        if (cache->head == NULL) {
+            return NULL;
+        }
+    }
+    SlabObject *obj = cache->head;
+    cache->head = obj->next;
+    cache->count--;
+    return obj;
+}
+
+/**
+ * Devuelve memoria de slab_alloc a la caché del hilo. Cuando la caché se
+ * llena, la mitad pasa a la lista compartida de una vez, de modo que un
+ * hilo que solo libera (como el del espejo) paga un bloqueo cada
+ * SLAB_CACHE_LEN / 2 objetos.
+ * @param ptr Memoria a liberar (puede ser NULL)
+ * @param len Tamaño con el que se reservó
+ */
+static void slab_free(void *ptr, size_t len) {
+    if (ptr == NULL) {
+        return;
+    }
+    int cls = slab_class_of(len);
+    if (cls < 0) {
+        free(ptr);
+        return;
+    }
+    SlabCache *cache = &slab_cache[cls];
+    SlabObject *obj = ptr;
+    slab_cache_own();
+    obj->next = cache->head;
+    cache->head = obj;
+    cache->count++;
+    if (cache->count < SLAB_CACHE_LEN) {
+        return;
+    }
+    
+    /* Separar la mitad y entregarla a la lista compartida en bloque */
+    SlabObject *first = cache->head, *last = first;
+    for (size_t i = 1; i < SLAB_CACHE_LEN / 2; i++) {
+        last = last->next;
+    }
+    cache->head = last->next;
+    cache->count -= SLAB_CACHE_LEN / 2;
+    
+    SlabClass *sc = &slab_classes[cls];
+    pthread_mutex_lock(&sc->lock);
+    last->next = sc->free_list;
+    sc->free_list = first;
+    pthread_mutex_unlock(&sc->lock);
+}
+
+/**
+ * Encola un registro para el espejo. Solo espera si la cola está llena o
+ * si falta memoria para la copia: entonces espera a que el hilo del espejo
+ * vacíe la cola y lo reintenta. Si aun así no hay memoria, el espejo queda
+ * desincronizado y deja de aplicar registros, de modo que conserva el
+ * estado anterior al registro perdido.
+ * @param offset Offset en la imagen
+ * @param src Bytes a replicar
+ * @param len Número de bytes
+ */
+static void mirror_enqueue(uint64_t offset, const void *src, size_t len) {
+    unsigned char *copy = slab_alloc(len);
+    if (copy == NULL) {
+        pthread_mutex_lock(&mirror.lock);
+        while (mirror.tail != mirror.head) {
+            pthread_cond_wait(&mirror.not_full, &mirror.lock);
+        }
+        pthread_mutex_unlock(&mirror.lock);
+        copy = slab_alloc(len);
+    }
+    if (copy == NULL) {
+        pthread_mutex_lock(&mirror.lock);
+        if (!mirror.out_of_sync) {
+            fprintf(stderr, "Espejo: sin memoria para un registro de %zu bytes, queda desincronizado.\n", len);
+        }
+        mirror.out_of_sync = true;
+        pthread_mutex_unlock(&mirror.lock);
+        return;
+    }
+    memcpy(copy, src, len);
+    
+    pthread_mutex_lock(&mirror.lock);
+    while (mirror.tail - mirror.head == MIRROR_QUEUE_LEN) {
+        pthread_cond_wait(&mirror.not_full, &mirror.lock);
+    }
+    MirrorRecord *rec = &mirror.ring[mirror.tail % MIRROR_QUEUE_LEN];
+    rec->offset = offset;
+    rec->len = len;
+    rec->bytes = copy;
+    rec->enqueued_ns = now_ns();
+    mirror.tail++;
+    pthread_cond_signal(&mirror.not_empty);
+    pthread_mutex_unlock(&mirror.lock);
+}
+
+/**
+ * Hilo del espejo: aplica los registros por lotes y sincroniza una vez
+ * por lote
+ */
+static void *mirror_thread(void *arg) {
+    (void)arg;
+    MirrorRecord batch[MIRROR_BATCH];
+    bool failed = false;
+    
+    pthread_mutex_lock(&mirror.lock);
+    for (;;) {
+        while (mirror.head == mirror.tail && !mirror.stopping) {
+            pthread_cond_wait(&mirror.not_empty, &mirror.lock);
+        }
+        if (mirror.head == mirror.tail) {
+            break;  /* Detenido y sin registros pendientes */
+        }
+        failed = failed || mirror.out_of_sync;
+        
+        size_t n = mirror.tail - mirror.head;
+        if (n > MIRROR_BATCH) {
+            n = MIRROR_BATCH;
+        }
+        for (size_t i = 0; i < n; i++) {
+            batch[i] = mirror.ring[(mirror.head + i) % MIRROR_QUEUE_LEN];
+        }
+        pthread_mutex_unlock(&mirror.lock);
+        
+        for (size_t i = 0; i < n; i++) {
+            if (!failed && pwrite_all(mirror.fd, batch[i].bytes, batch[i].len, batch[i].offset) != 0) {
+                fprintf(stderr, "Espejo: error de escritura, se deja de replicar.\n");
+                failed = true;
+            }
+            slab_free(batch[i].bytes, batch[i].len);
+        }
+        if (!failed) {
+            fdatasync(mirror.fd);
+        }
+        long long lag = now_ns() - batch[n - 1].enqueued_ns;
+        
+        pthread_mutex_lock(&mirror.lock);
+        mirror.out_of_sync = mirror.out_of_sync || failed;
+        mirror.head += n;
+        mirror.applied += n;
+        mirror.batches++;
+        mirror.last_lag_ns = lag;
+        if (lag > mirror.max_lag_ns) {
+            mirror.max_lag_ns = lag;
+        }
+        pthread_cond_broadcast(&mirror.not_full);
+    }
+    pthread_mutex_unlock(&mirror.lock);
+    return NULL;
+}
+
+/**
+ * Marca un bloque como modificado en la operación en curso
+ * @param block Bloque físico
+ */
+void journal_block(size_t block) {
+    if (!journal.active || journal.block_dirty[block]) {
+        return;
+    }
+    journal.block_dirty[block] = true;
+    journal.dirty_blocks[journal.num_dirty_blocks++] = block;
+}
+
+/**
+ * Marca una entrada del mapa de bloques como modificada
+ * @param block Bloque físico
+ */
+void journal_map(size_t block) {
+    if (!journal.active) {
+        return;
+    }
+    if (journal.map_lo >= journal.map_hi) {
+        journal.map_lo = block;
+        journal.map_hi = block + 1;
+    } else if (block < journal.map_lo) {
+        journal.map_lo = block;
+    } else if (block >= journal.map_hi) {
+        journal.map_hi = block + 1;
+    }
+}
+
+/**
+ * Marca un hueco del índice de nombres como modificado
+ * @param slot Hueco del índice
+ */
+void journal_name(size_t slot) {
+    if (!journal.active) {
+        return;
+    }
+    if (journal.name_lo >= journal.name_hi) {
+        journal.name_lo = slot;
+        journal.name_hi = slot + 1;
+    } else if (slot < journal.name_lo) {
+        journal.name_lo = slot;
+    } else if (slot >= journal.name_hi) {
+        journal.name_hi = slot + 1;
+    }
+}
+
+/**
+ * Marca una entrada de la tabla de archivos como modificada
+ * @param file Entrada modificada
+ */
+void journal_file(const FileEntry *file) {
+    if (!journal.active) {
+        return;
+    }
+    journal.file_dirty[file - fs.file_table] = true;
+}
+
+/**
+ * Marca el diccionario como sustituido
+ */
+void journal_dict(void) {
+    journal.dict = journal.active;
+}
+
+/**
+ * Agrega un registro al log de replicación y despierta a los emisores
+ * @param offset Offset en la imagen
+ * @param src Bytes del registro
+ * @param len Número de bytes
+ * @param flags REPL_COMMIT_END en el último registro de un comando
+ */
+static void repl_append(uint64_t offset, const void *src, size_t len, uint32_t flags) {
+    unsigned char *copy = slab_alloc(len);
+    if (copy == NULL) {
+        fprintf(stderr, "Replicacion: sin memoria para un registro de %zu bytes.\n", len);
+        return;
+    }
+    memcpy(copy, src, len);
+    
+    pthread_mutex_lock(&repl.lock);
+    uint64_t seq = ++repl.log_seq;
+    ReplRecord *rec = &repl.log[seq % REPL_LOG_LEN];
+    slab_free(rec->bytes, rec->frame.len);
+    rec->bytes = copy;
+    rec->frame.seq = seq;
+    rec->frame.offset = offset;
+    rec->frame.len = (uint32_t)len;
+    rec->frame.flags = flags;
+    rec->frame.appended_ns = now_ns();
+    pthread_cond_broadcast(&repl.appended);
+    pthread_mutex_unlock(&repl.lock);
+}
+
+/**
+ * Emite un registro con el estado actual de un tramo de fs
+ * @param addr Inicio del tramo
+ * @param len Bytes del tramo
+ * @param last true si es el último registro del comando
+ */
+static void journal_emit(const void *addr, size_t len, bool last) {
+    journal.seq++;
+    if (mirror.active) {
+        mirror_enqueue(image_offset_of(addr), addr, len);
+    }
+    if (repl.primary) {
+        repl_append(image_offset_of(addr), addr, len, last ? REPL_COMMIT_END : 0);
+    }
+}
+
+/**
+ * Marca los contadores como modificados aunque no cambie nada más
+ */
+void journal_counters(void) {
+    journal.counters = journal.active;
+}
+
+/**
+ * Cierra la operación en curso: emite los bloques, el tramo del mapa, las
+ * entradas y los contadores modificados
+ */
+void journal_commit(void) {
+    if (!journal.active) {
+        return;
+    }
+    bool changed = journal.num_dirty_blocks > 0 || journal.map_lo < journal.map_hi ||
+                   journal.name_lo < journal.name_hi || journal.counters || journal.dict;
+    journal.counters = false;
+    
+    for (size_t i = 0; i < journal.num_dirty_blocks; i++) {
+        size_t block = journal.dirty_blocks[i];
+        journal_emit(fs.blocks[block], BLOCK_SIZE, false);
+        journal.block_dirty[block] = false;
+    }
+    journal.num_dirty_blocks = 0;
+    
+    if (journal.map_lo < journal.map_hi) {
+        journal_emit(&fs.block_map[journal.map_lo],
+                     (journal.map_hi - journal.map_lo) * sizeof(fs.block_map[0]), false);
+        journal.map_lo = journal.map_hi = 0;
+    }
+    
+    if (journal.name_lo < journal.name_hi) {
+        journal_emit(&fs.name_index[journal.name_lo],
+                     (journal.name_hi - journal.name_lo) * sizeof(NameSlot), false);
+        journal.name_lo = journal.name_hi = 0;
+    }
+    
+    if (journal.dict) {
+        /* Generación, longitud y bytes usados del diccionario, antes que las entradas */
+        journal_emit(&fs.dict_gen, offsetof(FileSystem, dict) - offsetof(FileSystem, dict_gen) + fs.dict_len,
+                     false);
+        journal.dict = false;
+    }
+    
+    for (size_t i = 0; i < MAX_FILES; i++) {
+        if (!journal.file_dirty[i]) {
+            continue;
+        }
+        const FileEntry *file = &fs.file_table[i];
+        journal_emit(file, offsetof(FileEntry, extents), false);
+        if (file->extent_len > 0) {
+            journal_emit(file->extents, file->extent_len, false);
+        }
+        journal_emit(&file->in_use, sizeof(file->in_use), false);
+        journal.file_dirty[i] = false;
+        changed = true;
+    }
+    
+    if (changed) {
+        /* Los contadores cierran siempre el comando */
+        journal_emit(&fs.num_files, sizeof(FileSystem) - offsetof(FileSystem, num_files), true);
+    }
+}
+
+/**
+ * Activa el espejo: copia la imagen completa y arranca el hilo que
+ * aplicará los cambios siguientes
+ * @param path Ruta de la imagen espejo
+ * @return 0 si es exitoso, -1 en caso de error
+ */
+int mirror_start(const char *path) {
+    mirror.fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (mirror.fd < 0) {
+        out_printf("Error: No se pudo crear la imagen espejo '%s'.\n", path);
+        return -1;
+    }
+    if (write_image(mirror.fd, fs.blocks) != 0 || fdatasync(mirror.fd) != 0) {
+        out_printf("Error: No se pudo escribir la imagen espejo '%s'.\n", path);
+        close(mirror.fd);
+        mirror.fd = -1;
+        return -1;
+    }
+    
+    if (pthread_create(&mirror.thread, NULL, mirror_thread, NULL) != 0) {
+        out_printf("Error: No se pudo iniciar el hilo del espejo.\n");
+        close(mirror.fd);
+        mirror.fd = -1;
+        return -1;
+    }
+    mirror.out_of_sync = false;
+    mirror.active = true;
+    journal.active = true;
+    
+    out_printf("Espejo asincrono activo en '%s'.\n\n", path);
+    return 0;
+}
+
+/**
+ * Detiene el espejo tras aplicar los registros pendientes
+ */
+void mirror_stop(void) {
+    if (!mirror.active) {
+        return;
+    }
+    pthread_mutex_lock(&mirror.lock);
+    mirror.stopping = true;
+    pthread_cond_signal(&mirror.not_empty);
+    pthread_mutex_unlock(&mirror.lock);
+    
+    pthread_join(mirror.thread, NULL);
+    close(mirror.fd);
+    mirror.fd = -1;
+    mirror.active = false;
+    journal.active = false;
+}
+
+/**
+ * Muestra el estado del espejo y su retraso de replicación
+ */
+void mirror_status(void) {
+    if (!mirror.active) {
+        out_printf("Espejo desactivado.\n");
+        return;
+    }
+    pthread_mutex_lock(&mirror.lock);
+    size_t pending = mirror.tail - mirror.head;
+    long long oldest = pending > 0 ? now_ns() - mirror.ring[mirror.head % MIRROR_QUEUE_LEN].enqueued_ns : 0;
+    out_printf("Espejo: %llu registros aplicados en %zu lotes, %zu pendientes\n",
+               (unsigned long long)mirror.applied, mirror.batches, pending);
+    out_printf("  Retraso actual: %.3f ms, ultimo lote: %.3f ms, maximo: %.3f ms\n",
+               (double)oldest / 1e6, (double)mirror.last_lag_ns / 1e6, (double)mirror.max_lag_ns / 1e6);
+    if (mirror.out_of_sync) {
+        out_printf("  Desincronizado: se perdio un registro o fallo una escritura; vuelva a activar el espejo.\n");
+    }
+    pthread_mutex_unlock(&mirror.lock);
+}
+
+/**
+ * Traduce un offset de la imagen a la dirección correspondiente de fs,
+ * comprobando que el tramo completo cae dentro de una sección
+ * @param offset Offset en la imagen
+ * @param len Bytes del tramo
+ * @return Dirección en fs, NULL si el tramo no es válido
+ */
+static void *image_address_of(uint64_t offset, size_t len) {
+    if (offset >= IMAGE_DATA_OFFSET && offset + len <= IMAGE_DATA_OFFSET + BLOCK_STORE_SIZE) {
+        return (unsigned char *)fs.blocks + (offset - IMAGE_DATA_OFFSET);
+    }
+    if (offset >= IMAGE_META_OFFSET && offset + len <= IMAGE_META_OFFSET + image_meta_size()) {
+        return (unsigned char *)fs.block_map + (offset - IMAGE_META_OFFSET);
+    }
+    return NULL;
+}
+
+/**
+ * Envía un buffer completo por un socket
+ * @return 0 si es exitoso, -1 en caso de error
+ */
+static int send_all(int fd, const void *buf, size_t len) {
+    const unsigned char *p = buf;
+    while (len > 0) {
+        ssize_t n = write(fd, p, len);
+        if (n <= 0) {
+            return -1;
+        }
+        p += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+/**
+ * Recibe exactamente len bytes de un socket
+ * @return 0 si es exitoso, -1 en caso de error o desconexión
+ */
+static int recv_all(int fd, void *buf, size_t len) {
+    unsigned char *p = buf;
+    while (len > 0) {
+        ssize_t n = read(fd, p, len);
+        if (n <= 0) {
+            return -1;
+        }
+        p += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+/**
+ * Hilo emisor de un seguidor: envía la instantánea y después el log
+ * desde el seq de la instantánea
+ * @param arg Follower atendido
+ */
+static void *repl_sender_thread(void *arg) {
+    Follower *f = arg;
+    unsigned char *buf = NULL;
+    size_t buf_cap = 0;
+    
+    bool ok = send_all(f->fd, f->snapshot, f->snapshot_len) == 0;
+    free(f->snapshot);
+    f->snapshot = NULL;
+    
+    while (ok) {
+        pthread_mutex_lock(&repl.lock);
+        while (f->next_seq > repl.log_seq && f->active) {
+            pthread_cond_wait(&repl.appended, &repl.lock);
+        }
+        if (!f->active || repl.log_seq - f->next_seq >= REPL_LOG_LEN) {
+            /* Desconectado o tan atrasado que el log ya no tiene su registro */
+            pthread_mutex_unlock(&repl.lock);
+            break;
+        }
+        const ReplRecord *rec = &repl.log[f->next_seq % REPL_LOG_LEN];
+        ReplFrame frame = rec->frame;
+        if (frame.len > buf_cap) {
+            unsigned char *bigger = realloc(buf, frame.len);
+            if (bigger == NULL) {
+                pthread_mutex_unlock(&repl.lock);
+                break;
+            }
+            buf = bigger;
+            buf_cap = frame.len;
+        }
+        memcpy(buf, rec->bytes, frame.len);
+        pthread_mutex_unlock(&repl.lock);
+        
+        ok = send_all(f->fd, &frame, sizeof(frame)) == 0 &&
+             send_all(f->fd, buf, frame.len) == 0;
+        pthread_mutex_lock(&repl.lock);
+        f->next_seq++;  /* REPLICA lo lee con repl.lock */
+        pthread_mutex_unlock(&repl.lock);
+    }
+    
+    free(buf);
+    pthread_mutex_lock(&repl.lock);
+    close(f->fd);
+    f->fd = -1;
+    f->active = false;
+    pthread_mutex_unlock(&repl.lock);
+    return NULL;
+}
+
+/**
+ * Hilo de aceptación del primario: por cada seguidor toma una instantánea
+ * consistente (entre dos comandos) y arranca su emisor
+ */
+static void *repl_accept_thread(void *arg) {
+    (void)arg;
+    for (;;) {
+        int fd = accept(repl.listen_fd, NULL, NULL);
+        if (fd < 0) {
+            break;
+        }
+        
+        ReplSnapshotHeader header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, REPL_MAGIC, sizeof(header.magic));
+        header.data_size = BLOCK_STORE_SIZE;
+        header.meta_size = image_meta_size();
+        size_t len = sizeof(header) + header.data_size + header.meta_size;
+        unsigned char *snapshot = malloc(len);
+        if (snapshot == NULL) {
+            close(fd);
+            continue;
+        }
+        
+        pthread_mutex_lock(&fs_lock);
+        pthread_mutex_lock(&repl.lock);
+        Follower *f = NULL;
+        for (size_t i = 0; i < REPL_MAX_FOLLOWERS && f == NULL; i++) {
+            if (!repl.followers[i].active) {
+                f = &repl.followers[i];
+            }
+        }
+        if (f != NULL) {
+            header.seq = repl.log_seq;
+            memcpy(snapshot, &header, sizeof(header));
+            memcpy(snapshot + sizeof(header), fs.blocks, header.data_size);
+            memcpy(snapshot + sizeof(header) + header.data_size, fs.block_map, header.meta_size);
+            f->fd = fd;
+            f->active = true;
+            f->next_seq = header.seq + 1;
+            f->snapshot = snapshot;
+            f->snapshot_len = len;
+        }
+        pthread_mutex_unlock(&repl.lock);
+        pthread_mutex_unlock(&fs_lock);
+        
+        pthread_t thread;
+        if (f == NULL) {
+            free(snapshot);
+            close(fd);
+        } else if (pthread_create(&thread, NULL, repl_sender_thread, f) == 0) {
+            pthread_detach(thread);
+        } else {
+            pthread_mutex_lock(&repl.lock);
+            free(f->snapshot);
+            f->snapshot = NULL;
+            f->active = false;
+            close(fd);
+            pthread_mutex_unlock(&repl.lock);
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Convierte este proceso en primario: escucha seguidores en un socket Unix
+ * @param path Ruta del socket
+ * @return 0 si es exitoso, -1 en caso de error
+ */
+int repl_start_primary(const char *path) {
+    struct sockaddr_un addr;
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        out_printf("Error: Ruta de socket demasiado larga.\n");
+        return -1;
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+    
+    repl.listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    unlink(path);
+    if (repl.listen_fd < 0 ||
+        bind(repl.listen_fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+        listen(repl.listen_fd, REPL_MAX_FOLLOWERS) != 0) {
+        out_printf("Error: No se pudo escuchar en '%s'.\n", path);
+        return -1;
+    }
+    
+    /* Un seguidor que se desconecta no debe terminar el primario */
+    signal(SIGPIPE, SIG_IGN);
+    repl.path = path;
+    repl.primary = true;
+    journal.active = true;
+    
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, repl_accept_thread, NULL) != 0) {
+        out_printf("Error: No se pudo iniciar el hilo de replicacion.\n");
+        return -1;
+    }
+    pthread_detach(thread);
+    
+    out_printf("Primario escuchando seguidores en '%s'.\n\n", path);
+    return 0;
+}
+
+/**
+ * Hilo receptor del seguidor: acumula los registros de cada comando y los
+ * aplica juntos, para que READ/LIST nunca vean un comando a medias
+ */
+static void *repl_receiver_thread(void *arg) {
+    (void)arg;
+    ReplFrame *frames = NULL;
+    unsigned char **payloads = NULL;
+    size_t count = 0, cap = 0;
+    
+    for (;;) {
+        ReplFrame frame;
+        if (recv_all(repl.fd, &frame, sizeof(frame)) != 0) {
+            break;
+        }
+        unsigned char *bytes = slab_alloc(frame.len > 0 ? frame.len : 1);
+        if (bytes == NULL || recv_all(repl.fd, bytes, frame.len) != 0) {
+            slab_free(bytes, frame.len > 0 ? frame.len : 1);
+            break;
+        }
+        
+        if (count == cap) {
+            size_t new_cap = cap ? cap * 2 : 64;
+            ReplFrame *nf = realloc(frames, new_cap * sizeof(*nf));
+            unsigned char **np = nf ? realloc(payloads, new_cap * sizeof(*np)) : NULL;
+            if (nf != NULL) {
+                frames = nf;
+            }
+            if (np == NULL) {
+                slab_free(bytes, frame.len > 0 ? frame.len : 1);
+                break;
+            }
+            payloads = np;
+            cap = new_cap;
+        }
+        frames[count] = frame;
+        payloads[count] = bytes;
+        count++;
+        
+        if (!(frame.flags & REPL_COMMIT_END)) {
+            continue;
+        }
+        
+        pthread_mutex_lock(&fs_lock);
+        for (size_t i = 0; i < count; i++) {
+            void *dst = image_address_of(frames[i].offset, frames[i].len);
+            if (dst != NULL && frames[i].len > 0 && frames[i].offset >= IMAGE_DATA_OFFSET &&
+                frames[i].offset < IMAGE_DATA_OFFSET + BLOCK_STORE_SIZE) {
+                /* Las páginas prestadas a un EXPORT en curso conservan los bytes antiguos */
+                size_t first = (size_t)(frames[i].offset - IMAGE_DATA_OFFSET) / BLOCK_SIZE;
+                size_t last = (size_t)(frames[i].offset + frames[i].len - 1 - IMAGE_DATA_OFFSET) / BLOCK_SIZE;
+                export_unlend(first, last - first + 1);
+            }
+            if (dst != NULL) {
+                memcpy(dst, payloads[i], frames[i].len);
+            }
+            slab_free(payloads[i], frames[i].len > 0 ? frames[i].len : 1);
+        }
+        repl.applied_seq = frame.seq;
+        repl.applied_commits++;
+        repl.last_lag_ns = now_ns() - frame.appended_ns;
+        if (repl.last_lag_ns > repl.max_lag_ns) {
+            repl.max_lag_ns = repl.last_lag_ns;
+        }
+        pthread_mutex_unlock(&fs_lock);
+        count = 0;
+    }
+    
+    for (size_t i = 0; i < count; i++) {
+        slab_free(payloads[i], frames[i].len > 0 ? frames[i].len : 1);
+    }
+    free(frames);
+    free(payloads);
+    pthread_mutex_lock(&fs_lock);
+    repl.connected = false;
+    pthread_mutex_unlock(&fs_lock);
+    fprintf(stderr, "Replica: conexion con el primario cerrada.\n");
+    return NULL;
+}
+
+/**
+ * Convierte este proceso en seguidor de solo lectura: carga la
+ * instantánea del primario y aplica su log en segundo plano
+ * @param path Ruta del socket del primario
+ * @return 0 si es exitoso, -1 en caso de error
+ */
+int repl_start_follower(const char *path) {
+    struct sockaddr_un addr;
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        out_printf("Error: Ruta de socket demasiado larga.\n");
+        return -1;
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+    
+    repl.fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (repl.fd < 0 || connect(repl.fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        out_printf("Error: No se pudo conectar con el primario en '%s'.\n", path);
+        return -1;
+    }
+    
+    ReplSnapshotHeader header;
+    if (recv_all(repl.fd, &header, sizeof(header)) != 0 ||
+        memcmp(header.magic, REPL_MAGIC, sizeof(header.magic)) != 0 ||
+        header.data_size != BLOCK_STORE_SIZE || header.meta_size != image_meta_size() ||
+        recv_all(repl.fd, fs.blocks, BLOCK_STORE_SIZE) != 0 ||
+        recv_all(repl.fd, fs.block_map, image_meta_size()) != 0) {
+        out_printf("Error: Instantanea del primario invalida.\n");
+        return -1;
+    }
+    extent_cache_clear();
+    
+    /* El seguidor no escribe: la paridad local no se mantiene */
+    parity.level = 0;
+    repl.follower = true;
+    repl.connected = true;
+    repl.applied_seq = header.seq;
+    
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, repl_receiver_thread, NULL) != 0) {
+        out_printf("Error: No se pudo iniciar el hilo de replicacion.\n");
+        return -1;
+    }
+    pthread_detach(thread);
+    
+    out_printf("Replica de solo lectura de '%s' (seq %llu, %zu archivo(s)).\n\n",
+               path, (unsigned long long)header.seq, fs.num_files);
+    return 0;
+}
+
+/**
+ * Deja de aceptar seguidores y elimina el socket del primario
+ */
+void repl_stop(void) {
+    if (!repl.primary) {
+        return;
+    }
+    close(repl.listen_fd);
+    unlink(repl.path);
+}
+
+/**
+ * Indica si un comando modifica el sistema de archivos (un seguidor los rechaza)
+ * @param command Línea de comando
+ */
+static bool is_mutating_command(const char *command) {
+    static const char *const verbs[] = {
+        "CREATE ", "WRITE ", "DELETE ", "DELETE-MATCH ", "FALLOCATE ", "PUNCH ", "GROW "
+    };
+    for (size_t i = 0; i < sizeof(verbs) / sizeof(verbs[0]); i++) {
+        if (strncmp(command, verbs[i], strlen(verbs[i])) == 0) {
+            return true;
+        }
+    }
+    return strcmp(command, "FORMAT") == 0 || strcmp(command, "TRAINDICT") == 0 ||
+           strncmp(command, "TRAINDICT ", 10) == 0;
+}
+
+/**
+ * Muestra el estado de la replicación (primario o seguidor)
+ */
+void repl_status(void) {
+    if (repl.primary) {
+        pthread_mutex_lock(&repl.lock);
+        out_printf("Primario: log en seq %llu\n", (unsigned long long)repl.log_seq);
+        for (size_t i = 0; i < REPL_MAX_FOLLOWERS; i++) {
+            if (repl.followers[i].active) {
+                out_printf("  Seguidor %zu: enviado hasta seq %llu (%llu registros atras)\n", i,
+                           (unsigned long long)(repl.followers[i].next_seq - 1),
+                           (unsigned long long)(repl.log_seq + 1 - repl.followers[i].next_seq));
+            }
+        }
+        pthread_mutex_unlock(&repl.lock);
+    } else if (repl.follower) {
+        out_printf("Seguidor %s: aplicado hasta seq %llu (%llu comandos)\n",
+                   repl.connected ? "conectado" : "desconectado",
+                   (unsigned long long)repl.applied_seq, (unsigned long long)repl.applied_commits);
+        out_printf("  Retraso del ultimo comando: %.3f ms, maximo: %.3f ms\n",
+                   (double)repl.last_lag_ns / 1e6, (double)repl.max_lag_ns / 1e6);
+    } else {
+        out_printf("Replicacion desactivada.\n");
+    }
+}
+
+/**
+ * Crea el almacén de bloques. Con STORE_MEMFD los bloques viven en un
+ * memfd mapeado MAP_SHARED, de modo que MAPVIEW puede volver a mapear
+ * sus páginas en otras direcciones sin copiarlas.
+ * @param kind Respaldo deseado
+ * @return 0 si es exitoso, -1 en caso de error
+ */
+int block_store_init(StoreKind kind) {
+    long page = sysconf(_SC_PAGESIZE);
+    store.page_size = page > 0 ? (size_t)page : PAGE_SIZE_BYTES;
+    store.kind = kind;
+    
+    void *addr = MAP_FAILED;
+    if (kind == STORE_MEMFD) {
+#ifdef MFD_CLOEXEC
+        store.fd = memfd_create("sfs-blocks", MFD_CLOEXEC);
+#endif
+        if (store.fd < 0 || ftruncate(store.fd, (off_t)BLOCK_STORE_SIZE) != 0) {
+            out_printf("Error: No se pudo crear el memfd del almacen de bloques.\n");
+            return -1;
+        }
+        addr = mmap(NULL, BLOCK_STORE_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, store.fd, 0);
+    } else {
+        /* Sin reserva de swap: las páginas se comprometen al escribirlas */
+        addr = mmap(NULL, BLOCK_STORE_SIZE, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    }
+    if (addr == MAP_FAILED) {
+        out_printf("Error: No se pudo mapear el almacen de bloques.\n");
+        return -1;
+    }
+    fs.blocks = addr;
+    return 0;
+}
+
+/**
+ * Construye una vista contigua y de solo lectura de un archivo. Cada
+ * página de la vista cuyos bloques ocupan una página física completa y
+ * alineada del memfd se mapea directamente (sin copia); las demás
+ * páginas se copian y los huecos quedan como páginas a cero.
+ * @param filename Nombre del archivo
+ * @param view Vista resultante
+ * @return 0 si es exitoso, -1 en caso de error
+ */
+int map_file_view(const char *filename, FileView *view) {
+    memset(view, 0, sizeof(*view));
+    
+    FileEntry *file = find_file(filename);
+    if (file == NULL) {
+        out_printf("Error: El archivo '%s' no existe.\n", filename);
+        return -1;
+    }
+    cold_touch(file);
+    if (store.kind != STORE_MEMFD || store.page_size % BLOCK_SIZE != 0) {
+        out_printf("Error: MAPVIEW requiere el almacen respaldado por memfd (--store=memfd).\n");
+        return -1;
+    }
+    
+    size_t per_page = store.page_size / BLOCK_SIZE;
+    size_t pages = (file_logical_blocks(file) + per_page - 1) / per_page;
+    if (pages == 0) {
+        out_printf("Error: El archivo '%s' no tiene bloques.\n", filename);
+        return -1;
+    }
+    
+    /* La vista expone los bytes crudos: reparar antes los bloques dañados */
+    const BlockNo *blocks = file_blocks(file);
+    for (size_t i = 0; i < file->num_blocks; i++) {
+        if (blocks[i] != NO_BLOCK && !ensure_block_intact(blocks[i])) {
+            out_printf("Error: El bloque %zu de '%s' esta danado.\n", (size_t)blocks[i], filename);
+            return -1;
+        }
+    }
+    
+    /* Reservar el rango virtual completo y rellenarlo página a página */
+    unsigned char *base = mmap(NULL, pages * store.page_size, PROT_NONE,
+                               MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (base == MAP_FAILED) {
+        out_printf("Error: No se pudo reservar la vista.\n");
+        return -1;
+    }
+    view->addr = base;
+    view->length = file->size;
+    view->map_len = pages * store.page_size;
+    
+    if (file->packed_len > 0) {
+        /* Archivo comprimido: la vista es una copia privada descomprimida */
+        if (mmap(base, view->map_len, PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0) == MAP_FAILED ||
+            file_load(file, base, file_logical_blocks(file)) != 0) {
+            unmap_file_view(view);
+            out_printf("Error: No se pudo mapear la vista de '%s'.\n", filename);
+            return -1;
+        }
+        mprotect(base, view->map_len, PROT_READ);
+        view->copied_pages = pages;
+        return 0;
+    }
+    
+    for (size_t pg = 0; pg < pages; ) {
+        size_t first = pg * per_page;
+        size_t phys = blocks[first];
+        
+        /* Extender mientras las páginas sigan siendo consecutivas en el memfd */
+        size_t run = 0;
+        while (pg + run < pages && phys != NO_BLOCK && phys % per_page == 0) {
+            size_t f = (pg + run) * per_page;
+            bool whole = true;
+            for (size_t j = 0; j < per_page && whole; j++) {
+                /* Tras el final del archivo la página física se acepta tal cual */
+                whole = f + j >= file->num_blocks ||
+                        blocks[f + j] == phys + run * per_page + j;
+            }
+            if (!whole) {
+                break;
+            }
+            run++;
+        }
+        
+        if (run > 0) {
+            if (mmap(base + pg * store.page_size, run * store.page_size, PROT_READ,
+                     MAP_SHARED | MAP_FIXED, store.fd, (off_t)(phys * BLOCK_SIZE)) == MAP_FAILED) {
+                break;
+            }
+            view->shared_pages += run;
+            pg += run;
+            continue;
+        }
+        
+        /* Página fragmentada: copia privada de sus bloques */
+        unsigned char *page = base + pg * store.page_size;
+        if (mmap(page, store.page_size, PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0) == MAP_FAILED) {
+            break;
+        }
+        for (size_t j = 0; j < per_page && first + j < file->num_blocks; j++) {
+            if (blocks[first + j] != NO_BLOCK) {
+                memcpy(page + j * BLOCK_SIZE, fs.blocks[blocks[first + j]], BLOCK_SIZE);
+            }
+        }
+        mprotect(page, store.page_size, PROT_READ);
+        view->copied_pages++;
+        pg++;
+    }
+    
+    if (view->shared_pages + view->copied_pages < pages) {
+        munmap(base, view->map_len);
+        memset(view, 0, sizeof(*view));
+        out_printf("Error: No se pudo mapear la vista de '%s'.\n", filename);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Libera una vista creada con map_file_view
+ * @param view Vista a liberar
+ */
+void unmap_file_view(FileView *view) {
+    if (view->addr != NULL) {
+        munmap(view->addr, view->map_len);
+    }
+    memset(view, 0, sizeof(*view));
+}
+
+/**
+ * Comando MAPVIEW: crea la vista, muestra cómo quedó mapeada y su
+ * contenido inicial, y la libera
+ * @param filename Nombre del archivo
+ */
+void mapview_command(const char *filename) {
+    FileView view;
+    if (map_file_view(filename, &view) != 0) {
+        return;
+    }
+    
+    uint32_t sum = 0;
+    for (size_t i = 0; i < view.length; i++) {
+        sum = sum * 31u + view.addr[i];
+    }
+    size_t shown = strnlen((const char *)view.addr, view.length < 64 ? view.length : 64);
+    out_printf("Vista de '%s' en %p: %zu bytes, %zu paginas sin copia, %zu copiadas.\n",
+               filename, (void *)view.addr, view.length, view.shared_pages, view.copied_pages);
+    out_printf("  Hash: %08x  Inicio: \"%.*s\"\n", sum, (int)shown, (const char *)view.addr);
+    unmap_file_view(&view);
+}
+
+/**
+ * Cuenta las páginas del almacén residentes en memoria (según mincore)
+ * @param resident Páginas residentes
+ * @return 0 si es exitoso, -1 si no hay memoria para consultarlo
+ */
+static int store_resident_pages(size_t *resident) {
+    size_t pages = (BLOCK_STORE_SIZE + store.page_size - 1) / store.page_size;
+    unsigned char *vec = malloc(pages);
+    if (vec == NULL) {
+        return -1;
+    }
+    
+    *resident = 0;
+    if (mincore(fs.blocks, BLOCK_STORE_SIZE, vec) == 0) {
+        for (size_t i = 0; i < pages; i++) {
+            *resident += vec[i] & 1;
+        }
+    }
+    free(vec);
+    return 0;
+}
+
+/**
+ * Comando MEMSTAT: páginas del almacén residentes en memoria (según
+ * mincore) frente a los bloques en uso, y páginas devueltas al sistema
+ */
+void memory_status(void) {
+    size_t pages = (BLOCK_STORE_SIZE + store.page_size - 1) / store.page_size;
+    size_t resident;
+    if (store_resident_pages(&resident) != 0) {
+        out_printf("Error: No hay memoria para consultar el almacen.\n");
+        return;
+    }
+    
+    out_printf("Almacen %s: %zu de %zu paginas residentes (%zu KB), %zu KB en bloques usados.\n",
+               store.kind == STORE_MEMFD ? "memfd" : store.kind == STORE_OVERLAY ? "superpuesto" : "anonimo",
+               resident, pages, resident * store.page_size / 1024, fs.used_blocks * BLOCK_SIZE / 1024);
+    if (store.kind == STORE_OVERLAY) {
+        out_printf("  Capa superior: %zu de %zu paginas copiadas de la base (%zu KB privados).\n",
+                   overlay.copied_pages, pages, overlay.copied_pages * store.page_size / 1024);
+    }
+    out_printf("  Devueltas al sistema: %llu paginas en %llu llamadas, %zu pendientes.\n",
+               (unsigned long long)reclaim.released_pages,
+               (unsigned long long)reclaim.release_calls, reclaim.pending_pages);
+    size_t slab_bytes = 0;
+    for (int cls = 0; cls < SLAB_CLASSES; cls++) {
+        pthread_mutex_lock(&slab_classes[cls].lock);
+        slab_bytes += slab_classes[cls].chunk_bytes;
+        pthread_mutex_unlock(&slab_classes[cls].lock);
+    }
+    out_printf("  Slabs de registros del journal y del servidor: %zu KB.\n", slab_bytes / 1024);
+    out_printf("  Entrada de archivo: %zu bytes; cache de extents: %llu aciertos, %llu fallos.\n",
+               sizeof(FileEntry), (unsigned long long)extent_cache.hits,
+               (unsigned long long)extent_cache.misses);
+    out_printf("  Capacidad logica: %zu KB, espacio fisico: %zu KB (%zu%% en uso, %llu avisos).\n",
+               fs.capacity_blocks * BLOCK_SIZE / 1024, thin.physical_blocks * BLOCK_SIZE / 1024,
+               fs.used_blocks * 100 / thin.physical_blocks, (unsigned long long)thin.alerts);
+    if (fs.dict_len > 0) {
+        size_t packed = 0, in_entry = 0, held = 0, logical = 0;
+        for (size_t i = 0; i < MAX_FILES; i++) {
+            const FileEntry *file = &fs.file_table[i];
+            if (file_live(file) && file->packed_len > 0 && !file->cold) {
+                packed++;
+                in_entry += file->num_blocks == 0;
+                held += file->num_blocks;
+                logical += file_logical_blocks(file);
+            }
+        }
+        out_printf("  Diccionario: %u bytes; %zu archivo(s) comprimidos (%zu en su entrada), %zu bloques en lugar de %zu.\n",
+                   fs.dict_len, packed, in_entry, held, logical);
+    }
+    size_t cold_files = 0, cold_held = 0, cold_logical = 0;
+    for (size_t i = 0; i < MAX_FILES; i++) {
+        const FileEntry *file = &fs.file_table[i];
+        if (file_live(file) && file->cold) {
+            cold_files++;
+            cold_held += file->num_blocks;
+            cold_logical += file_logical_blocks(file);
+        }
+    }
+    if (cold.active || cold_files > 0) {
+        out_printf("  Nivel frio: %zu archivo(s) comprimidos, %zu bloques en lugar de %zu; "
+                   "%llu pasadas, %llu comprimidos (%llu bloques liberados) y %llu descomprimidos "
+                   "tras leerlos.\n",
+                   cold_files, cold_held, cold_logical, (unsigned long long)cold.passes,
+                   (unsigned long long)cold.packed, (unsigned long long)cold.blocks_saved,
+                   (unsigned long long)cold.promoted);
+    }
+    if (exports.zero_copy + exports.copied > 0) {
+        out_printf("  EXPORT: %llu sin copias, %llu copiados (%llu KB); %llu paginas prestadas sustituidas.\n",
+                   (unsigned long long)exports.zero_copy, (unsigned long long)exports.copied,
+                   (unsigned long long)(exports.bytes / 1024), (unsigned long long)exports.pages_replaced);
+    }
+    if (server.num_loops > 0) {
+        out_printf("  Servidor: %zu bucle(s), %llu comandos en %llu lotes (%.1f por lote).\n",
+                   server.num_loops, (unsigned long long)server.requests, (unsigned long long)server.batches,
+                   server.batches > 0 ? (double)server.requests / server.batches : 0.0);
+        out_printf("  Servidor: %llu READ atendidos con una respuesta compartida (%llu KB sin generar).\n",
+                   (unsigned long long)server.reads_shared,
+                   (unsigned long long)(server.bytes_shared / 1024));
+    }
+}
+
+/**
+ * Desactiva las páginas enormes transparentes sobre fs y sobre el almacén
+ * anónimo. Tras fork, cada escritura del padre copia la página entera:
+ * 4 KB con páginas base, pero 2 MB si el kernel hubiera usado una página
+ * enorme.
+ */
+static void bgsave_prepare_memory(void) {
+#ifdef MADV_NOHUGEPAGE
+    madvise(&fs, (sizeof(fs) + PAGE_SIZE_BYTES - 1) / PAGE_SIZE_BYTES * PAGE_SIZE_BYTES,
+            MADV_NOHUGEPAGE);
+    if (store.kind == STORE_ANON) {
+        madvise(fs.blocks, BLOCK_STORE_SIZE, MADV_NOHUGEPAGE);
+    }
+#endif
+}
+
+/**
+ * Inicia un guardado en segundo plano: el hijo de fork escribe una
+ * imagen consistente de fs mientras el padre sigue atendiendo comandos,
+ * apoyándose en la copia en escritura del kernel
+ * @param path Ruta de la imagen destino
+ * @return 0 si es exitoso, -1 en caso de error
+ */
+int bgsave_start(const char *path) {
+    if (bgsave.pid != 0) {
+        out_printf("Error: Ya hay un BGSAVE en curso (pid %ld).\n", (long)bgsave.pid);
+        return -1;
+    }
+    
+    /* Las rutas se preparan antes de fork: el hijo no reserva memoria */
+    char tmp[MAX_FILENAME + 8];
+    snprintf(bgsave.path, sizeof(bgsave.path), "%s", path);
+    snprintf(tmp, sizeof(tmp), "%s.tmp", bgsave.path);
+    fflush(stdout);
+    
+    long long t0 = now_ns();
+    
+    /*
+     * Las páginas MAP_SHARED de un memfd no se copian en escritura tras
+     * fork: el hijo vería las escrituras posteriores del padre. En ese caso
+     * se guarda una copia privada de los bloques, que sí queda congelada.
+     */
+    const void *data = fs.blocks;
+    void *copy = NULL;
+    if (store.kind == STORE_MEMFD) {
+        copy = mmap(NULL, BLOCK_STORE_SIZE, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (copy == MAP_FAILED) {
+            out_printf("Error: Sin memoria para la copia de BGSAVE.\n");
+            return -1;
+        }
+        memcpy(copy, fs.blocks, fs.capacity_blocks * BLOCK_SIZE);
+        data = copy;
+    }
+    
+    pid_t pid = fork();
+    if (pid < 0) {
+        if (copy != NULL) {
+            munmap(copy, BLOCK_STORE_SIZE);
+        }
+        out_printf("Error: No se pudo crear el proceso de guardado.\n");
+        return -1;
+    }
+    
+    if (pid == 0) {
+        /* Hijo: solo llamadas seguras tras fork en un proceso con hilos */
+        int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) {
+            _exit(1);
+        }
+        if (write_image(fd, data) != 0 || fsync(fd) != 0) {
+            close(fd);
+            unlink(tmp);
+            _exit(1);
+        }
+        close(fd);
+        _exit(rename(tmp, bgsave.path) == 0 ? 0 : 1);
+    }
+    
+    if (copy != NULL) {
+        munmap(copy, BLOCK_STORE_SIZE);  /* El hijo conserva su propia copia */
+    }
+    bgsave.pid = pid;
+    bgsave.started_ns = t0;
+    bgsave.fork_ns = now_ns() - t0;
+    out_printf("BGSAVE iniciado hacia '%s' (pid %ld, fork en %.3f ms).\n",
+               bgsave.path, (long)pid, (double)bgsave.fork_ns / 1e6);
+    return 0;
+}
+
+/**
+ * Recoge el proceso de guardado si ha terminado e informa del resultado
+ * @param wait_child true para esperar a que termine
+ */
+void bgsave_poll(bool wait_child) {
+    if (bgsave.pid == 0) {
+        return;
+    }
+    int status;
+    pid_t done = waitpid(bgsave.pid, &status, wait_child ? 0 : WNOHANG);
+    if (done != bgsave.pid) {
+        return;
+    }
+    
+    double ms = (double)(now_ns() - bgsave.started_ns) / 1e6;
+    if (WIFEXITED(status) && WEXITSTATUS(status) == 0) {
+        out_printf("BGSAVE completado: '%s' (%.3f ms).\n", bgsave.path, ms);
+    } else {
+        out_printf("Error: BGSAVE hacia '%s' fallo.\n", bgsave.path);
+    }
+    bgsave.pid = 0;
+}
+
+/* Parámetros de la traza de churn usada por --bench */
+#define BENCH_OPS 200000                  /* Operaciones de la traza */
+#define BENCH_SLOTS 512                   /* Archivos vivos máximos en la traza */
+#define BENCH_MAX_FILE_BLOCKS 64          /* Tamaño máximo de un archivo de la traza */
+#define BENCH_GROUPS 16                   /* Grupos de archivos relacionados (pista de localidad) */
+#define BENCH_SAMPLE_EVERY 1000           /* Cada cuántas operaciones se mide el mayor tramo libre */
+#define BENCH_SEED 12345u                 /* Semilla fija: misma traza para cada política */
+#define BENCH_SERVER_CLIENTS 32           /* Clientes simultáneos en la prueba del servidor */
+#define BENCH_SERVER_OPS 2000             /* Comandos por cliente */
+#define BENCH_SERVER_DEPTH 8              /* Comandos en vuelo por cliente */
+#define BENCH_DICT_FILES 64               /* Archivos JSON pequeños en la prueba del diccionario */
+#define BENCH_DICT_ROUNDS 50              /* Lecturas completas de cada archivo por medición */
+#define BENCH_COLD_FILES 24               /* Archivos de registro en la prueba del nivel frío */
+#define BENCH_COLD_MAX (32 * 1024)        /* Tamaño máximo de cada uno */
+#define BENCH_COLD_READ 4096              /* Bytes de cada READ medido */
+
+/* Operación de la traza: crear o eliminar el archivo de un slot */
+typedef struct {
+    bool create;                          /* true = crear, false = eliminar */
+    unsigned short slot;                  /* Slot del archivo */
+    unsigned short num_blocks;            /* Bloques a crear */
+} BenchOp;
+
+/* Traza generada una sola vez y reproducida con cada política */
+static BenchOp bench_trace[BENCH_OPS];
+
+/* Estado de la reproducción: bloques de cada archivo vivo */
+static BlockNo bench_blocks[BENCH_SLOTS][BENCH_MAX_FILE_BLOCKS];
+static size_t bench_count[BENCH_SLOTS];
+static size_t bench_group_tail[BENCH_GROUPS];
+
+/* Contenido de los archivos de la prueba del diccionario */
+static char bench_json[BENCH_DICT_FILES][DICT_MAX_FILE + 1];
+
+/* Contenido de un archivo y principio de cada uno en la prueba del nivel frío */
+static char bench_log[BENCH_COLD_MAX + 1];
+static char bench_log_head[BENCH_COLD_FILES][BENCH_COLD_READ + 1];
+
+/**
+ * Generador pseudoaleatorio determinista (LCG) para reproducir la traza
+ * @param state Estado del generador
+ * @return Siguiente valor de 31 bits
+ */
+static unsigned int bench_rand(unsigned int *state) {
+    *state = *state * 1103515245u + 12345u;
+    return (*state >> 1) & 0x7fffffffu;
+}
+
+/**
+ * Genera la traza: tres cuartas partes de churn con ocupación media y un
+ * último cuarto dominado por creaciones que lleva el volumen al límite
+ */
+static void bench_generate(void) {
+    unsigned int seed = BENCH_SEED;
+    bool live[BENCH_SLOTS] = { false };
+    
+    for (size_t op = 0; op < BENCH_OPS; ) {
+        bool high_fill = op >= BENCH_OPS * 3 / 4;
+        unsigned int create_pct = high_fill ? 100 : 40;
+        unsigned int delete_pct = high_fill ? 20 : 100;
+        size_t slot = bench_rand(&seed) % BENCH_SLOTS;
+        unsigned int r = bench_rand(&seed) % 100;
+        
+        if (!live[slot] && r < create_pct) {
+            /* Mayoría de archivos pequeños y algunos grandes */
+            size_t n = (bench_rand(&seed) % 10 == 0)
+                     ? 1 + bench_rand(&seed) % BENCH_MAX_FILE_BLOCKS
+                     : 1 + bench_rand(&seed) % 8;
+            bench_trace[op].create = true;
+            bench_trace[op].slot = (unsigned short)slot;
+            bench_trace[op].num_blocks = (unsigned short)n;
+            live[slot] = true;
+            op++;
+        } else if (live[slot] && r < delete_pct) {
+            bench_trace[op].create = false;
+            bench_trace[op].slot = (unsigned short)slot;
+            bench_trace[op].num_blocks = 0;
+            live[slot] = false;
+            op++;
+        }
+    }
+}
+
+/**
+ * Calcula el tramo libre más largo del mapa de bloques
+ * @return Longitud en bloques del mayor tramo libre
+ */
+static size_t largest_free_run(void) {
+    size_t best = 0;
+    size_t run = 0;
+    for (size_t i = 0; i < MAX_BLOCKS; i++) {
+        run = block_taken(i) ? 0 : run + 1;
+        if (run > best) {
+            best = run;
+        }
+    }
+    return best;
+}
+
+/**
+ * Reproduce la traza con una política y muestra sus métricas
+ * @param policy Política a evaluar
+ */
+static void bench_policy(AllocPolicy policy) {
+    size_t allocs = 0, placed = 0, extents = 0;
+    size_t creates[2] = { 0, 0 }, failures[2] = { 0, 0 };
+    size_t samples = 0, run_sum = 0, run_min = MAX_BLOCKS;
+    long long alloc_ns = 0;
+    
+    reset_filesystem(policy);
+    memset(bench_count, 0, sizeof(bench_count));
+    for (size_t g = 0; g < BENCH_GROUPS; g++) {
+        bench_group_tail[g] = NO_BLOCK;
+    }
+    
+    for (size_t op = 0; op < BENCH_OPS; op++) {
+        const BenchOp *o = &bench_trace[op];
+        size_t phase = op >= BENCH_OPS * 3 / 4;
+        
+        if (o->create) {
+            /* Pista: justo detrás del último archivo de su grupo */
+            size_t group = o->slot % BENCH_GROUPS;
+            long long t0 = now_ns();
+            size_t got = allocate_blocks_near(o->num_blocks, bench_blocks[o->slot],
+                                              bench_group_tail[group]);
+            alloc_ns += now_ns() - t0;
+            allocs++;
+            creates[phase]++;
+            if (got < o->num_blocks) {
+                failures[phase]++;
+                free_blocks(got, bench_blocks[o->slot]);
+            } else {
+                bench_count[o->slot] = got;
+                extents += count_extents(got, bench_blocks[o->slot]);
+                placed++;
+                bench_group_tail[group] = (bench_blocks[o->slot][got - 1] + 1) % MAX_BLOCKS;
+            }
+        } else if (bench_count[o->slot] > 0) {
+            free_blocks(bench_count[o->slot], bench_blocks[o->slot]);
+            bench_count[o->slot] = 0;
+        }
+        
+        if (op % BENCH_SAMPLE_EVERY == 0) {
+            size_t run = largest_free_run();
+            run_sum += run;
+            run_min = run < run_min ? run : run_min;
+            samples++;
+        }
+    }
+    
+    out_printf("%-10s %9.0f %8.2f %10.0f %9zu %9.2f%% %9.2f%%\n",
+               alloc_policies[policy].name,
+               allocs ? (double)alloc_ns / (double)allocs : 0.0,
+               placed ? (double)extents / (double)placed : 0.0,
+               samples ? (double)run_sum / (double)samples : 0.0,
+               run_min,
+               creates[0] ? 100.0 * (double)failures[0] / (double)creates[0] : 0.0,
+               creates[1] ? 100.0 * (double)failures[1] / (double)creates[1] : 0.0);
+}
+
+/**
+ * Mide la amplificación de escritura de la paridad y el rendimiento de
+ * reconstrucción de bloques dañados
+ * @param level Nivel de paridad (1 = P, 2 = P + Q)
+ */
+static void bench_parity(int level) {
+    unsigned int seed = BENCH_SEED;
+    unsigned char data[BLOCK_SIZE];
+    int saved_level = parity.level;
+    
+    parity.level = level;
+    reset_filesystem(ALLOC_FIRST_FIT);
+    parity.data_bytes = 0;
+    parity.parity_bytes = 0;
+    parity.rebuilt_blocks = 0;
+    
+    /* Escrituras aleatorias dentro de un bloque sobre todo el volumen */
+    long long t0 = now_ns();
+    for (size_t op = 0; op < BENCH_OPS / 4; op++) {
+        size_t block = bench_rand(&seed) % MAX_BLOCKS;
+        size_t pos = bench_rand(&seed) % BLOCK_SIZE;
+        size_t len = 1 + bench_rand(&seed) % (BLOCK_SIZE - pos);
+        memset(data, (int)(op & 0xFF), len);
+        store_bytes(block, pos, data, len);
+    }
+    long long write_ns = now_ns() - t0;
+    
+    /* Dañar bloques aleatorios y reconstruirlos */
+    size_t rebuilds = BENCH_OPS / 40;
+    long long rebuild_ns = 0;
+    for (size_t op = 0; op < rebuilds; op++) {
+        size_t block = bench_rand(&seed) % MAX_BLOCKS;
+        fs.blocks[block][bench_rand(&seed) % BLOCK_SIZE] ^= 0xFF;
+        t0 = now_ns();
+        ensure_block_intact(block);
+        rebuild_ns += now_ns() - t0;
+    }
+    
+    out_printf("%-10s %14.2f %12.0f %14.1f %9zu\n",
+               level == 1 ? "P" : "P + Q",
+               (double)(parity.data_bytes + parity.parity_bytes) / (double)parity.data_bytes,
+               (double)write_ns / (double)(BENCH_OPS / 4),
+               rebuild_ns ? (double)(rebuilds * BLOCK_SIZE) / ((double)rebuild_ns / 1e9) / (1024.0 * 1024.0)
+                      : 0.0,
+               parity.rebuilt_blocks);
+    
+    parity.level = saved_level;
+}
+
+/**
+ * Mide el coste de reservar y liberar las copias de los registros con un
+ * asignador dado. Cada ronda imita el journal de un CREATE o DELETE
+ * (bloques, tramo del mapa, entrada y contadores) y las copias se
+ * liberan por lotes, como hace el hilo del espejo.
+ * @param name Nombre a mostrar
+ * @param alloc_fn Función de reserva
+ * @param free_fn Función de liberación (recibe el tamaño)
+ */
+static void bench_records(const char *name, void *(*alloc_fn)(size_t),
+                          void (*free_fn)(void *, size_t)) {
+    static void *ptrs[MIRROR_BATCH];
+    static size_t lens[MIRROR_BATCH];
+    unsigned int seed = BENCH_SEED;
+    size_t pending = 0, ops = 0;
+    
+    long long t0 = now_ns();
+    for (size_t round = 0; round < BENCH_OPS / 4; round++) {
+        size_t blocks = 1 + bench_rand(&seed) % BENCH_MAX_FILE_BLOCKS;
+        size_t record_lens[4] = { BLOCK_SIZE, 1 + blocks / 8, sizeof(FileEntry),
+                                  sizeof(FileSystem) - offsetof(FileSystem, num_files) };
+        size_t count[4] = { blocks < 8 ? blocks : 8, 1, 1, 1 };
+        for (size_t kind = 0; kind < 4; kind++) {
+            for (size_t i = 0; i < count[kind]; i++) {
+                if (pending == MIRROR_BATCH) {
+                    while (pending > 0) {
+                        pending--;
+                        free_fn(ptrs[pending], lens[pending]);
+                    }
+                }
+                lens[pending] = record_lens[kind];
+                ptrs[pending] = alloc_fn(record_lens[kind]);
+                *(volatile unsigned char *)ptrs[pending] = 1;
+                pending++;
+                ops++;
+            }
+        }
+    }
+    while (pending > 0) {
+        pending--;
+        free_fn(ptrs[pending], lens[pending]);
+    }
+    long long total_ns = now_ns() - t0;
+    
+    out_printf("%-10s %12zu %14.1f\n", name, ops, (double)total_ns / (double)ops);
+}
+
+/**
+ * free con la misma firma que slab_free, para comparar
+ * @param ptr Memoria a liberar
+ * @param len Tamaño (no se usa)
+ */
+static void bench_plain_free(void *ptr, size_t len) {
+    (void)len;
+    free(ptr);
+}
+
+/**
+ * Lee BENCH_DICT_ROUNDS veces cada archivo de la prueba del diccionario
+ * @param failed Se suman las lecturas que no devuelven el contenido escrito
+ * @return Nanosegundos medios por READ
+ */
+static double bench_dict_reads(size_t *failed) {
+    char name[32];
+    char buffer[DICT_MAX_FILE + 1];
+    long long t0 = now_ns();
+    for (size_t round = 0; round < BENCH_DICT_ROUNDS; round++) {
+        for (size_t i = 0; i < BENCH_DICT_FILES; i++) {
+            snprintf(name, sizeof(name), "json/%02zu.json", i);
+            size_t len = strlen(bench_json[i]);
+            if (read_file(name, 0, len, buffer) != 0 || memcmp(buffer, bench_json[i], len) != 0) {
+                (*failed)++;
+            }
+        }
+    }
+    return (double)(now_ns() - t0) / (BENCH_DICT_ROUNDS * BENCH_DICT_FILES);
+}
+
+/**
+ * Mide el espacio y la latencia de READ de archivos JSON de menos de
+ * 4 KB sin comprimir y comprimidos con un diccionario entrenado con ellos
+ */
+static void bench_dict(void) {
+    static const char *const roles[] = { "admin", "editor", "viewer", "guest" };
+    unsigned int seed = BENCH_SEED;
+    char name[32], record[192];
+    size_t bytes = 0, failed_plain = 0, failed_packed = 0;
+    
+    reset_filesystem(ALLOC_FIRST_FIT);
+    fs.dict_len = 0;
+    thread_out = fopen("/dev/null", "w");
+    if (thread_out == NULL) {
+        return;
+    }
+    
+    for (size_t i = 0; i < BENCH_DICT_FILES; i++) {
+        size_t size = 200 + bench_rand(&seed) % (DICT_MAX_FILE - 200);
+        for (size_t len = 0; len < size; ) {
+            unsigned int id = bench_rand(&seed) % 100000;
+            int n = snprintf(record, sizeof(record),
+                             "{\"id\":%u,\"user\":\"user%u\",\"email\":\"user%u@example.com\","
+                             "\"active\":%s,\"role\":\"%s\",\"score\":%u},",
+                             id, id, id, bench_rand(&seed) % 2 ? "true" : "false",
+                             roles[bench_rand(&seed) % 4], bench_rand(&seed) % 1000);
+            size_t chunk = (size_t)n < size - len ? (size_t)n : size - len;
+            memcpy(&bench_json[i][len], record, chunk);
+            len += chunk;
+        }
+        bench_json[i][size] = '\0';
+        snprintf(name, sizeof(name), "json/%02zu.json", i);
+        create_file(name, size);
+        write_file(name, 0, bench_json[i]);
+        bytes += size;
+    }
+    size_t plain_blocks = fs.used_blocks;
+    double plain_ns = bench_dict_reads(&failed_plain);
+    
+    long long t0 = now_ns();
+    train_dictionary("*");
+    double train_ms = (double)(now_ns() - t0) / 1e6;
+    size_t packed_blocks = fs.used_blocks, packed_bytes = 0, in_entry = 0;
+    for (size_t i = 0; i < MAX_FILES; i++) {
+        const FileEntry *file = &fs.file_table[i];
+        if (file_live(file) && file->packed_len > 0) {
+            packed_bytes += file->packed_len;
+            in_entry += file->num_blocks == 0;
+        }
+    }
+    double packed_ns = bench_dict_reads(&failed_packed);
+    
+    fclose(thread_out);
+    thread_out = NULL;
+    out_printf("\nDiccionario: %d archivos JSON de 200 B a 4 KB (%zu KB), diccionario de %u bytes (%.1f ms)\n\n",
+               BENCH_DICT_FILES, bytes / 1024, fs.dict_len, train_ms);
+    out_printf("%-14s %9s %12s %10s %8s\n", "Archivos", "bloques", "KB en datos", "READ ns", "fallos");
+    out_printf("%-14s %9zu %12zu %10.0f %8zu\n", "sin comprimir", plain_blocks, bytes / 1024, plain_ns, failed_plain);
+    out_printf("%-14s %9zu %12zu %10.0f %8zu\n", "diccionario", packed_blocks, packed_bytes / 1024, packed_ns,
+               failed_packed);
+    out_printf("(%zu de %d archivos comprimidos caben en su entrada)\n", in_entry, BENCH_DICT_FILES);
+    
+    reset_filesystem(ALLOC_FIRST_FIT);
+    fs.dict_len = 0;
+}
+
+/**
+ * Páginas del almacén con algún bloque en uso: la memoria que ocupa el
+ * volumen una vez devueltas las páginas libres
+ * @return Número de páginas
+ */
+static size_t bench_used_pages(void) {
+    size_t per_page = store.page_size / BLOCK_SIZE;
+    size_t pages = 0;
+    for (size_t first = 0; first < MAX_BLOCKS; first += per_page) {
+        bool used = false;
+        for (size_t j = 0; j < per_page && !used; j++) {
+            used = fs.block_map[first + j] == fs.format_gen;
+        }
+        pages += used;
+    }
+    return pages;
+}
+
+/**
+ * Lee los primeros BENCH_COLD_READ bytes de cada archivo de la prueba del
+ * nivel frío
+ * @param failed Se suman las lecturas que no devuelven el contenido escrito
+ * @return Nanosegundos medios por READ
+ */
+static double bench_cold_reads(size_t *failed) {
+    char name[32];
+    char buffer[BENCH_COLD_READ + 1];
+    long long t0 = now_ns();
+    for (size_t i = 0; i < BENCH_COLD_FILES; i++) {
+        snprintf(name, sizeof(name), "logs/%02zu.log", i);
+        if (read_file(name, 0, BENCH_COLD_READ, buffer) != 0 ||
+            memcmp(buffer, bench_log_head[i], BENCH_COLD_READ) != 0) {
+            (*failed)++;
+        }
+    }
+    return (double)(now_ns() - t0) / BENCH_COLD_FILES;
+}
+
+/**
+ * Mide la memoria que ocupan archivos de registro de 8 a 32 KB sin usar
+ * antes y después de una pasada del nivel frío, y la latencia de READ
+ * caliente frente a la de READ en frío, que decodifica solo las tramas
+ * que lee
+ */
+static void bench_cold(void) {
+    static const char *const paths[] = { "items", "users", "orders", "search" };
+    unsigned int seed = BENCH_SEED;
+    char name[32], line[160];
+    size_t bytes = 0, failed_hot = 0, failed_cold = 0;
+    double hot_ns = 0;
+    
+    reset_filesystem(ALLOC_FIRST_FIT);
+    fs.dict_len = 0;
+    thread_out = fopen("/dev/null", "w");
+    if (thread_out == NULL) {
+        return;
+    }
+    
+    for (size_t i = 0; i < BENCH_COLD_FILES; i++) {
+        size_t size = 8 * 1024 + bench_rand(&seed) % (BENCH_COLD_MAX - 8 * 1024);
+        for (size_t len = 0; len < size; ) {
+            unsigned int t = bench_rand(&seed) % 86400;
+            int n = snprintf(line, sizeof(line),
+                             "2026-10-18T%02u:%02u:%02u INFO req=%u user=user%u path=/api/v1/%s/%u status=%u ms=%u\n",
+                             t / 3600, t / 60 % 60, t % 60, bench_rand(&seed) % 1000000,
+                             bench_rand(&seed) % 5000, paths[bench_rand(&seed) % 4],
+                             bench_rand(&seed) % 10000, bench_rand(&seed) % 8 ? 200 : 404,
+                             bench_rand(&seed) % 300);
+            size_t chunk = (size_t)n < size - len ? (size_t)n : size - len;
+            memcpy(&bench_log[len], line, chunk);
+            len += chunk;
+        }
+        bench_log[size] = '\0';
+        memcpy(bench_log_head[i], bench_log, BENCH_COLD_READ);
+        snprintf(name, sizeof(name), "logs/%02zu.log", i);
+        create_file(name, size);
+        write_file(name, 0, bench_log);
+        bytes += size;
+    }
+    size_t hot_blocks = fs.used_blocks, hot_pages = bench_used_pages();
+    for (size_t round = 0; round < BENCH_DICT_ROUNDS; round++) {
+        hot_ns += bench_cold_reads(&failed_hot) / BENCH_DICT_ROUNDS;
+    }
+    
+    /* Todos los archivos llevan sin usarse más que el umbral */
+    cold.age_ns = 1;
+    for (size_t i = 0; i < MAX_FILES; i++) {
+        cold.last_access[i] = 1;
+        cold.tried[i] = 0;
+    }
+    long long t0 = now_ns();
+    size_t packed = cold_pass();
+    double pass_ms = (double)(now_ns() - t0) / 1e6;
+    size_t cold_blocks = fs.used_blocks, cold_pages = bench_used_pages();
+    double first_ns = bench_cold_reads(&failed_cold);
+    
+    fclose(thread_out);
+    thread_out = NULL;
+    out_printf("\nNivel frio: %d archivos de registro de 8 a 32 KB (%zu KB), %zu comprimidos en %.1f ms\n\n",
+               BENCH_COLD_FILES, bytes / 1024, packed, pass_ms);
+    out_printf("%-14s %9s %13s %14s %8s\n", "Archivos", "bloques", "KB en memoria", "READ 4 KB ns", "fallos");
+    out_printf("%-14s %9zu %13zu %14.0f %8zu\n", "calientes", hot_blocks,
+               hot_pages * store.page_size / 1024, hot_ns, failed_hot);
+    out_printf("%-14s %9zu %13zu %14.0f %8zu\n", "frios", cold_blocks,
+               cold_pages * store.page_size / 1024, first_ns, failed_cold);
+    out_printf("(READ en frio decodifica las tramas que lee; la pasada siguiente devuelve el archivo a bloques)\n");
+    out_printf("Capacidad efectiva: %.2f KB de datos por KB de memoria en frio, %.2f en caliente\n",
+               (double)bytes / (double)(cold_pages * store.page_size),
+               (double)bytes / (double)(hot_pages * store.page_size));
+    
+    reset_filesystem(ALLOC_FIRST_FIT);
+    cold.age_ns = 0;
+    cold.passes = cold.packed = cold.promoted = cold.blocks_saved = 0;
+}
+
+/**
+ * Compara las políticas de asignación reproduciendo la misma traza de
+ * creaciones y eliminaciones con cada una, y mide el coste de la paridad
+ * y de las copias de los registros del journal
+ */
+void run_benchmark(void) {
+    bench_generate();
+    
+    out_printf("Traza: %d operaciones (ultimo cuarto a alta ocupacion), %d slots, %d bloques\n\n",
+               BENCH_OPS, BENCH_SLOTS, MAX_BLOCKS);
+    out_printf("%-10s %9s %8s %10s %9s %10s %10s\n",
+               "Politica", "alloc ns", "ext/arch", "libre medio", "libre min",
+               "fallos", "fallos alta");
+    for (int i = 0; i < ALLOC_NUM_POLICIES; i++) {
+        bench_policy((AllocPolicy)i);
+    }
+    
+    out_printf("\nParidad: %d escrituras aleatorias, %d reconstrucciones\n\n",
+               BENCH_OPS / 4, BENCH_OPS / 40);
+    out_printf("%-10s %14s %12s %14s %9s\n",
+               "Paridad", "amplificacion", "write ns", "rebuild MB/s", "rebuilds");
+    bench_parity(1);
+    bench_parity(2);
+    
+    out_printf("\nCopias de registros del journal (alloc + free por lotes de %d)\n\n", MIRROR_BATCH);
+    out_printf("%-10s %12s %14s\n", "Asignador", "registros", "ns/registro");
+    bench_records("malloc", malloc, bench_plain_free);
+    bench_records("slab", slab_alloc, slab_free);
+    
+    bench_dict();
+    bench_cold();
+    bench_server();
+}
+
+/**
+ * Analiza una línea de la consola. Es la etapa de análisis del servidor:
+ * no toca el sistema de archivos, así que puede ir en otro hilo.
+ * @param line Línea del comando, sin salto de línea
+ * @param cmd Comando analizado (CMD_UNKNOWN si no se reconoce)
+ */
+static void parse_command(const char *line, Command *cmd) {
+    cmd->op = CMD_UNKNOWN;
+    cmd->mutating = is_mutating_command(line);
+    cmd->filename[0] = '\0';
+    
+    if (sscanf(line, "CREATE %s %zu", cmd->filename, &cmd->size) == 2) {
+        cmd->op = CMD_CREATE;
+    } else if (sscanf(line, "WRITE %s %zu \"%[^\"]\"", cmd->filename, &cmd->offset, cmd->data) == 3) {
+        cmd->op = CMD_WRITE;
+    } else if (sscanf(line, "READ %s %zu %zu", cmd->filename, &cmd->offset, &cmd->size) == 3) {
+        cmd->op = CMD_READ;
+    } else if (sscanf(line, "FALLOCATE %s %zu %zu", cmd->filename, &cmd->offset, &cmd->size) == 3) {
+        cmd->op = CMD_FALLOCATE;
+    } else if (sscanf(line, "PUNCH %s %zu %zu", cmd->filename, &cmd->offset, &cmd->size) == 3) {
+        cmd->op = CMD_PUNCH;
+    }
+#ifdef FS_TEST_HOOKS
+    else if (sscanf(line, "CORRUPT %zu", &cmd->offset) == 1) {
+        cmd->op = CMD_CORRUPT;
+    } else if (sscanf(line, "COLDPASS %zu", &cmd->offset) == 1) {
+        cmd->op = CMD_COLDPASS;
+        cmd->mutating = true;
+    }
+#endif
+    /* DELETE-MATCH antes que DELETE, que también lo aceptaría */
+    else if (sscanf(line, "DELETE-MATCH %255s", cmd->filename) == 1) {
+        cmd->op = CMD_DELETE_MATCH;
+    } else if (sscanf(line, "DELETE %s", cmd->filename) == 1) {
+        cmd->op = CMD_DELETE;
+    } else if (sscanf(line, "MAPVIEW %s", cmd->filename) == 1) {
+        cmd->op = CMD_MAPVIEW;
+    } else if (sscanf(line, "GROW %zu", &cmd->size) == 1) {
+        cmd->op = CMD_GROW;
+    } else if (strcmp(line, "FORMAT") == 0) {
+        cmd->op = CMD_FORMAT;
+    } else if (strncmp(line, "WATCH ", 6) == 0) {
+        sscanf(line, "WATCH %255s", cmd->filename);
+        cmd->op = CMD_WATCH;
+    } else if (strcmp(line, "UNWATCH") == 0) {
+        cmd->op = CMD_UNWATCH;
+    } else if (strcmp(line, "MEMSTAT") == 0) {
+        cmd->op = CMD_MEMSTAT;
+    } else if (sscanf(line, "BGSAVE %s", cmd->filename) == 1) {
+        cmd->op = CMD_BGSAVE;
+    } else if (sscanf(line, "EXPORT %s", cmd->filename) == 1) {
+        cmd->op = CMD_EXPORT;
+    } else if (strcmp(line, "TRAINDICT") == 0 || strncmp(line, "TRAINDICT ", 10) == 0) {
+        if (sscanf(line, "TRAINDICT %255s", cmd->filename) != 1) {
+            strcpy(cmd->filename, "*");
+        }
+        cmd->op = CMD_TRAINDICT;
+    } else if (strcmp(line, "MIRROR") == 0) {
+        cmd->op = CMD_MIRROR;
+    } else if (strcmp(line, "REPLICA") == 0) {
+        cmd->op = CMD_REPLICA;
+    } else if (strcmp(line, "LIST") == 0) {
+        cmd->op = CMD_LIST;
+    } else if (strcmp(line, "EXIT") == 0 || strcmp(line, "QUIT") == 0) {
+        cmd->op = CMD_EXIT;
+    }
+}
+
+/**
+ * Ejecuta un comando ya analizado y envía sus cambios a los destinos de
+ * réplica. El llamador tiene fs_lock.
+ * @param cmd Comando
+ * @return false si el comando pide terminar la sesión (EXIT/QUIT)
+ */
+static bool run_command(const Command *cmd) {
+    char buffer[10240];  /* Buffer para lectura */
+    
+    if (repl.follower && cmd->mutating) {
+        out_printf("Error: Replica de solo lectura; envie los cambios al primario.\n");
+        return true;
+    }
+    
+    switch (cmd->op) {
+    case CMD_CREATE:
+        create_file(cmd->filename, cmd->size);
+        break;
+    case CMD_WRITE:
+        write_file(cmd->filename, cmd->offset, cmd->data);
+        break;
+    case CMD_READ:
+        if (read_file(cmd->filename, cmd->offset, cmd->size, buffer) == 0) {
+            out_printf("Salida: \"%s\"\n", buffer);
+        }
+        break;
+    case CMD_FALLOCATE:
+        fallocate_file(cmd->filename, cmd->offset, cmd->size);
+        break;
+    case CMD_PUNCH:
+        punch_hole(cmd->filename, cmd->offset, cmd->size);
+        break;
+#ifdef FS_TEST_HOOKS
+    case CMD_CORRUPT:
+        /* Pruebas de reconstrucción */
+        corrupt_block(cmd->offset);
+        break;
+    case CMD_COLDPASS:
+        /* Pruebas del nivel frío */
+        cold_test_pass(cmd->offset);
+        break;
+#endif
+    case CMD_DELETE_MATCH:
+        delete_matching(cmd->filename);
+        break;
+    case CMD_DELETE:
+        delete_file(cmd->filename);
+        break;
+    case CMD_MAPVIEW:
+        mapview_command(cmd->filename);
+        break;
+    case CMD_GROW:
+        grow_volume(cmd->size);
+        break;
+    case CMD_FORMAT:
+        format_volume();
+        break;
+    case CMD_WATCH:
+    case CMD_UNWATCH:
+        /* WATCH solo tiene sentido con clientes conectados */
+        out_printf("Error: WATCH requiere el modo servidor (--serve=<socket>).\n");
+        break;
+    case CMD_EXPORT:
+        out_printf("Error: EXPORT requiere el modo servidor (--serve=<socket>).\n");
+        break;
+    case CMD_MEMSTAT:
+        memory_status();
+        break;
+    case CMD_TRAINDICT:
+        train_dictionary(cmd->filename);
+        break;
+    case CMD_BGSAVE:
+        bgsave_start(cmd->filename);
+        break;
+    case CMD_MIRROR:
+        mirror_status();
+        break;
+    case CMD_REPLICA:
+        repl_status();
+        break;
+    case CMD_LIST:
+        list_files();
+        break;
+    case CMD_EXIT:
+        out_printf("Saliendo del sistema de archivos...\n");
+        return false;
+    case CMD_TOO_LONG:
+        out_printf("Error: Linea demasiado larga.\n");
+        break;
+    case CMD_UNKNOWN:
+        out_printf("Error: Comando no reconocido. Use CREATE, WRITE, READ, FALLOCATE, PUNCH, DELETE, LIST o EXIT.\n");
+        break;
+    }
+    
+    /* Enviar los cambios del comando a los destinos de réplica */
+    journal_commit();
+    return true;
+}
+
+/**
+ * Ejecuta una línea de la consola completa frente a los hilos de
+ * replicación
+ * @param line Línea del comando, sin salto de línea
+ * @return false si el comando pide terminar la sesión (EXIT/QUIT)
+ */
+static bool execute_command(const char *line) {
+    Command cmd;
+    parse_command(line, &cmd);
+    
+    /* Cada comando se ejecuta completo frente a los hilos de replicación */
+    pthread_mutex_lock(&fs_lock);
+    bool keep = run_command(&cmd);
+    pthread_mutex_unlock(&fs_lock);
+    return keep;
+}
+
+/**
+ * Encola un evento para los clientes suscritos cuyo patrón coincide con
+ * el archivo. Lo llaman las operaciones al terminar con éxito, en el hilo
+ * que ejecuta los comandos.
+ * @param kind Tipo de evento
+ * @param file Archivo afectado, NULL para WATCH_FORMAT
+ */
+void watch_notify(WatchKind kind, const FileEntry *file) {
+    for (size_t c = 0; c < server.num_loops * SERVER_MAX_CLIENTS; c++) {
+        WatchSub *sub = atomic_load(&server.loops[c / SERVER_MAX_CLIENTS].clients[c % SERVER_MAX_CLIENTS].watch);
+        if (sub == NULL) {
+            continue;
+        }
+        
+        size_t index = file != NULL ? (size_t)(file - fs.file_table) : 0;
+        bool match = file == NULL;
+        for (size_t i = 0; i < sub->num_patterns && !match; i++) {
+            match = fnmatch(sub->patterns[i], file->filename, 0) == 0;
+        }
+        if (!match) {
+            continue;
+        }
+        
+        if (kind == WATCH_WRITE) {
+            atomic_fetch_add(&sub->write_count[index], 1);
+            if (atomic_exchange(&sub->write_pending[index], true)) {
+                atomic_fetch_add(&sub->coalesced, 1);
+                continue;  /* Se entrega con el WRITE ya encolado */
+            }
+        } else if (kind == WATCH_DELETE) {
+            /* La entrada puede reutilizarse: sus escrituras serán otro evento */
+            atomic_store(&sub->write_pending[index], false);
+        } else if (kind == WATCH_FORMAT) {
+            for (size_t i = 0; i < MAX_FILES; i++) {
+                atomic_store(&sub->write_pending[i], false);
+            }
+        }
+        
+        size_t tail = atomic_load_explicit(&sub->tail, memory_order_relaxed);
+        size_t head = atomic_load_explicit(&sub->head, memory_order_acquire);
+        if (tail - head == WATCH_QUEUE_LEN) {
+            atomic_store(&sub->overflow, true);
+            if (kind == WATCH_WRITE) {
+                atomic_store(&sub->write_pending[index], false);
+            }
+        } else {
+            WatchEvent *ev = &sub->ring[tail & (WATCH_QUEUE_LEN - 1)];
+            ev->kind = kind;
+            ev->file = index;
+            snprintf(ev->filename, sizeof(ev->filename), "%s", file != NULL ? file->filename : "");
+            atomic_store_explicit(&sub->tail, tail + 1, memory_order_release);
+        }
+        uint64_t one = 1;
+        ssize_t written = write(sub->efd, &one, sizeof(one));
+        (void)written;  /* Si falla, el contador ya está al máximo y el aviso sigue pendiente */
+    }
+}
+
+/**
+ * Entrega al cliente los eventos pendientes de su suscripción, una
+ * línea "EVENT ..." por evento. Lo llama el hilo de respuesta.
+ * @param fd Socket del cliente
+ * @param sub Suscripción
+ * @return 0 si es exitoso, -1 si el cliente se desconectó
+ */
+static int watch_deliver(int fd, WatchSub *sub) {
+    static const char *const names[] = { "CREATE", "WRITE", "DELETE", "FORMAT" };
+    uint64_t signals;
+    if (read(sub->efd, &signals, sizeof(signals)) != sizeof(signals)) {
+        return 0;  /* Nada pendiente */
+    }
+    
+    char line[MAX_FILENAME + 64];
+    size_t head = atomic_load_explicit(&sub->head, memory_order_relaxed);
+    size_t tail = atomic_load_explicit(&sub->tail, memory_order_acquire);
+    for (; head != tail; head++) {
+        const WatchEvent *ev = &sub->ring[head & (WATCH_QUEUE_LEN - 1)];
+        int len;
+        if (ev->kind == WATCH_WRITE) {
+            /* Liberar la marca antes de leer la cuenta: una escritura posterior genera otro evento */
+            atomic_store(&sub->write_pending[ev->file], false);
+            uint32_t count = atomic_exchange(&sub->write_count[ev->file], 0);
+            len = snprintf(line, sizeof(line), "EVENT WRITE %s %u\n", ev->filename, count > 0 ? count : 1);
+        } else if (ev->kind == WATCH_FORMAT) {
+            len = snprintf(line, sizeof(line), "EVENT FORMAT\n");
+        } else {
+            len = snprintf(line, sizeof(line), "EVENT %s %s\n", names[ev->kind], ev->filename);
+        }
+        atomic_store_explicit(&sub->head, head + 1, memory_order_release);
+        sub->delivered++;
+        if (send_all(fd, line, (size_t)len) != 0) {
+            return -1;
+        }
+    }
+    if (atomic_exchange(&sub->overflow, false) &&
+        send_all(fd, "EVENT OVERFLOW\n", strlen("EVENT OVERFLOW\n")) != 0) {
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Comando WATCH: suscribe al cliente a los eventos de un archivo o de los
+ * que coinciden con un patrón (como DELETE-MATCH)
+ * @param client Cliente
+ * @param pattern Nombre o patrón fnmatch
+ * @return 0 si es exitoso, -1 en caso de error
+ */
+static int watch_subscribe(ServerClient *client, const char *pattern) {
+    if (pattern[0] == '\0') {
+        out_printf("Error: Uso: WATCH <archivo|patron>.\n");
+        return -1;
+    }
+    
+    WatchSub *sub = atomic_load(&client->watch);
+    if (sub == NULL) {
+        sub = slab_alloc(sizeof(*sub));
+        if (sub == NULL) {
+            out_printf("Error: No hay memoria para la suscripcion.\n");
+            return -1;
+        }
+        memset(sub, 0, sizeof(*sub));
+        sub->efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (sub->efd < 0) {
+            out_printf("Error: No se pudo crear el eventfd de la suscripcion.\n");
+            slab_free(sub, sizeof(*sub));
+            return -1;
+        }
+    }
+    
+    if (sub->num_patterns == WATCH_PATTERNS) {
+        out_printf("Error: Maximo de %d patrones por cliente.\n", WATCH_PATTERNS);
+        return -1;
+    }
+    snprintf(sub->patterns[sub->num_patterns], MAX_FILENAME, "%s", pattern);
+    sub->num_patterns++;
+    /* Publicar con el patrón ya escrito: watch_notify() lo lee en este mismo hilo */
+    atomic_store(&client->watch, sub);
+    out_printf("Suscrito a '%s' (%zu patron(es)).\n", pattern, sub->num_patterns);
+    return 0;
+}
+
+/**
+ * Libera una suscripción que ya no recibe eventos
+ * @param sub Suscripción (puede ser NULL)
+ */
+static void watch_free(WatchSub *sub) {
+    if (sub != NULL) {
+        close(sub->efd);
+        slab_free(sub, sizeof(*sub));
+    }
+}
+
+/**
+ * Prepara una cola entre etapas
+ * @param q Cola
+ * @return 0 si es exitoso, -1 si no se pudo crear el eventfd
+ */
+static int pipe_init(PipeQueue *q) {
+    atomic_store(&q->head, 0);
+    atomic_store(&q->tail, 0);
+    q->efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    return q->efd >= 0 ? 0 : -1;
+}
+
+/**
+ * Despierta al consumidor de una cola
+ * @param q Cola
+ */
+static void pipe_signal(PipeQueue *q) {
+    uint64_t one = 1;
+    ssize_t written = write(q->efd, &one, sizeof(one));
+    (void)written;  /* Si falla, el contador ya está al máximo y el aviso sigue pendiente */
+}
+
+/**
+ * Añade un elemento a una cola. Si está llena, avisa al consumidor y
+ * espera a que haga sitio, lo que frena a la etapa anterior.
+ * @param q Cola
+ * @param item Elemento
+ */
+static void pipe_push(PipeQueue *q, void *item) {
+    size_t tail = atomic_load_explicit(&q->tail, memory_order_relaxed);
+    while (tail - atomic_load_explicit(&q->head, memory_order_acquire) == PIPE_QUEUE_LEN) {
+        pipe_signal(q);
+        poll(NULL, 0, 1);
+    }
+    q->slots[tail & (PIPE_QUEUE_LEN - 1)] = item;
+    atomic_store_explicit(&q->tail, tail + 1, memory_order_release);
+}
+
+/**
+ * Toma de una cola hasta max elementos en orden
+ * @param q Cola
+ * @param items Destino
+ * @param max Elementos como máximo
+ * @return Elementos tomados, 0 si la cola estaba vacía
+ */
+static size_t pipe_pop(PipeQueue *q, void **items, size_t max) {
+    size_t head = atomic_load_explicit(&q->head, memory_order_relaxed);
+    size_t tail = atomic_load_explicit(&q->tail, memory_order_acquire);
+    size_t n = 0;
+    while (head + n != tail && n < max) {
+        items[n] = q->slots[(head + n) & (PIPE_QUEUE_LEN - 1)];
+        n++;
+    }
+    atomic_store_explicit(&q->head, head + n, memory_order_release);
+    return n;
+}
+
+/**
+ * Espera el aviso de una cola y lo consume; después hay que vaciarla con
+ * pipe_pop() hasta que devuelva 0
+ * @param q Cola
+ * @param timeout_ms Espera máxima, -1 sin límite
+ */
+static void pipe_wait(PipeQueue *q, int timeout_ms) {
+    struct pollfd pfd = { .fd = q->efd, .events = POLLIN };
+    uint64_t signals;
+    if (poll(&pfd, 1, timeout_ms) > 0 && read(q->efd, &signals, sizeof(signals)) < 0) {
+        return;  /* Otro aviso llegará con el siguiente lote */
+    }
+}
+
+/**
+ * Marca como prestadas las páginas de un tramo de bloques
+ * @param block Primer bloque
+ * @param count Número de bloques
+ */
+static void export_lend(size_t block, size_t count) {
+    size_t per_page = store.page_size / BLOCK_SIZE;
+    for (size_t page = block - block % per_page; page < block + count; page += per_page) {
+        if (!exports.lent[page]) {
+            exports.lent[page] = true;
+            exports.lent_pages++;
+        }
+    }
+}
+
+/**
+ * Cierra las tuberías de un EXPORT y lo libera
+ * @param st Exportación (puede ser NULL)
+ */
+static void export_stream_free(ExportStream *st) {
+    if (st == NULL) {
+        return;
+    }
+    for (size_t i = 0; i < st->num_pipes; i++) {
+        close(st->fds[i][0]);
+        close(st->fds[i][1]);
+    }
+    slab_free(st, sizeof(*st));
+}
+
+/**
+ * Carga un tramo del archivo en las tuberías de un EXPORT sin copiarlo:
+ * splice() desde el memfd o vmsplice() desde la memoria del almacén, de
+ * modo que la tubería solo referencia las páginas. Si la tubería actual
+ * se llena se abre otra.
+ * @param st Exportación
+ * @param block Primer bloque físico del tramo, NO_BLOCK para un hueco
+ * @param len Bytes del tramo
+ * @return 0 si es exitoso, -1 si no se pudo cargar
+ */
+static int export_load(ExportStream *st, BlockNo block, size_t len) {
+    static const unsigned char zeros[PAGE_SIZE_BYTES];
+    size_t done = 0;
+    
+    while (done < len) {
+        ssize_t n = -1;
+        if (st->num_pipes > 0) {
+            int pipe_w = st->fds[st->num_pipes - 1][1];
+            size_t chunk = len - done;
+            if (block == NO_BLOCK) {
+                struct iovec iov = {
+                    .iov_base = (void *)zeros,
+                    .iov_len = chunk < sizeof(zeros) ? chunk : sizeof(zeros)
+                };
+                n = vmsplice(pipe_w, &iov, 1, SPLICE_F_NONBLOCK);
+            } else if (store.kind == STORE_MEMFD) {
+                loff_t off = (loff_t)block * BLOCK_SIZE + (loff_t)done;
+                n = splice(store.fd, &off, pipe_w, NULL, chunk, SPLICE_F_NONBLOCK);
+            } else {
+                struct iovec iov = { .iov_base = fs.blocks[block] + done, .iov_len = chunk };
+                n = vmsplice(pipe_w, &iov, 1, SPLICE_F_NONBLOCK);
+            }
+        }
+        if (n > 0) {
+            st->lens[st->num_pipes - 1] += (size_t)n;
+            done += (size_t)n;
+            continue;
+        }
+    
+        /* Tubería llena: abrir otra (si la recién abierta falla, no hay arreglo) */
+        if (st->num_pipes == EXPORT_MAX_PIPES ||
+            (st->num_pipes > 0 && st->lens[st->num_pipes - 1] == 0) ||
+            pipe2(st->fds[st->num_pipes], O_CLOEXEC) != 0) {
+            return -1;
+        }
+        fcntl(st->fds[st->num_pipes][1], F_SETPIPE_SZ, EXPORT_PIPE_SIZE);
+        st->lens[st->num_pipes++] = 0;
+    }
+    return 0;
+}
+
+/**
+ * Comando EXPORT: responde "DATA <n>" seguido de los n bytes del archivo.
+ * Los datos se cargan en tuberías sin copiarlos y el hilo de respuesta
+ * los pasa al socket con splice(); las páginas quedan prestadas hasta su
+ * próxima modificación (export_unlend). Si no se pueden usar tuberías, los
+ * datos van copiados en la propia respuesta.
+ * @param filename Nombre del archivo
+ * @return Datos pendientes de enviar tras la cabecera, NULL si ya van en
+ *         la respuesta o hubo un error
+ */
+static ExportStream *server_export(const char *filename) {
+    static const unsigned char zeros[BLOCK_SIZE];
+    FileEntry *file = find_file(filename);
+    if (file == NULL) {
+        out_printf("Error: El archivo '%s' no existe.\n", filename);
+        return NULL;
+    }
+    cold_touch(file);
+    
+    if (file->packed_len > 0) {
+        /* Comprimido: sus bytes no están en el almacén, van descomprimidos en la respuesta */
+        if (file_load(file, pack_content, file_logical_blocks(file)) != 0) {
+            return NULL;
+        }
+        out_printf("DATA %zu\n", file->size);
+        fwrite(pack_content, 1, file->size, cmd_out());
+        exports.bytes += file->size;
+        exports.copied++;
+        return NULL;
+    }
+    
+    const BlockNo *blocks = file_blocks(file);
+    size_t num_blocks = (file->size + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    if (num_blocks > file->num_blocks) {
+        num_blocks = file->num_blocks;  /* Lo que falta se lee como hueco */
+    }
+    for (size_t b = 0; b < num_blocks; b++) {
+        if (blocks[b] != NO_BLOCK && !ensure_block_intact(blocks[b])) {
+            out_printf("Error: El bloque %u esta danado y no se puede reconstruir.\n", blocks[b]);
+            return NULL;
+        }
+    }
+    out_printf("DATA %zu\n", file->size);
+    exports.bytes += file->size;
+    
+    /* Tramos de bloques físicos consecutivos (o de huecos) en una sola carga */
+    ExportStream *st = NULL;
+    if (store.page_size % BLOCK_SIZE == 0 && store.page_size <= EXPORT_MAX_PAGE) {
+        st = slab_alloc(sizeof(*st));
+    }
+    if (st != NULL) {
+        memset(st, 0, sizeof(*st));
+    }
+    for (size_t b = 0, done = 0; st != NULL && done < file->size; ) {
+        BlockNo first = b < num_blocks ? blocks[b] : NO_BLOCK;
+        size_t run = 1;
+        while (b + run < num_blocks &&
+               blocks[b + run] == (first == NO_BLOCK ? NO_BLOCK : first + (BlockNo)run)) {
+            run++;
+        }
+        size_t len = run * BLOCK_SIZE < file->size - done ? run * BLOCK_SIZE : file->size - done;
+        if (export_load(st, first, len) != 0) {
+            export_stream_free(st);
+            st = NULL;
+            break;
+        }
+        if (first != NO_BLOCK) {
+            export_lend(first, run);
+        }
+        b += run;
+        done += len;
+    }
+    if (st != NULL) {
+        exports.zero_copy++;
+        return st;
+    }
+    
+    /* Sin tuberías: los datos van copiados en la respuesta */
+    for (size_t b = 0, done = 0; done < file->size; b++) {
+        size_t len = file->size - done < BLOCK_SIZE ? file->size - done : BLOCK_SIZE;
+        const void *src = b < num_blocks && blocks[b] != NO_BLOCK ? (const void *)fs.blocks[blocks[b]] : zeros;
+        fwrite(src, 1, len, cmd_out());
+        done += len;
+    }
+    exports.copied++;
+    return NULL;
+}
+
+/**
+ * Ejecuta un comando de un cliente capturando su salida: la salida de
+ * los comandos del hilo (thread_out) apunta a un flujo en memoria
+ * mientras se ejecuta, y stdout sigue siendo la consola.
+ * @param client Cliente
+ * @param cmd Comando analizado
+ * @param out Resultado: respuesta con una referencia y, si el comando lo
+ *            pide, corte de la conexión o suscripción retirada
+ * @return 0 si es exitoso, -1 si no hay memoria para la respuesta
+ */
+static int server_execute(ServerClient *client, const Command *cmd, PipeReply *out) {
+    SharedReply *reply = slab_alloc(sizeof(*reply));
+    FILE *capture = reply != NULL ? open_memstream(&reply->bytes, &reply->len) : NULL;
+    if (capture == NULL) {
+        slab_free(reply, sizeof(*reply));
+        return -1;
+    }
+    
+    thread_out = capture;
+    if (cmd->op == CMD_WATCH) {
+        watch_subscribe(client, cmd->filename);
+    } else if (cmd->op == CMD_UNWATCH) {
+        /* El hilo de respuesta entrega lo pendiente y la libera */
+        out->retired = atomic_exchange(&client->watch, NULL);
+        out_printf("Suscripcion cancelada.\n");
+    } else if (cmd->op == CMD_EXPORT) {
+        out->stream = server_export(cmd->filename);
+    } else {
+        out->hangup = !run_command(cmd);
+    }
+    thread_out = NULL;
+    fclose(capture);
+    atomic_init(&reply->refs, 1);
+    out->reply = reply;
+    return 0;
+}
+
+/**
+ * Suelta una referencia a una respuesta y la libera con la última
+ * @param reply Respuesta
+ */
+static void reply_release(SharedReply *reply) {
+    if (atomic_fetch_sub(&reply->refs, 1) == 1) {
+        free(reply->bytes);
+        slab_free(reply, sizeof(*reply));
+    }
+}
+
+/**
+ * Espera el aviso de la cola de entrada de cualquier bucle y lo consume
+ * @param timeout_ms Espera máxima
+ */
+static void server_executor_wait(int timeout_ms) {
+    struct pollfd pfd[SERVER_MAX_LOOPS];
+    for (size_t l = 0; l < server.num_loops; l++) {
+        pfd[l].fd = server.loops[l].to_exec.efd;
+        pfd[l].events = POLLIN;
+    }
+    if (poll(pfd, server.num_loops, timeout_ms) <= 0) {
+        return;
+    }
+    for (size_t l = 0; l < server.num_loops; l++) {
+        if (pfd[l].revents != 0) {
+            pipe_wait(&server.loops[l].to_exec, 0);
+        }
+    }
+}
+
+/**
+ * Etapa de ejecución, común a todos los bucles. Toma las peticiones por
+ * lotes, de las colas de todos los bucles empezando cada vez por uno
+ * distinto, y ejecuta cada lote con un único fs_lock, confirmando el
+ * journal comando a comando. Dentro de un lote, un READ idéntico
+ * (archivo, offset, longitud) a otro ya ejecutado sin cambios intermedios
+ * reutiliza su respuesta: todos sus clientes reciben el mismo buffer. Los
+ * resultados pasan a la etapa de respuesta de su bucle al terminar el
+ * lote, con las referencias ya contadas.
+ * @param arg No se usa
+ * @return NULL
+ */
+static void *server_executor(void *arg) {
+    (void)arg;
+    PipeRequest *batch[PIPE_BATCH];
+    PipeReply *outs[PIPE_BATCH];
+    PipeReply *reads[PIPE_BATCH];
+    const Command *read_cmds[PIPE_BATCH];
+    static bool hung_up[SERVER_MAX_LOOPS][SERVER_MAX_CLIENTS];
+    size_t stops = 0;
+    size_t first = 0;
+    
+    memset(hung_up, 0, sizeof(hung_up));
+    while (stops < server.num_loops) {
+        server_executor_wait(200);
+        bgsave_poll(false);
+        
+        for (;;) {
+            size_t n = 0;
+            for (size_t i = 0; i < server.num_loops && n < PIPE_BATCH; i++) {
+                ServerLoop *loop = &server.loops[(first + i) % server.num_loops];
+                n += pipe_pop(&loop->to_exec, (void **)batch + n, PIPE_BATCH - n);
+            }
+            first = (first + 1) % server.num_loops;
+            if (n == 0) {
+                break;
+            }
+            
+            size_t num_reads = 0;
+            size_t num_outs = 0;
+            size_t executed = 0;
+            pthread_mutex_lock(&fs_lock);
+            for (size_t i = 0; i < n; i++) {
+                PipeRequest *req = batch[i];
+                PipeReply *out = req->out;  /* Ya reservado: aquí no se reserva con fs_lock */
+                memset(out, 0, sizeof(*out));
+                out->loop = req->loop;
+                out->client = req->client;
+                ServerClient *client = &server.loops[req->loop].clients[req->client];
+                bool *client_hung_up = &hung_up[req->loop][req->client];
+                
+                if (req->stop) {
+                    out->stop = true;
+                    stops++;
+                } else if (req->release) {
+                    out->retired = atomic_exchange(&client->watch, NULL);
+                    out->release = true;
+                    *client_hung_up = false;
+                } else if (*client_hung_up) {
+                    slab_free(out, sizeof(*out));  /* Líneas enviadas tras EXIT */
+                    continue;
+                } else {
+                    const Command *cmd = &req->cmd;
+                    size_t r = num_reads;
+                    if (cmd->op == CMD_READ) {
+                        for (r = 0; r < num_reads; r++) {
+                            if (read_cmds[r]->offset == cmd->offset && read_cmds[r]->size == cmd->size &&
+                                strcmp(read_cmds[r]->filename, cmd->filename) == 0) {
+                                break;
+                            }
+                        }
+                    } else if (cmd->mutating) {
+                        num_reads = 0;
+                    }
+                    
+                    if (r < num_reads) {
+                        out->reply = reads[r]->reply;
+                        atomic_fetch_add(&out->reply->refs, 1);
+                        server.reads_shared++;
+                        server.bytes_shared += out->reply->len;
+                    } else if (server_execute(client, cmd, out) != 0) {
+                        out->hangup = true;
+                    } else if (cmd->op == CMD_READ) {
+                        reads[num_reads] = out;
+                        read_cmds[num_reads++] = cmd;
+                    }
+                    *client_hung_up = out->hangup;
+                    executed++;
+                }
+                outs[num_outs++] = out;
+            }
+            if (executed > 0) {
+                server.batches++;
+                server.requests += executed;
+            }
+            pthread_mutex_unlock(&fs_lock);
+            
+            /* Las referencias compartidas ya están contadas */
+            bool touched[SERVER_MAX_LOOPS] = { false };
+            for (size_t i = 0; i < num_outs; i++) {
+                size_t loop = outs[i]->loop;  /* Tras pipe_push, outs[i] es del hilo de respuesta */
+                pipe_push(&server.loops[loop].to_respond, outs[i]);
+                touched[loop] = true;
+            }
+            for (size_t l = 0; l < server.num_loops; l++) {
+                if (touched[l]) {
+                    pipe_signal(&server.loops[l].to_respond);
+                }
+            }
+            
+            for (size_t i = 0; i < n; i++) {
+                slab_free(batch[i], sizeof(*batch[i]));
+            }
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Envía varias respuestas seguidas a un cliente, cada una terminada por
+ * la línea ".", con un solo sendmsg() si cabe y sin copiarlas: el mismo
+ * buffer sirve a todos los clientes que lo comparten
+ * @param fd Socket del cliente
+ * @param replies Respuestas (se suelta una referencia de cada una)
+ * @param n Número de respuestas
+ * @return 0 si es exitoso, -1 si el cliente se desconectó
+ */
+static int server_send_replies(int fd, SharedReply **replies, size_t n) {
+    struct iovec iov[2 * PIPE_BATCH];
+    size_t count = 0;
+    for (size_t i = 0; i < n; i++) {
+        iov[count].iov_base = replies[i]->bytes;
+        iov[count++].iov_len = replies[i]->len;
+        iov[count].iov_base = ".\n";
+        iov[count++].iov_len = 2;
+    }
+    
+    int rc = 0;
+    size_t idx = 0;
+    while (idx < count && fd >= 0) {
+        struct msghdr msg = { .msg_iov = &iov[idx], .msg_iovlen = count - idx };
+        ssize_t sent_bytes = sendmsg(fd, &msg, 0);
+        if (sent_bytes < 0) {
+            rc = -1;
+            break;
+        }
+        /* Avanzar sobre lo enviado (envío parcial) */
+        size_t sent = (size_t)sent_bytes;
+        while (idx < count && sent >= iov[idx].iov_len) {
+            sent -= iov[idx].iov_len;
+            idx++;
+        }
+        if (idx < count) {
+            iov[idx].iov_base = (char *)iov[idx].iov_base + sent;
+            iov[idx].iov_len -= sent;
+        }
+    }
+    for (size_t i = 0; i < n; i++) {
+        reply_release(replies[i]);
+    }
+    return rc;
+}
+
+/**
+ * Envía la respuesta de un EXPORT: la cabecera, los datos pasando cada
+ * tubería al socket con splice() y la línea "."
+ * @param fd Socket del cliente, -1 si ya no se puede enviar
+ * @param reply Cabecera (se suelta una referencia)
+ * @param st Datos en tuberías (se liberan)
+ * @return 0 si es exitoso, -1 si el cliente se desconectó
+ */
+static int server_send_export(int fd, SharedReply *reply, ExportStream *st) {
+    int rc = fd >= 0 && send_all(fd, reply->bytes, reply->len) == 0 ? 0 : -1;
+    for (size_t i = 0; i < st->num_pipes && rc == 0; i++) {
+        size_t left = st->lens[i];
+        while (left > 0 && rc == 0) {
+            ssize_t n = splice(st->fds[i][0], NULL, fd, NULL, left, SPLICE_F_MOVE);
+            if (n <= 0) {
+                rc = -1;
+            } else {
+                left -= (size_t)n;
+            }
+        }
+    }
+    if (rc == 0 && send_all(fd, ".\n", 2) != 0) {
+        rc = -1;
+    }
+    reply_release(reply);
+    export_stream_free(st);
+    return fd >= 0 ? rc : 0;
+}
+
+/**
+ * Procesa un lote de la etapa de respuesta. Las respuestas de un mismo
+ * cliente se envían juntas y en orden; una suscripción retirada entrega
+ * antes sus eventos pendientes.
+ * @param loop Bucle
+ * @param batch Resultados de la etapa de ejecución (se liberan)
+ * @param n Número de resultados
+ * @param dead Clientes cuyo socket ya falló o se cortó
+ * @return true si el lote contenía el fin de la tubería
+ */
+static bool server_respond(ServerLoop *loop, PipeReply **batch, size_t n, bool *dead) {
+    SharedReply *group[PIPE_BATCH];
+    bool done[PIPE_BATCH] = { false };
+    bool stop = false;
+    
+    for (size_t i = 0; i < n; i++) {
+        if (done[i]) {
+            continue;
+        }
+        size_t c = batch[i]->client;
+        ServerClient *client = &loop->clients[c];
+        size_t num = 0;
+        for (size_t j = i; j < n; j++) {
+            PipeReply *r = batch[j];
+            if (done[j] || r->client != c) {
+                continue;
+            }
+            done[j] = true;
+            stop = stop || r->stop;
+            if (r->stream != NULL) {
+                /* Lo anterior sale antes que la cabecera y los datos del EXPORT */
+                if (server_send_replies(dead[c] ? -1 : client->fd, group, num) != 0) {
+                    dead[c] = true;
+                }
+                if (server_send_export(dead[c] ? -1 : client->fd, r->reply, r->stream) != 0) {
+                    dead[c] = true;
+                }
+                num = 0;
+            } else if (r->reply != NULL) {
+                group[num++] = r->reply;
+            }
+            if (r->retired != NULL || r->hangup || r->release) {
+                if (server_send_replies(dead[c] ? -1 : client->fd, group, num) != 0) {
+                    dead[c] = true;
+                }
+                num = 0;
+            }
+            if (r->retired != NULL) {
+                if (!dead[c] && watch_deliver(client->fd, r->retired) != 0) {
+                    dead[c] = true;
+                }
+                watch_free(r->retired);
+            }
+            if ((r->hangup || dead[c]) && !r->release && !r->stop) {
+                /* El hilo de red verá el cierre y mandará la liberación */
+                shutdown(client->fd, SHUT_RDWR);
+                dead[c] = true;
+            }
+            if (r->release) {
+                close(client->fd);
+                dead[c] = false;
+                atomic_store(&client->state, CLIENT_FREE);
+            }
+            slab_free(r, sizeof(*r));
+        }
+        if (num > 0 && server_send_replies(dead[c] ? -1 : client->fd, group, num) != 0) {
+            dead[c] = true;
+            shutdown(client->fd, SHUT_RDWR);
+        }
+    }
+    return stop;
+}
+
+/**
+ * Etapa de respuesta de un bucle: envía las respuestas y entrega los
+ * eventos de WATCH de sus conexiones
+ * @param arg Bucle (ServerLoop)
+ * @return NULL
+ */
+static void *server_responder(void *arg) {
+    ServerLoop *loop = arg;
+    PipeReply *batch[PIPE_BATCH];
+    bool dead[SERVER_MAX_CLIENTS] = { false };
+    struct pollfd pfd[1 + SERVER_MAX_CLIENTS];
+    WatchSub *subs[1 + SERVER_MAX_CLIENTS];
+    size_t owner[1 + SERVER_MAX_CLIENTS];
+    
+    for (;;) {
+        size_t n = 1;
+        pfd[0].fd = loop->to_respond.efd;
+        pfd[0].events = POLLIN;
+        for (size_t c = 0; c < SERVER_MAX_CLIENTS; c++) {
+            WatchSub *sub = atomic_load(&loop->clients[c].watch);
+            if (sub != NULL && !dead[c]) {
+                pfd[n].fd = sub->efd;
+                pfd[n].events = POLLIN;
+                subs[n] = sub;
+                owner[n++] = c;
+            }
+        }
+        if (poll(pfd, n, -1) < 0) {
+            continue;
+        }
+        
+        for (size_t i = 1; i < n; i++) {
+            size_t c = owner[i];
+            if (pfd[i].revents != 0 && !dead[c] && watch_deliver(loop->clients[c].fd, subs[i]) != 0) {
+                dead[c] = true;
+                shutdown(loop->clients[c].fd, SHUT_RDWR);
+            }
+        }
+        if (pfd[0].revents != 0) {
+            pipe_wait(&loop->to_respond, 0);
+            size_t count;
+            while ((count = pipe_pop(&loop->to_respond, (void **)batch, PIPE_BATCH)) > 0) {
+                if (server_respond(loop, batch, count, dead)) {
+                    return NULL;
+                }
+            }
+        }
+    }
+}
+
+/**
+ * Lee lo disponible en el socket de un cliente
+ * @param client Cliente
+ * @return 0 si la conexión sigue abierta, -1 si se cerró
+ */
+static int server_receive(ServerClient *client) {
+    if (client->in_len == sizeof(client->in)) {
+        return 0;  /* Búfer lleno de líneas completas: se vacía al analizarlas */
+    }
+    ssize_t n = recv(client->fd, client->in + client->in_len,
+                     sizeof(client->in) - client->in_len, 0);
+    if (n <= 0) {
+        return -1;
+    }
+    client->in_len += (size_t)n;
+    return 0;
+}
+
+/**
+ * Extrae la siguiente línea completa recibida de un cliente
+ * @param client Cliente
+ * @param line Destino (SERVER_LINE_MAX bytes)
+ * @return true si había una línea completa
+ */
+static bool server_next_line(ServerClient *client, char *line) {
+    char *nl = memchr(client->in, '\n', client->in_len);
+    if (nl == NULL) {
+        return false;
+    }
+    size_t len = (size_t)(nl - client->in);
+    memcpy(line, client->in, len);
+    line[len] = '\0';
+    if (len > 0 && line[len - 1] == '\r') {
+        line[len - 1] = '\0';
+    }
+    memmove(client->in, nl + 1, client->in_len - len - 1);
+    client->in_len -= len + 1;
+    return true;
+}
+
+/**
+ * Reserva una petición junto con su resultado. La etapa de ejecución
+ * rellena el resultado sin reservar memoria, así que nunca espera por
+ * ella con fs_lock tomado.
+ * @param loop Bucle del cliente
+ * @param c Hueco del cliente
+ * @return Petición a cero con su resultado, NULL si no hay memoria
+ */
+static PipeRequest *pipe_request_new(ServerLoop *loop, size_t c) {
+    PipeRequest *req = slab_alloc(sizeof(*req));
+    PipeReply *out = slab_alloc(sizeof(*out));
+    if (req == NULL || out == NULL) {
+        slab_free(req, sizeof(*req));
+        slab_free(out, sizeof(*out));
+        return NULL;
+    }
+    memset(req, 0, sizeof(*req));
+    req->loop = (size_t)(loop - server.loops);
+    req->client = c;
+    req->out = out;
+    return req;
+}
+
+/**
+ * Pasa una petición a la etapa de ejecución
+ * @param loop Bucle del cliente
+ * @param c Hueco del cliente
+ * @param cmd Comando, NULL para liberar la conexión
+ * @return 0 si es exitoso, -1 si no hay memoria
+ */
+static int server_submit(ServerLoop *loop, size_t c, const Command *cmd) {
+    PipeRequest *req = pipe_request_new(loop, c);
+    if (req == NULL) {
+        return -1;
+    }
+    req->release = cmd == NULL;
+    if (cmd != NULL) {
+        req->cmd = *cmd;
+    }
+    pipe_push(&loop->to_exec, req);
+    return 0;
+}
+
+/**
+ * Etapa de red y análisis para un cliente con datos: lee, separa las
+ * líneas completas, las analiza y las pasa a la etapa de ejecución. Si
+ * la conexión se cerró, pasa su liberación detrás de sus comandos.
+ * @param loop Bucle del cliente
+ * @param c Hueco del cliente
+ */
+static void server_read_client(ServerLoop *loop, size_t c) {
+    ServerClient *client = &loop->clients[c];
+    char line[SERVER_LINE_MAX];
+    Command cmd;
+    
+    bool closed = server_receive(client) != 0;
+    while (server_next_line(client, line)) {
+        if (line[0] == '\0') {
+            continue;
+        }
+        parse_command(line, &cmd);
+        if (server_submit(loop, c, &cmd) != 0) {
+            closed = true;
+            break;
+        }
+    }
+    if (!closed && client->in_len == sizeof(client->in)) {
+        /* Línea sin fin en el búfer: se avisa y se cierra */
+        cmd.op = CMD_TOO_LONG;
+        cmd.mutating = false;
+        server_submit(loop, c, &cmd);
+        closed = true;
+    }
+    if (closed) {
+        atomic_store(&client->state, CLIENT_CLOSING);
+        while (server_submit(loop, c, NULL) != 0) {
+            poll(NULL, 0, 1);  /* La liberación no puede perderse */
+        }
+    }
+}
+
+/**
+ * Etapa de red y análisis de un bucle: acepta en su propio socket de
+ * escucha y lee solo de sus conexiones. Al parar, libera las conexiones
+ * abiertas y cierra su tubería con una marca de fin.
+ * @param arg Bucle (ServerLoop)
+ * @return NULL
+ */
+static void *server_network(void *arg) {
+    ServerLoop *loop = arg;
+    
+    /* pfd[0] es el socket de escucha; luego un socket por cliente */
+    struct pollfd pfd[1 + SERVER_MAX_CLIENTS];
+    size_t owner[1 + SERVER_MAX_CLIENTS];
+    while (!atomic_load(&server.stopping)) {
+        size_t n = 1;
+        pfd[0].fd = loop->listen_fd;
+        pfd[0].events = POLLIN;
+        for (size_t c = 0; c < SERVER_MAX_CLIENTS; c++) {
+            if (atomic_load(&loop->clients[c].state) == CLIENT_OPEN) {
+                pfd[n].fd = loop->clients[c].fd;
+                pfd[n].events = POLLIN;
+                owner[n++] = c;
+            }
+        }
+        
+        if (poll(pfd, n, 200) <= 0) {
+            continue;  /* Se comprueba stopping */
+        }
+        
+        for (size_t i = 1; i < n; i++) {
+            if (pfd[i].revents != 0) {
+                server_read_client(loop, owner[i]);
+            }
+        }
+        /* Un aviso por vuelta para todo lo recibido */
+        pipe_signal(&loop->to_exec);
+        
+        if (pfd[0].revents & POLLIN) {
+            int fd = accept4(loop->listen_fd, NULL, NULL, SOCK_CLOEXEC);
+            ServerClient *slot = NULL;
+            for (size_t c = 0; c < SERVER_MAX_CLIENTS && fd >= 0 && slot == NULL; c++) {
+                if (atomic_load(&loop->clients[c].state) == CLIENT_FREE) {
+                    slot = &loop->clients[c];
+                }
+            }
+            if (slot != NULL) {
+                slot->fd = fd;
+                slot->in_len = 0;
+                atomic_store(&slot->state, CLIENT_OPEN);
+            } else if (fd >= 0) {
+                send_all(fd, "Error: Demasiados clientes.\n.\n", strlen("Error: Demasiados clientes.\n.\n"));
+                close(fd);
+            }
         }
     }
     
-    return allocated;
+    /* Liberar las conexiones abiertas y cerrar la tubería detrás de ellas */
+    for (size_t c = 0; c < SERVER_MAX_CLIENTS; c++) {
+        if (atomic_load(&loop->clients[c].state) == CLIENT_OPEN) {
+            atomic_store(&loop->clients[c].state, CLIENT_CLOSING);
+            while (server_submit(loop, c, NULL) != 0) {
+                poll(NULL, 0, 1);
+            }
+        }
+    }
+    PipeRequest *stop;
+    while ((stop = pipe_request_new(loop, 0)) == NULL) {
+        poll(NULL, 0, 1);
+    }
+    stop->stop = true;
+    pipe_push(&loop->to_exec, stop);
+    pipe_signal(&loop->to_exec);
+    return NULL;
 }
 
 /**
- * Libera bloques de memoria
- * @param num_blocks Número de bloques a liberar
- * @param block_list Array con los índices de bloques a liberar
+ * Cierra los sockets de escucha y las colas de los bucles
+ * @param num_loops Bucles a cerrar
  */
-void free_blocks(size_t num_blocks, const size_t *block_list) {
-    for (size_t i = 0; i < num_blocks; i++) {
-        if (block_list[i] < MAX_BLOCKS && fs.block_map[block_list[i]]) {
-            fs.block_map[block_list[i]] = false;
-            /* Limpiar el contenido del bloque */
-            memset(fs.blocks[block_list[i]], 0, BLOCK_SIZE);
-            fs.used_blocks--;
+static void server_close_loops(size_t num_loops) {
+    for (size_t l = 0; l < num_loops; l++) {
+        ServerLoop *loop = &server.loops[l];
+        if (loop->listen_fd >= 0) {
+            close(loop->listen_fd);
+            unlink(loop->path);
+        }
+        if (loop->to_exec.efd >= 0) {
+            close(loop->to_exec.efd);
+        }
+        if (loop->to_respond.efd >= 0) {
+            close(loop->to_respond.efd);
         }
     }
 }
 
 /**
- * Crea un nuevo archivo en el sistema
- * @param filename Nombre del archivo
- * @param size Tamaño del archivo en bytes
- * @return 0 si es exitoso, -1 en caso de error
+ * Arranca el servidor con varios bucles de eventos. Cada bucle escucha en
+ * su propio socket Unix (el primero en path, los siguientes en path.1,
+ * path.2...), de modo que no comparten cola de accept y cada conexión se
+ * queda en el bucle que la aceptó. La ejecución es común a todos.
+ * @param path Ruta del socket del primer bucle
+ * @param num_loops Número de bucles (1 a SERVER_MAX_LOOPS)
+ * @return 0 si es exitoso, -1 si no se pudo escuchar
  */
-int create_file(const char *filename, size_t size) {
-    /* Validaciones */
-    if (filename == NULL || strlen(filename) == 0) {
-        printf("Error: Nombre de archivo inválido.\n");
-        return -1;
-    }
-    
-    if (size == 0) {
-        printf("Error: El tamano del archivo debe ser mayor que cero.\n");
-        return -1;
-    }
-    
-    if (size > MAX_FILE_SIZE) {
-        printf("Error: El tamano del archivo excede el límite maximo (%d bytes).\n", MAX_FILE_SIZE);
-        return -1;
-    }
-    
-    /* Verificar si el archivo ya existe */
-    if (find_file(filename) != NULL) {
-        printf("Error: El archivo '%s' ya existe.\n", filename);
-        return -1;
-    }
-    
-    /* Verificar si hay espacio para más archivos */
-    if (fs.num_files >= MAX_FILES) {
-        printf("Error: Se ha alcanzado el numero maximo de archivos (%d).\n", MAX_FILES);
-        return -1;
-    }
-    
-    /* Calcular número de bloques necesarios */
-    size_t num_blocks = (size + BLOCK_SIZE - 1) / BLOCK_SIZE;  /* Redondeo hacia arriba */
-    
-    /* Verificar espacio disponible */
-    if (fs.used_blocks + num_blocks > MAX_BLOCKS) {
-        printf("Error: No hay suficiente espacio en el sistema de archivos.\n");
-        printf("  Bloques disponibles: %zu\n", MAX_BLOCKS - fs.used_blocks);
-        printf("  Bloques requeridos: %zu\n", num_blocks);
-        return -1;
-    }
-    
-    /* Buscar una entrada libre en la tabla de archivos */
-    size_t file_index = MAX_FILES;
-    for (size_t i = 0; i < MAX_FILES; i++) {
-        if (!fs.file_table[i].in_use) {
-            file_index = i;
-            break;
+static int server_start(const char *path, size_t num_loops) {
+    for (size_t l = 0; l < num_loops; l++) {
+        ServerLoop *loop = &server.loops[l];
+        struct sockaddr_un addr;
+        int len = l == 0 ? snprintf(loop->path, sizeof(loop->path), "%s", path)
+                         : snprintf(loop->path, sizeof(loop->path), "%s.%zu", path, l);
+        loop->to_exec.efd = -1;
+        loop->to_respond.efd = -1;
+        loop->listen_fd = (size_t)len < sizeof(loop->path)
+                          ? socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0) : -1;
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        memcpy(addr.sun_path, loop->path, sizeof(loop->path));
+        unlink(loop->path);
+        if (loop->listen_fd < 0 ||
+            bind(loop->listen_fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+            listen(loop->listen_fd, SERVER_MAX_CLIENTS) != 0 ||
+            pipe_init(&loop->to_exec) != 0 || pipe_init(&loop->to_respond) != 0) {
+            out_printf("Error: No se pudo escuchar en '%s'.\n", loop->path);
+            server_close_loops(l + 1);
+            return -1;
         }
     }
+    server.num_loops = num_loops;
+    atomic_store(&server.stopping, 0);
     
-    if (file_index == MAX_FILES) {
-        printf("Error: No hay espacio en la tabla de archivos.\n");
-        return -1;
+    /* El aviso sale antes de que haya otros hilos que puedan escribir */
+    for (size_t l = 0; l < num_loops; l++) {
+        out_printf("Servidor escuchando en '%s'.\n", server.loops[l].path);
     }
+    fflush(stdout);
     
-    /* Asignar bloques */
-    size_t allocated = allocate_blocks(num_blocks, fs.file_table[file_index].blocks);
-    if (allocated < num_blocks) {
-        printf("Error: No se pudieron asignar todos los bloques necesarios.\n");
-        /* Liberar bloques ya asignados */
-        if (allocated > 0) {
-            free_blocks(allocated, fs.file_table[file_index].blocks);
-        }
-        return -1;
+    /* Las señales de parada solo llegan al hilo que llamó, que avisa a los demás */
+    sigset_t stop_signals, old_mask;
+    sigemptyset(&stop_signals);
+    sigaddset(&stop_signals, SIGINT);
+    sigaddset(&stop_signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &stop_signals, &old_mask);
+    pthread_create(&server.executor, NULL, server_executor, NULL);
+    for (size_t l = 0; l < num_loops; l++) {
+        pthread_create(&server.loops[l].network, NULL, server_network, &server.loops[l]);
+        pthread_create(&server.loops[l].responder, NULL, server_responder, &server.loops[l]);
     }
-    
-    /* Crear entrada del archivo */
-    strncpy(fs.file_table[file_index].filename, filename, MAX_FILENAME - 1);
-    fs.file_table[file_index].filename[MAX_FILENAME - 1] = '\0';
-    fs.file_table[file_index].size = size;
-    fs.file_table[file_index].num_blocks = num_blocks;
-    fs.file_table[file_index].in_use = true;
-    
-    fs.num_files++;
-    fs.total_storage += size;
-    
-    printf("Archivo '%s' creado exitosamente (%zu bytes, %zu bloques).\n", 
-           filename, size, num_blocks);
+    pthread_sigmask(SIG_SETMASK, &old_mask, NULL);
     return 0;
 }
 
 /**
- * Escribe datos en un archivo
- * @param filename Nombre del archivo
- * @param offset Offset donde comenzar a escribir
- * @param data Datos a escribir
- * @return 0 si es exitoso, -1 en caso de error
+ * Para el servidor: cada bucle libera sus conexiones y cierra su tubería,
+ * y se espera a todos los hilos
  */
-int write_file(const char *filename, size_t offset, const char *data) {
-    if (filename == NULL || data == NULL) {
-        printf("Error: Parámetros inválidos.\n");
-        return -1;
-    }
-    
-    /* Buscar el archivo */
-    FileEntry *file = find_file(filename);
-    if (file == NULL) {
-        printf("Error: El archivo '%s' no existe.\n", filename);
-        return -1;
+static void server_stop(void) {
+    atomic_store(&server.stopping, 1);
+    for (size_t l = 0; l < server.num_loops; l++) {
+        pthread_join(server.loops[l].network, NULL);
     }
-    
-    /* Validar offset */
-    if (offset > file->size) {
-        printf("Error: Offset (%zu) excede el tamano del archivo (%zu bytes).\n", 
-               offset, file->size);
-        return -1;
+    pthread_join(server.executor, NULL);
+    for (size_t l = 0; l < server.num_loops; l++) {
+        pthread_join(server.loops[l].responder, NULL);
     }
-    
-    size_t data_len = strlen(data);
-    
-    /* Validar que no se exceda el tamaño del archivo */
-    if (offset + data_len > file->size) {
-        printf("Error: La escritura excede el tamano del archivo.\n");
-        printf("  Tamano del archivo: %zu bytes\n", file->size);
-        printf("  Intento de escritura: offset %zu + %zu bytes\n", offset, data_len);
+    server_close_loops(server.num_loops);
+    server.num_loops = 0;
+}
+
+/**
+ * Señal de parada del servidor
+ * @param sig Señal recibida
+ */
+static void server_on_signal(int sig) {
+    (void)sig;
+    atomic_store(&server.stopping, 1);
+}
+
+/**
+ * Modo servidor: atiende clientes por sockets Unix. Cada cliente envía
+ * comandos por líneas y recibe la misma salida que la consola, terminada
+ * por una línea ".". Los eventos de WATCH llegan como líneas "EVENT ..."
+ * entre respuestas. Las peticiones recorren tres etapas en hilos
+ * distintos unidas por colas sin bloqueos: red y análisis, y respuesta,
+ * propias de cada bucle, y ejecución, común a todos.
+ * @param path Ruta del socket (del primer bucle)
+ * @param num_loops Número de bucles de eventos
+ * @return 0 al terminar (SIGINT/SIGTERM), -1 si no se pudo escuchar
+ */
+int server_run(const char *path, size_t num_loops) {
+    signal(SIGPIPE, SIG_IGN);
+    signal(SIGINT, server_on_signal);
+    signal(SIGTERM, server_on_signal);
+    if (server_start(path, num_loops) != 0) {
         return -1;
     }
     
-    /* Calcular en qué bloque y posición dentro del bloque comenzar */
-    size_t start_block = offset / BLOCK_SIZE;
-    size_t start_pos = offset % BLOCK_SIZE;
-    
-    size_t bytes_written = 0;
-    size_t current_block = start_block;
-    size_t current_pos = start_pos;
-    
-    /* Escribir los datos bloque por bloque */
-    while (bytes_written < data_len && current_block < file->num_blocks) {
-        size_t block_index = file->blocks[current_block];
-        size_t bytes_to_write = data_len - bytes_written;
-        
-        /* Limitar la escritura al espacio disponible en el bloque actual */
-        if (current_pos + bytes_to_write > BLOCK_SIZE) {
-            bytes_to_write = BLOCK_SIZE - current_pos;
-        }
-        
-        /* Escribir en el bloque */
-        memcpy(&fs.blocks[block_index][current_pos], 
-               &data[bytes_written], 
-               bytes_to_write);
-        
-        bytes_written += bytes_to_write;
-        current_block++;
-        current_pos = 0;
+    while (!atomic_load(&server.stopping)) {
+        poll(NULL, 0, 200);  /* La señal interrumpe la espera */
     }
-    
-    printf("Escritos %zu bytes en '%s' (offset %zu).\n", 
-           bytes_written, filename, offset);
+    server_stop();
+    out_printf("Servidor detenido.\n");
     return 0;
 }
 
 /**
- * Lee datos de un archivo
- * @param filename Nombre del archivo
- * @param offset Offset donde comenzar a leer
- * @param size Cantidad de bytes a leer
- * @param buffer Buffer donde almacenar los datos leídos
- * @return 0 si es exitoso, -1 en caso de error
+ * Cliente de la prueba del servidor: crea su archivo y alterna WRITE y
+ * READ sobre él, con BENCH_SERVER_DEPTH comandos en vuelo
+ * @param arg Ruta del socket al que conectarse
+ * @return NULL si terminó todos sus comandos, arg si falló
  */
-int read_file(const char *filename, size_t offset, size_t size, char *buffer) {
-    if (filename == NULL || buffer == NULL || size == 0) {
-        printf("Error: Parámetros inválidos.\n");
-        return -1;
-    }
-    
-    /* Buscar el archivo */
-    FileEntry *file = find_file(filename);
-    if (file == NULL) {
-        printf("Error: El archivo '%s' no existe.\n", filename);
-        return -1;
-    }
-    
-    /* Validar offset */
-    if (offset >= file->size) {
-        printf("Error: Offset (%zu) excede el tamano del archivo (%zu bytes).\n", 
-               offset, file->size);
-        return -1;
+static void *bench_server_client(void *arg) {
+    const char *path = arg;
+    static atomic_uint next_id;
+    unsigned int id = atomic_fetch_add(&next_id, 1);
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", path);
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0 || connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        if (fd >= 0) {
+            close(fd);
+        }
+        return arg;
     }
     
-    /* Ajustar el tamaño a leer si se excede el tamaño del archivo */
-    size_t bytes_to_read = size;
-    if (offset + bytes_to_read > file->size) {
-        bytes_to_read = file->size - offset;
-        printf("Advertencia: Se leerán %zu bytes en lugar de %zu (fin del archivo).\n", 
-               bytes_to_read, size);
+    char out[BENCH_SERVER_DEPTH * 64];
+    char in[4096];
+    size_t sent = 0, answered = 0, line_len = 0;
+    char first = 0;
+    int len = snprintf(out, sizeof(out), "CREATE bench%u 64\n", id);
+    bool ok = send_all(fd, out, (size_t)len) == 0;
+    sent = 1;
+    while (ok && answered < BENCH_SERVER_OPS + 1) {
+        /* Rellenar hasta BENCH_SERVER_DEPTH comandos pendientes */
+        len = 0;
+        while (sent < BENCH_SERVER_OPS + 1 && sent - answered < BENCH_SERVER_DEPTH) {
+            len += sent % 2 == 0
+                   ? snprintf(out + len, sizeof(out) - (size_t)len, "WRITE bench%u 0 \"%zu\"\n", id, sent)
+                   : snprintf(out + len, sizeof(out) - (size_t)len, "READ bench%u 0 4\n", id);
+            sent++;
+        }
+        if (len > 0 && send_all(fd, out, (size_t)len) != 0) {
+            break;
+        }
+        
+        /* Contar las líneas "." que cierran cada respuesta */
+        ssize_t n = recv(fd, in, sizeof(in), 0);
+        ok = n > 0;
+        for (ssize_t i = 0; i < n; i++) {
+            if (in[i] == '\n') {
+                answered += line_len == 1 && first == '.';
+                line_len = 0;
+            } else {
+                first = line_len == 0 ? in[i] : first;
+                line_len++;
+            }
+        }
     }
+    close(fd);
+    return ok ? NULL : arg;
+}
+
+/**
+ * Mide comandos por segundo del servidor con 1, 2, 4... bucles de eventos
+ * y BENCH_SERVER_CLIENTS clientes repartidos entre sus sockets
+ */
+void bench_server(void) {
+    char path[64];
+    snprintf(path, sizeof(path), "/tmp/fs_bench_%d.sock", (int)getpid());
     
-    /* Calcular en qué bloque y posición dentro del bloque comenzar */
-    size_t start_block = offset / BLOCK_SIZE;
-    size_t start_pos = offset % BLOCK_SIZE;
-    
-    size_t bytes_read = 0;
-    size_t current_block = start_block;
-    size_t current_pos = start_pos;
-    
-    /* Leer los datos bloque por bloque */
-    while (bytes_read < bytes_to_read && current_block < file->num_blocks) {
-        size_t block_index = file->blocks[current_block];
-        size_t bytes_to_read_now = bytes_to_read - bytes_read;
-        
-        /* Limitar la lectura al espacio disponible en el bloque actual */
-        if (current_pos + bytes_to_read_now > BLOCK_SIZE) {
-            bytes_to_read_now = BLOCK_SIZE - current_pos;
+    out_printf("\nServidor: %d clientes x %d comandos (WRITE/READ, %d en vuelo), %ld CPU(s)\n\n",
+               BENCH_SERVER_CLIENTS, BENCH_SERVER_OPS, BENCH_SERVER_DEPTH, sysconf(_SC_NPROCESSORS_ONLN));
+    out_printf("%-7s %12s %12s %10s\n", "Bucles", "comandos/s", "lote medio", "fallos");
+    signal(SIGPIPE, SIG_IGN);
+    for (size_t loops = 1; loops <= SERVER_MAX_LOOPS; loops *= 2) {
+        reset_filesystem(ALLOC_FIRST_FIT);
+        server.batches = server.requests = 0;
+        if (server_start(path, loops) != 0) {
+            return;
         }
         
-        /* Leer del bloque */
-        memcpy(&buffer[bytes_read], 
-               &fs.blocks[block_index][current_pos], 
-               bytes_to_read_now);
+        pthread_t clients[BENCH_SERVER_CLIENTS];
+        long long t0 = now_ns();
+        for (size_t i = 0; i < BENCH_SERVER_CLIENTS; i++) {
+            pthread_create(&clients[i], NULL, bench_server_client, server.loops[i % loops].path);
+        }
+        size_t failed = 0;
+        for (size_t i = 0; i < BENCH_SERVER_CLIENTS; i++) {
+            void *result;
+            pthread_join(clients[i], &result);
+            failed += result != NULL;
+        }
+        long long elapsed = now_ns() - t0;
         
-        bytes_read += bytes_to_read_now;
-        current_block++;
-        current_pos = 0;
+        out_printf("%-7zu %12.0f %12.1f %10zu\n", loops,
+                   (double)BENCH_SERVER_CLIENTS * (BENCH_SERVER_OPS + 1) * 1e9 / (double)elapsed,
+                   server.batches > 0 ? (double)server.requests / (double)server.batches : 0.0, failed);
+        server_stop();
     }
-    
-    buffer[bytes_read] = '\0';  /* Agregar terminador de cadena */
-    
-    printf("Leídos %zu bytes de '%s' (offset %zu).\n", 
-           bytes_read, filename, offset);
-    return 0;
 }
 
+#ifdef FS_TEST_HOOKS
 /**
- * Elimina un archivo del sistema
- * @param filename Nombre del archivo a eliminar
- * @return 0 si es exitoso, -1 en caso de error
+ * Lee del servidor una respuesta y la escribe hasta su línea "." incluida,
+ * precedida de las líneas EVENT que lleguen antes. Los datos de EXPORT se
+ * escriben en una línea, con los bytes no imprimibles como '.'.
+ * @param replies Socket del servidor
+ * @return true si llegó la respuesta completa, false si se desconectó
  */
-int delete_file(const char *filename) {
-    if (filename == NULL) {
-        printf("Error: Nombre de archivo inválido.\n");
-        return -1;
-    }
-    
-    /* Buscar el archivo */
-    FileEntry *file = find_file(filename);
-    if (file == NULL) {
-        printf("Error: El archivo '%s' no existe.\n", filename);
-        return -1;
+static bool test_client_reply(FILE *replies) {
+    char line[1024];
+    for (;;) {
+        if (fgets(line, sizeof(line), replies) == NULL) {
+            return false;
+        }
+        fputs(line, stdout);
+        size_t len;
+        if (sscanf(line, "DATA %zu", &len) == 1) {
+            int c;
+            for (size_t i = 0; i < len && (c = fgetc(replies)) != EOF; i++) {
+                putchar(c >= ' ' && c < 127 ? c : '.');
+            }
+            putchar('\n');
+        } else if (strcmp(line, ".\n") == 0) {
+            return true;
+        }
     }
-    
-    /* Liberar bloques */
-    free_blocks(file->num_blocks, file->blocks);
-    
-    /* Actualizar estadísticas */
-    fs.total_storage -= file->size;
-    fs.num_files--;
-    
-    /* Limpiar entrada */
-    file->in_use = false;
-    file->filename[0] = '\0';
-    file->size = 0;
-    file->num_blocks = 0;
-    
-    printf("Archivo '%s' eliminado exitosamente.\n", filename);
-    return 0;
 }
 
 /**
- * Lista todos los archivos en el sistema
+ * Cliente de pruebas del servidor (--connect): envía cada línea de la
+ * entrada y escribe su respuesta. Con --pipeline envía toda la entrada de
+ * una vez (hasta 64 KB) y después lee una respuesta por línea, como un
+ * cliente que encadena comandos sin esperar. Es un gancho de pruebas: solo existe al
+ * compilar con -DFS_TEST_HOOKS (make test).
+ * @param path Socket del servidor
+ * @param pipeline true para enviar toda la entrada antes de leer
+ * @return 0 si es exitoso, -1 si no se pudo conectar
  */
-void list_files(void) {
-    if (fs.num_files == 0) {
-        printf("(no hay archivos)\n");
-        return;
+static int test_client(const char *path, bool pipeline) {
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", path);
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    FILE *replies = NULL;
+    if (fd < 0 || connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+        (replies = fdopen(fd, "r")) == NULL) {
+        fprintf(stderr, "Error: No se pudo conectar a '%s'.\n", path);
+        if (fd >= 0) {
+            close(fd);
+        }
+        return -1;
     }
     
-    printf("\nArchivos en el sistema:\n");
-    printf("----------------------------------------\n");
-    printf("%-30s %12s\n", "Nombre", "Tamano (bytes)");
-    printf("----------------------------------------\n");
-    
-    for (size_t i = 0; i < MAX_FILES; i++) {
-        if (fs.file_table[i].in_use) {
-            printf("%-30s %12zu\n", 
-                   fs.file_table[i].filename, 
-                   fs.file_table[i].size);
+    char command[1024];
+    static char pending[64 * 1024];
+    size_t pending_len = 0;
+    size_t pending_replies = 0;
+    bool connected = true;
+    while (connected && fgets(command, sizeof(command), stdin) != NULL) {
+        if (command[0] == '\n') {
+            continue;  /* Una línea vacía no tiene respuesta */
+        }
+        size_t len = strlen(command);
+        if (pipeline) {
+            if (pending_len + len > sizeof(pending)) {
+                fprintf(stderr, "Error: La entrada de --pipeline supera %zu bytes.\n", sizeof(pending));
+                break;
+            }
+            memcpy(pending + pending_len, command, len);
+            pending_len += len;
+            pending_replies++;
+            continue;
         }
+        connected = send_all(fd, command, len) == 0 && test_client_reply(replies);
     }
-    
-    printf("----------------------------------------\n");
-    printf("Total: %zu archivo(s), %zu bytes, %zu bloques utilizados\n\n", 
-           fs.num_files, fs.total_storage, fs.used_blocks);
+    if (connected && pending_len > 0 && send_all(fd, pending, pending_len) == 0) {
+        while (pending_replies > 0 && test_client_reply(replies)) {
+            pending_replies--;
+        }
+    }
+    fclose(replies);
+    return 0;
 }
+#endif
 
 /**
  * Función principal - Interfaz de línea de comandos
+ * @param argc Número de argumentos
+ * @param argv Argumentos: [--policy=<politica>] [--parity[=1|2]] [--store=anon|memfd] [--size=<KB>]
+ *             [--physical=<KB>] [--mount=<imagen> | --base=<imagen>] [--mirror=<imagen>]
+ *             [--primary=<socket> | --follow=<socket>] [--serve=<socket>] [--loops=<N>]
+ *             [--cold=<segundos>] [--bench]
  */
-int main(void) {
+int main(int argc, char *argv[]) {
     char command[1024];
-    char filename[MAX_FILENAME];
-    char data[10240];  /* Buffer para datos */
-    char buffer[10240];  /* Buffer para lectura */
-    size_t size, offset;
+    size_t size;
+    AllocPolicy policy = ALLOC_FIRST_FIT;
+    const char *mount_path = NULL;
+    const char *base_path = NULL;
+    const char *mirror_path = NULL;
+    const char *primary_path = NULL;
+    const char *follow_path = NULL;
+    const char *serve_path = NULL;
+    size_t serve_loops = 1;
+#ifdef FS_TEST_HOOKS
+    const char *connect_path = NULL;
+    bool pipeline = false;
+#endif
+    size_t cold_seconds = 0;
+    StoreKind store_kind = STORE_ANON;
+    bool bench = false;
+    size_t physical_kb;
+    
+    parity_tables_init();
     
-    printf("========================================\n");
-    printf("   Sistema de Archivos Simple v1.0\n");
-    printf("========================================\n\n");
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--bench") == 0) {
+            bench = true;
+        } else if (strcmp(argv[i], "--store=memfd") == 0) {
+            store_kind = STORE_MEMFD;
+        } else if (strcmp(argv[i], "--store=anon") == 0) {
+            store_kind = STORE_ANON;
+        } else if (strncmp(argv[i], "--policy=", 9) == 0 &&
+                   policy_from_name(argv[i] + 9, &policy)) {
+            continue;
+        } else if (strcmp(argv[i], "--parity=1") == 0 || strcmp(argv[i], "--parity") == 0) {
+            parity.level = 1;
+        } else if (strcmp(argv[i], "--parity=2") == 0) {
+            parity.level = 2;
+        } else if (strncmp(argv[i], "--physical=", 11) == 0 &&
+                   (physical_kb = strtoul(argv[i] + 11, NULL, 10)) > 0) {
+            /* Los KB se comparan antes de multiplicar para no desbordar */
+            thin.physical_blocks = physical_kb < MAX_STORAGE / 1024 ?
+                                   physical_kb * 1024 / BLOCK_SIZE : MAX_BLOCKS;
+        } else if (strncmp(argv[i], "--size=", 7) == 0 &&
+                   (size = strtoul(argv[i] + 7, NULL, 10)) > 0 &&
+                   size <= MAX_STORAGE / 1024) {
+            initial_blocks = size * 1024 / BLOCK_SIZE > 0 ? size * 1024 / BLOCK_SIZE : 1;
+        } else if (strncmp(argv[i], "--mount=", 8) == 0) {
+            mount_path = argv[i] + 8;
+        } else if (strncmp(argv[i], "--base=", 7) == 0) {
+            base_path = argv[i] + 7;
+        } else if (strncmp(argv[i], "--mirror=", 9) == 0) {
+            mirror_path = argv[i] + 9;
+        } else if (strncmp(argv[i], "--primary=", 10) == 0) {
+            primary_path = argv[i] + 10;
+        } else if (strncmp(argv[i], "--follow=", 9) == 0) {
+            follow_path = argv[i] + 9;
+        } else if (strncmp(argv[i], "--serve=", 8) == 0) {
+            serve_path = argv[i] + 8;
+        } else if (strncmp(argv[i], "--loops=", 8) == 0 &&
+                   (serve_loops = strtoul(argv[i] + 8, NULL, 10)) >= 1 &&
+                   serve_loops <= SERVER_MAX_LOOPS) {
+            continue;
+        } else if (strncmp(argv[i], "--cold=", 7) == 0 &&
+                   (cold_seconds = strtoul(argv[i] + 7, NULL, 10)) > 0 && cold_seconds <= COLD_MAX_SECONDS) {
+            continue;
+        }
+#ifdef FS_TEST_HOOKS
+        else if (strncmp(argv[i], "--connect=", 10) == 0) {
+            connect_path = argv[i] + 10;
+        } else if (strcmp(argv[i], "--pipeline") == 0) {
+            pipeline = true;
+        }
+#endif
+        else {
+            fprintf(stderr, "Uso: %s [--policy=first-fit|next-fit|best-fit|locality|buddy] [--parity[=1|2]]\n"
+                    "          [--store=anon|memfd] [--size=<KB>] [--physical=<KB>]\n"
+                    "          [--mount=<imagen> | --base=<imagen>] [--mirror=<imagen>]\n"
+                    "          [--primary=<socket> | --follow=<socket>] [--serve=<socket>] [--loops=1-%d]\n"
+                    "          [--cold=<segundos>] [--bench]\n", argv[0], SERVER_MAX_LOOPS);
+            return 1;
+        }
+    }
+    
+    if (mount_path != NULL && base_path != NULL) {
+        fprintf(stderr, "Error: --mount y --base son excluyentes.\n");
+        return 1;
+    }
+    if (cold_seconds > 0 && follow_path != NULL) {
+        fprintf(stderr, "Error: --cold y --follow son excluyentes (la replica recibe el nivel frio del primario).\n");
+        return 1;
+    }
+#ifdef FS_TEST_HOOKS
+    if (connect_path != NULL) {
+        return test_client(connect_path, pipeline) == 0 ? 0 : 1;
+    }
+#endif
+    if (block_store_init(store_kind) != 0) {
+        return 1;
+    }
+    if (bench) {
+        run_benchmark();
+        return 0;
+    }
+    
+    out_printf("========================================\n");
+    out_printf("   Sistema de Archivos Simple v1.0\n");
+    out_printf("========================================\n\n");
     
-    init_filesystem();
+    init_filesystem(policy);
+    if (mount_path != NULL && mount_image(mount_path, false) != 0) {
+        return 1;
+    }
+    if (base_path != NULL && mount_image(base_path, true) != 0) {
+        return 1;
+    }
+    if (mirror_path != NULL && mirror_start(mirror_path) != 0) {
+        return 1;
+    }
+    if (primary_path != NULL && repl_start_primary(primary_path) != 0) {
+        return 1;
+    }
+    if (follow_path != NULL && repl_start_follower(follow_path) != 0) {
+        return 1;
+    }
+    if (cold_seconds > 0 && cold_start(cold_seconds) != 0) {
+        return 1;
+    }
     
-    printf("Comandos disponibles:\n");
-    printf("  CREATE <archivo> <tamano>\n");
-    printf("  WRITE <archivo> <offset> \"<datos>\"\n");
-    printf("  READ <archivo> <offset> <tamano>\n");
-    printf("  DELETE <archivo>\n");
-    printf("  LIST\n");
-    printf("  EXIT\n\n");
+    out_printf("Comandos disponibles:\n");
+    out_printf("  CREATE <archivo> <tamano>\n");
+    out_printf("  WRITE <archivo> <offset> \"<datos>\"\n");
+    out_printf("  READ <archivo> <offset> <tamano>\n");
+    out_printf("  FALLOCATE <archivo> <offset> <longitud>\n");
+    out_printf("  PUNCH <archivo> <offset> <longitud>\n");
+    out_printf("  DELETE <archivo>\n");
+    out_printf("  DELETE-MATCH <patron>\n");
+    out_printf("  LIST\n");
+    out_printf("  MAPVIEW <archivo>\n");
+    out_printf("  MEMSTAT\n");
+    out_printf("  TRAINDICT [patron]\n");
+    out_printf("  GROW <KB>\n");
+    out_printf("  FORMAT\n");
+    out_printf("  BGSAVE <imagen>\n");
+    out_printf("  MIRROR\n");
+    out_printf("  REPLICA\n");
+    out_printf("  WATCH <archivo|patron> / UNWATCH (modo servidor)\n");
+    out_printf("  EXPORT <archivo> (modo servidor)\n");
+    out_printf("  EXIT\n\n");
     
-    while (1) {
-        printf("> ");
+    bgsave_prepare_memory();
+    
+    while (serve_path == NULL) {
+        bgsave_poll(false);
+        out_printf("> ");
         if (fgets(command, sizeof(command), stdin) == NULL) {
             break;
         }
@@ -497,38 +7490,17 @@ int main(void) {
             continue;
         }
         
-        /* Procesar comando CREATE */
-        if (sscanf(command, "CREATE %s %zu", filename, &size) == 2) {
-            create_file(filename, size);
-        }
-        /* Procesar comando WRITE */
-        else if (sscanf(command, "WRITE %s %zu \"%[^\"]\"", filename, &offset, data) == 3) {
-            write_file(filename, offset, data);
-        }
-        /* Procesar comando READ */
-        else if (sscanf(command, "READ %s %zu %zu", filename, &offset, &size) == 3) {
-            if (read_file(filename, offset, size, buffer) == 0) {
-                printf("Salida: \"%s\"\n", buffer);
-            }
-        }
-        /* Procesar comando DELETE */
-        else if (sscanf(command, "DELETE %s", filename) == 1) {
-            delete_file(filename);
-        }
-        /* Procesar comando LIST */
-        else if (strcmp(command, "LIST") == 0) {
-            list_files();
-        }
-        /* Procesar comando EXIT */
-        else if (strcmp(command, "EXIT") == 0 || strcmp(command, "QUIT") == 0) {
-            printf("Saliendo del sistema de archivos...\n");
+        if (!execute_command(command)) {
             break;
         }
-        /* Comando no reconocido */
-        else {
-            printf("Error: Comando no reconocido. Use CREATE, WRITE, READ, DELETE, LIST o EXIT.\n");
-        }
+    }
+    if (serve_path != NULL && server_run(serve_path, serve_loops) != 0) {
+        return 1;
     }
     
+    bgsave_poll(true);
+    cold_stop();
+    mirror_stop();
+    repl_stop();
     return 0;
 }
@@ -0,0 +1,24 @@
+CREATE notas.txt 1200
+WRITE notas.txt 0 "Hola mundo"
+READ notas.txt 0 10
+WRITE notas.txt 500 "bipw3ahov29gnu18fmt07elsz6dkry5cjqx4bipw"
+READ notas.txt 500 40
+READ notas.txt 505 20
+WRITE notas.txt 1190 "fin del ar"
+WRITE notas.txt 1190 "fin del archivo y algo mas"
+READ notas.txt 1190 26
+READ notas.txt 1210 10
+READ notas.txt 4000 10
+WRITE notas.txt 5000 "x"
+CREATE notas.txt 10
+CREATE vacio.txt 0
+CREATE otro.txt 100
+WRITE otro.txt 0 "segundo archivo"
+READ otro.txt 0 15
+READ nada.txt 0 1
+LIST
+DELETE notas.txt
+DELETE notas.txt
+READ otro.txt 0 15
+LIST
+EXIT
@@ -0,0 +1,12 @@
+# BGSAVE: el hijo guarda la imagen tal como estaba al hacer fork mientras
+# el padre sigue escribiendo; después se monta la imagen y se comprueba
+# que no contiene los cambios posteriores. El aviso de fin sale en el
+# primer comando tras terminar el hijo, así que se comprueba aparte.
+printf '%s\n' 'CREATE a.txt 1000' 'WRITE a.txt 0 "antes del fork"' \
+    'CREATE b/c.txt 5000' "BGSAVE $TMP/fondo.img" 'WRITE a.txt 0 "tras el fork!!"' \
+    'DELETE b/c.txt' '#sleep 1' 'LIST' |
+    feed /dev/stdin | "$FS" > "$TMP/bgsave" 2>&1
+sed -e "s|$TMP|\$TMP|g" -e 's/pid [0-9][0-9]*/pid <pid>/' -e '/^BGSAVE completado/d' "$TMP/bgsave"
+echo "Completados: $(grep -c "^BGSAVE completado: '$TMP/fondo.img'" "$TMP/bgsave")"
+printf 'LIST\nREAD a.txt 0 14\nREAD b/c.txt 0 4\n' |
+    "$FS" --mount="$TMP/fondo.img" 2>&1 | sed '1,/^  EXIT$/d'
@@ -0,0 +1,38 @@
+CREATE logs/app.log 6000
+WRITE logs/app.log 0 "app 2026-10-18 12:00:00 INFO servicio peticion 0 atendida en 0 ms;2026-10-18 12:01:07 INFO servicio peticion 1 atendida en 1 ms;2026-10-18 12:02:14 INFO servicio peticion 2 atendida en 2 ms;2026-10-18 12:03:21 INFO servicio peticion 3 atendida en 3 ms;2026-10-18 12:04:28 INFO servicio peticion 4 atendida en 4 ms;2026-10-18 12:05:35 INFO servicio peticion 5 atendida en 5 ms;2026-10-18 12:06:42 INFO servicio peticion 6 atendida en 6 ms;2026-10-18 12:07:49 INFO servicio peticion 7 atendida en 7 ms;2026-10-18 12:08:56 INFO servicio peticion 8 atendida en 8 ms;2026-10-18 12:09:03 INFO servicio peticion 9 atendida en 9 ms;2026-10-18 12:10:10 INFO servicio peticion 10 atendida en 10 ms;2026-10-18 12:11:17 INFO servicio peticion 11 atendida en 11 ms;2026-10-18 12:12:24 INFO servicio peticion 12 atendida en 12 ms;2026-10-18 12:13:31 INFO servicio peticion 13 atendida en 0 ms;2026-10-18 12:14:38 INFO "
+WRITE logs/app.log 1000 "app ;2026-10-18 12:16:52 INFO servicio peticion 16 atendida en 3 ms;2026-10-18 12:17:59 INFO servicio peticion 17 atendida en 4 ms;2026-10-18 12:18:06 INFO servicio peticion 18 atendida en 5 ms;2026-10-18 12:19:13 INFO servicio peticion 19 atendida en 6 ms;2026-10-18 12:20:20 INFO servicio peticion 20 atendida en 7 ms;2026-10-18 12:21:27 INFO servicio peticion 21 atendida en 8 ms;2026-10-18 12:22:34 INFO servicio peticion 22 atendida en 9 ms;2026-10-18 12:23:41 INFO servicio peticion 23 atendida en 10 ms;2026-10-18 12:24:48 INFO servicio peticion 24 atendida en 11 ms;2026-10-18 12:25:55 INFO servicio peticion 25 atendida en 12 ms;2026-10-18 12:26:02 INFO servicio peticion 26 atendida en 0 ms;2026-10-18 12:27:09 INFO servicio peticion 27 atendida en 1 ms;2026-10-18 12:28:16 INFO servicio peticion 28 atendida en 2 ms;2026-10-18 12:29:23 INFO servicio peticion 29 atendida en 3 ms;2026-10-18 12:"
+WRITE logs/app.log 2000 "app ida en 5 ms;2026-10-18 12:32:44 INFO servicio peticion 32 atendida en 6 ms;2026-10-18 12:33:51 INFO servicio peticion 33 atendida en 7 ms;2026-10-18 12:34:58 INFO servicio peticion 34 atendida en 8 ms;2026-10-18 12:35:05 INFO servicio peticion 35 atendida en 9 ms;2026-10-18 12:36:12 INFO servicio peticion 36 atendida en 10 ms;2026-10-18 12:37:19 INFO servicio peticion 37 atendida en 11 ms;2026-10-18 12:38:26 INFO servicio peticion 38 atendida en 12 ms;2026-10-18 12:39:33 INFO servicio peticion 39 atendida en 0 ms;2026-10-18 12:40:40 INFO servicio peticion 40 atendida en 1 ms;2026-10-18 12:41:47 INFO servicio peticion 41 atendida en 2 ms;2026-10-18 12:42:54 INFO servicio peticion 42 atendida en 3 ms;2026-10-18 12:43:01 INFO servicio peticion 43 atendida en 4 ms;2026-10-18 12:44:08 INFO servicio peticion 44 atendida en 5 ms;2026-10-18 12:45:15 INFO servicio peticion 45 atendida en 6 ms;202"
+WRITE logs/app.log 3000 "app on 47 atendida en 8 ms;2026-10-18 12:48:36 INFO servicio peticion 48 atendida en 9 ms;2026-10-18 12:49:43 INFO servicio peticion 49 atendida en 10 ms;2026-10-18 12:50:50 INFO servicio peticion 50 atendida en 11 ms;2026-10-18 12:51:57 INFO servicio peticion 51 atendida en 12 ms;2026-10-18 12:52:04 INFO servicio peticion 52 atendida en 0 ms;2026-10-18 12:53:11 INFO servicio peticion 53 atendida en 1 ms;2026-10-18 12:54:18 INFO servicio peticion 54 atendida en 2 ms;2026-10-18 12:55:25 INFO servicio peticion 55 atendida en 3 ms;2026-10-18 12:56:32 INFO servicio peticion 56 atendida en 4 ms;2026-10-18 12:57:39 INFO servicio peticion 57 atendida en 5 ms;2026-10-18 12:58:46 INFO servicio peticion 58 atendida en 6 ms;2026-10-18 12:59:53 INFO servicio peticion 59 atendida en 7 ms;2026-10-18 12:00:00 INFO servicio peticion 60 atendida en 8 ms;2026-10-18 12:01:07 INFO servicio peticion 61 atendida "
+WRITE logs/app.log 4000 "app vicio peticion 63 atendida en 11 ms;2026-10-18 12:04:28 INFO servicio peticion 64 atendida en 12 ms;2026-10-18 12:05:35 INFO servicio peticion 65 atendida en 0 ms;2026-10-18 12:06:42 INFO servicio peticion 66 atendida en 1 ms;2026-10-18 12:07:49 INFO servicio peticion 67 atendida en 2 ms;2026-10-18 12:08:56 INFO servicio peticion 68 atendida en 3 ms;2026-10-18 12:09:03 INFO servicio peticion 69 atendida en 4 ms;2026-10-18 12:10:10 INFO servicio peticion 70 atendida en 5 ms;2026-10-18 12:11:17 INFO servicio peticion 71 atendida en 6 ms;2026-10-18 12:12:24 INFO servicio peticion 72 atendida en 7 ms;2026-10-18 12:13:31 INFO servicio peticion 73 atendida en 8 ms;2026-10-18 12:14:38 INFO servicio peticion 74 atendida en 9 ms;2026-10-18 12:15:45 INFO servicio peticion 75 atendida en 10 ms;2026-10-18 12:16:52 INFO servicio peticion 76 atendida en 11 ms;2026-10-18 12:17:59 INFO servicio peticion"
+WRITE logs/app.log 5000 "app 9:13 INFO servicio peticion 79 atendida en 1 ms;2026-10-18 12:20:20 INFO servicio peticion 80 atendida en 2 ms;2026-10-18 12:21:27 INFO servicio peticion 81 atendida en 3 ms;2026-10-18 12:22:34 INFO servicio peticion 82 atendida en 4 ms;2026-10-18 12:23:41 INFO servicio peticion 83 atendida en 5 ms;2026-10-18 12:24:48 INFO servicio peticion 84 atendida en 6 ms;2026-10-18 12:25:55 INFO servicio peticion 85 atendida en 7 ms;2026-10-18 12:26:02 INFO servicio peticion 86 atendida en 8 ms;2026-10-18 12:27:09 INFO servicio peticion 87 atendida en 9 ms;2026-10-18 12:28:16 INFO servicio peticion 88 atendida en 10 ms;2026-10-18 12:29:23 INFO servicio peticion 89 atendida en 11 ms;2026-10-18 12:30:30 INFO servicio peticion 90 atendida en 12 ms;2026-10-18 12:31:37 INFO servicio peticion 91 atendida en 0 ms;2026-10-18 12:32:44 INFO servicio peticion 92 atendida en 1 ms;2026-10-18 12:33:51 INFO servi"
+CREATE logs/web.log 6000
+WRITE logs/web.log 0 "web 2026-10-18 12:00:00 INFO servicio peticion 0 atendida en 0 ms;2026-10-18 12:01:07 INFO servicio peticion 1 atendida en 1 ms;2026-10-18 12:02:14 INFO servicio peticion 2 atendida en 2 ms;2026-10-18 12:03:21 INFO servicio peticion 3 atendida en 3 ms;2026-10-18 12:04:28 INFO servicio peticion 4 atendida en 4 ms;2026-10-18 12:05:35 INFO servicio peticion 5 atendida en 5 ms;2026-10-18 12:06:42 INFO servicio peticion 6 atendida en 6 ms;2026-10-18 12:07:49 INFO servicio peticion 7 atendida en 7 ms;2026-10-18 12:08:56 INFO servicio peticion 8 atendida en 8 ms;2026-10-18 12:09:03 INFO servicio peticion 9 atendida en 9 ms;2026-10-18 12:10:10 INFO servicio peticion 10 atendida en 10 ms;2026-10-18 12:11:17 INFO servicio peticion 11 atendida en 11 ms;2026-10-18 12:12:24 INFO servicio peticion 12 atendida en 12 ms;2026-10-18 12:13:31 INFO servicio peticion 13 atendida en 0 ms;2026-10-18 12:14:38 INFO "
+WRITE logs/web.log 1000 "web ;2026-10-18 12:16:52 INFO servicio peticion 16 atendida en 3 ms;2026-10-18 12:17:59 INFO servicio peticion 17 atendida en 4 ms;2026-10-18 12:18:06 INFO servicio peticion 18 atendida en 5 ms;2026-10-18 12:19:13 INFO servicio peticion 19 atendida en 6 ms;2026-10-18 12:20:20 INFO servicio peticion 20 atendida en 7 ms;2026-10-18 12:21:27 INFO servicio peticion 21 atendida en 8 ms;2026-10-18 12:22:34 INFO servicio peticion 22 atendida en 9 ms;2026-10-18 12:23:41 INFO servicio peticion 23 atendida en 10 ms;2026-10-18 12:24:48 INFO servicio peticion 24 atendida en 11 ms;2026-10-18 12:25:55 INFO servicio peticion 25 atendida en 12 ms;2026-10-18 12:26:02 INFO servicio peticion 26 atendida en 0 ms;2026-10-18 12:27:09 INFO servicio peticion 27 atendida en 1 ms;2026-10-18 12:28:16 INFO servicio peticion 28 atendida en 2 ms;2026-10-18 12:29:23 INFO servicio peticion 29 atendida en 3 ms;2026-10-18 12:"
+WRITE logs/web.log 2000 "web ida en 5 ms;2026-10-18 12:32:44 INFO servicio peticion 32 atendida en 6 ms;2026-10-18 12:33:51 INFO servicio peticion 33 atendida en 7 ms;2026-10-18 12:34:58 INFO servicio peticion 34 atendida en 8 ms;2026-10-18 12:35:05 INFO servicio peticion 35 atendida en 9 ms;2026-10-18 12:36:12 INFO servicio peticion 36 atendida en 10 ms;2026-10-18 12:37:19 INFO servicio peticion 37 atendida en 11 ms;2026-10-18 12:38:26 INFO servicio peticion 38 atendida en 12 ms;2026-10-18 12:39:33 INFO servicio peticion 39 atendida en 0 ms;2026-10-18 12:40:40 INFO servicio peticion 40 atendida en 1 ms;2026-10-18 12:41:47 INFO servicio peticion 41 atendida en 2 ms;2026-10-18 12:42:54 INFO servicio peticion 42 atendida en 3 ms;2026-10-18 12:43:01 INFO servicio peticion 43 atendida en 4 ms;2026-10-18 12:44:08 INFO servicio peticion 44 atendida en 5 ms;2026-10-18 12:45:15 INFO servicio peticion 45 atendida en 6 ms;202"
+WRITE logs/web.log 3000 "web on 47 atendida en 8 ms;2026-10-18 12:48:36 INFO servicio peticion 48 atendida en 9 ms;2026-10-18 12:49:43 INFO servicio peticion 49 atendida en 10 ms;2026-10-18 12:50:50 INFO servicio peticion 50 atendida en 11 ms;2026-10-18 12:51:57 INFO servicio peticion 51 atendida en 12 ms;2026-10-18 12:52:04 INFO servicio peticion 52 atendida en 0 ms;2026-10-18 12:53:11 INFO servicio peticion 53 atendida en 1 ms;2026-10-18 12:54:18 INFO servicio peticion 54 atendida en 2 ms;2026-10-18 12:55:25 INFO servicio peticion 55 atendida en 3 ms;2026-10-18 12:56:32 INFO servicio peticion 56 atendida en 4 ms;2026-10-18 12:57:39 INFO servicio peticion 57 atendida en 5 ms;2026-10-18 12:58:46 INFO servicio peticion 58 atendida en 6 ms;2026-10-18 12:59:53 INFO servicio peticion 59 atendida en 7 ms;2026-10-18 12:00:00 INFO servicio peticion 60 atendida en 8 ms;2026-10-18 12:01:07 INFO servicio peticion 61 atendida "
+WRITE logs/web.log 4000 "web vicio peticion 63 atendida en 11 ms;2026-10-18 12:04:28 INFO servicio peticion 64 atendida en 12 ms;2026-10-18 12:05:35 INFO servicio peticion 65 atendida en 0 ms;2026-10-18 12:06:42 INFO servicio peticion 66 atendida en 1 ms;2026-10-18 12:07:49 INFO servicio peticion 67 atendida en 2 ms;2026-10-18 12:08:56 INFO servicio peticion 68 atendida en 3 ms;2026-10-18 12:09:03 INFO servicio peticion 69 atendida en 4 ms;2026-10-18 12:10:10 INFO servicio peticion 70 atendida en 5 ms;2026-10-18 12:11:17 INFO servicio peticion 71 atendida en 6 ms;2026-10-18 12:12:24 INFO servicio peticion 72 atendida en 7 ms;2026-10-18 12:13:31 INFO servicio peticion 73 atendida en 8 ms;2026-10-18 12:14:38 INFO servicio peticion 74 atendida en 9 ms;2026-10-18 12:15:45 INFO servicio peticion 75 atendida en 10 ms;2026-10-18 12:16:52 INFO servicio peticion 76 atendida en 11 ms;2026-10-18 12:17:59 INFO servicio peticion"
+WRITE logs/web.log 5000 "web 9:13 INFO servicio peticion 79 atendida en 1 ms;2026-10-18 12:20:20 INFO servicio peticion 80 atendida en 2 ms;2026-10-18 12:21:27 INFO servicio peticion 81 atendida en 3 ms;2026-10-18 12:22:34 INFO servicio peticion 82 atendida en 4 ms;2026-10-18 12:23:41 INFO servicio peticion 83 atendida en 5 ms;2026-10-18 12:24:48 INFO servicio peticion 84 atendida en 6 ms;2026-10-18 12:25:55 INFO servicio peticion 85 atendida en 7 ms;2026-10-18 12:26:02 INFO servicio peticion 86 atendida en 8 ms;2026-10-18 12:27:09 INFO servicio peticion 87 atendida en 9 ms;2026-10-18 12:28:16 INFO servicio peticion 88 atendida en 10 ms;2026-10-18 12:29:23 INFO servicio peticion 89 atendida en 11 ms;2026-10-18 12:30:30 INFO servicio peticion 90 atendida en 12 ms;2026-10-18 12:31:37 INFO servicio peticion 91 atendida en 0 ms;2026-10-18 12:32:44 INFO servicio peticion 92 atendida en 1 ms;2026-10-18 12:33:51 INFO servi"
+CREATE logs/db.log 6000
+WRITE logs/db.log 0 "db 2026-10-18 12:00:00 INFO servicio peticion 0 atendida en 0 ms;2026-10-18 12:01:07 INFO servicio peticion 1 atendida en 1 ms;2026-10-18 12:02:14 INFO servicio peticion 2 atendida en 2 ms;2026-10-18 12:03:21 INFO servicio peticion 3 atendida en 3 ms;2026-10-18 12:04:28 INFO servicio peticion 4 atendida en 4 ms;2026-10-18 12:05:35 INFO servicio peticion 5 atendida en 5 ms;2026-10-18 12:06:42 INFO servicio peticion 6 atendida en 6 ms;2026-10-18 12:07:49 INFO servicio peticion 7 atendida en 7 ms;2026-10-18 12:08:56 INFO servicio peticion 8 atendida en 8 ms;2026-10-18 12:09:03 INFO servicio peticion 9 atendida en 9 ms;2026-10-18 12:10:10 INFO servicio peticion 10 atendida en 10 ms;2026-10-18 12:11:17 INFO servicio peticion 11 atendida en 11 ms;2026-10-18 12:12:24 INFO servicio peticion 12 atendida en 12 ms;2026-10-18 12:13:31 INFO servicio peticion 13 atendida en 0 ms;2026-10-18 12:14:38 INFO "
+WRITE logs/db.log 1000 "db ;2026-10-18 12:16:52 INFO servicio peticion 16 atendida en 3 ms;2026-10-18 12:17:59 INFO servicio peticion 17 atendida en 4 ms;2026-10-18 12:18:06 INFO servicio peticion 18 atendida en 5 ms;2026-10-18 12:19:13 INFO servicio peticion 19 atendida en 6 ms;2026-10-18 12:20:20 INFO servicio peticion 20 atendida en 7 ms;2026-10-18 12:21:27 INFO servicio peticion 21 atendida en 8 ms;2026-10-18 12:22:34 INFO servicio peticion 22 atendida en 9 ms;2026-10-18 12:23:41 INFO servicio peticion 23 atendida en 10 ms;2026-10-18 12:24:48 INFO servicio peticion 24 atendida en 11 ms;2026-10-18 12:25:55 INFO servicio peticion 25 atendida en 12 ms;2026-10-18 12:26:02 INFO servicio peticion 26 atendida en 0 ms;2026-10-18 12:27:09 INFO servicio peticion 27 atendida en 1 ms;2026-10-18 12:28:16 INFO servicio peticion 28 atendida en 2 ms;2026-10-18 12:29:23 INFO servicio peticion 29 atendida en 3 ms;2026-10-18 12:"
+WRITE logs/db.log 2000 "db ida en 5 ms;2026-10-18 12:32:44 INFO servicio peticion 32 atendida en 6 ms;2026-10-18 12:33:51 INFO servicio peticion 33 atendida en 7 ms;2026-10-18 12:34:58 INFO servicio peticion 34 atendida en 8 ms;2026-10-18 12:35:05 INFO servicio peticion 35 atendida en 9 ms;2026-10-18 12:36:12 INFO servicio peticion 36 atendida en 10 ms;2026-10-18 12:37:19 INFO servicio peticion 37 atendida en 11 ms;2026-10-18 12:38:26 INFO servicio peticion 38 atendida en 12 ms;2026-10-18 12:39:33 INFO servicio peticion 39 atendida en 0 ms;2026-10-18 12:40:40 INFO servicio peticion 40 atendida en 1 ms;2026-10-18 12:41:47 INFO servicio peticion 41 atendida en 2 ms;2026-10-18 12:42:54 INFO servicio peticion 42 atendida en 3 ms;2026-10-18 12:43:01 INFO servicio peticion 43 atendida en 4 ms;2026-10-18 12:44:08 INFO servicio peticion 44 atendida en 5 ms;2026-10-18 12:45:15 INFO servicio peticion 45 atendida en 6 ms;202"
+WRITE logs/db.log 3000 "db on 47 atendida en 8 ms;2026-10-18 12:48:36 INFO servicio peticion 48 atendida en 9 ms;2026-10-18 12:49:43 INFO servicio peticion 49 atendida en 10 ms;2026-10-18 12:50:50 INFO servicio peticion 50 atendida en 11 ms;2026-10-18 12:51:57 INFO servicio peticion 51 atendida en 12 ms;2026-10-18 12:52:04 INFO servicio peticion 52 atendida en 0 ms;2026-10-18 12:53:11 INFO servicio peticion 53 atendida en 1 ms;2026-10-18 12:54:18 INFO servicio peticion 54 atendida en 2 ms;2026-10-18 12:55:25 INFO servicio peticion 55 atendida en 3 ms;2026-10-18 12:56:32 INFO servicio peticion 56 atendida en 4 ms;2026-10-18 12:57:39 INFO servicio peticion 57 atendida en 5 ms;2026-10-18 12:58:46 INFO servicio peticion 58 atendida en 6 ms;2026-10-18 12:59:53 INFO servicio peticion 59 atendida en 7 ms;2026-10-18 12:00:00 INFO servicio peticion 60 atendida en 8 ms;2026-10-18 12:01:07 INFO servicio peticion 61 atendida "
+WRITE logs/db.log 4000 "db vicio peticion 63 atendida en 11 ms;2026-10-18 12:04:28 INFO servicio peticion 64 atendida en 12 ms;2026-10-18 12:05:35 INFO servicio peticion 65 atendida en 0 ms;2026-10-18 12:06:42 INFO servicio peticion 66 atendida en 1 ms;2026-10-18 12:07:49 INFO servicio peticion 67 atendida en 2 ms;2026-10-18 12:08:56 INFO servicio peticion 68 atendida en 3 ms;2026-10-18 12:09:03 INFO servicio peticion 69 atendida en 4 ms;2026-10-18 12:10:10 INFO servicio peticion 70 atendida en 5 ms;2026-10-18 12:11:17 INFO servicio peticion 71 atendida en 6 ms;2026-10-18 12:12:24 INFO servicio peticion 72 atendida en 7 ms;2026-10-18 12:13:31 INFO servicio peticion 73 atendida en 8 ms;2026-10-18 12:14:38 INFO servicio peticion 74 atendida en 9 ms;2026-10-18 12:15:45 INFO servicio peticion 75 atendida en 10 ms;2026-10-18 12:16:52 INFO servicio peticion 76 atendida en 11 ms;2026-10-18 12:17:59 INFO servicio peticion"
+WRITE logs/db.log 5000 "db 9:13 INFO servicio peticion 79 atendida en 1 ms;2026-10-18 12:20:20 INFO servicio peticion 80 atendida en 2 ms;2026-10-18 12:21:27 INFO servicio peticion 81 atendida en 3 ms;2026-10-18 12:22:34 INFO servicio peticion 82 atendida en 4 ms;2026-10-18 12:23:41 INFO servicio peticion 83 atendida en 5 ms;2026-10-18 12:24:48 INFO servicio peticion 84 atendida en 6 ms;2026-10-18 12:25:55 INFO servicio peticion 85 atendida en 7 ms;2026-10-18 12:26:02 INFO servicio peticion 86 atendida en 8 ms;2026-10-18 12:27:09 INFO servicio peticion 87 atendida en 9 ms;2026-10-18 12:28:16 INFO servicio peticion 88 atendida en 10 ms;2026-10-18 12:29:23 INFO servicio peticion 89 atendida en 11 ms;2026-10-18 12:30:30 INFO servicio peticion 90 atendida en 12 ms;2026-10-18 12:31:37 INFO servicio peticion 91 atendida en 0 ms;2026-10-18 12:32:44 INFO servicio peticion 92 atendida en 1 ms;2026-10-18 12:33:51 INFO servi"
+CREATE caliente.log 6000
+WRITE caliente.log 0 "2026-10-18 12:00:00 INFO servicio peticion 0 atendida en 0 ms;2026-10-18 12:01:07 INFO servicio peticion 1 atendida en 1 ms;2026-10-18 12:02:14 INFO servicio peticion 2 atendida en 2 ms;2026-10-18 12:03:21 INFO servicio peticion 3 atendida en 3 ms;2026-10-18 12:04:28 INFO servicio peticion 4 atendida en 4 ms;2026-10-18 12:05:35 INFO servicio peticion 5 atendida en 5 ms;2026-10-18 12:06:42 INFO servicio peticion 6 atendida en 6 ms;2026-10-18 12:07:49 INFO servicio peticion 7 atendida en 7 ms;2026-10-18 12:08:56 INFO servicio peticion 8 atendida en 8 ms;2026-10-18 12:09:03 INFO servicio peticion 9 atendida en 9 ms;2026-10-18 12:10:10 INFO servicio peticion 10 atendida en 10 ms;2026-10-18 12:11:17 INFO servicio peticion 11 atendida en 11 ms;"
+COLDPASS 1800
+WRITE caliente.log 5000 "sigue en uso"
+COLDPASS 1800
+LIST
+READ logs/web.log 1000 120
+READ logs/db.log 5000 40
+READ caliente.log 5000 12
+LIST
+COLDPASS 0
+LIST
+WRITE logs/app.log 0 "APP"
+READ logs/app.log 0 40
+DELETE logs/db.log
+LIST
+EXIT
@@ -0,0 +1,8 @@
+CREATE a.log 3000
+WRITE a.log 0 "registro 1;registro 2;registro 3;registro 4;registro 5;registro 6;registro 7"
+CORRUPT 0
+CORRUPT 1
+COLDPASS 3600
+LIST
+READ a.log 0 10
+EXIT
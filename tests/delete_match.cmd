@@ -0,0 +1,19 @@
+CREATE logs/a.log 1500
+CREATE logs/b.log 700
+CREATE logs/sub/c.log 100
+CREATE datos/a.csv 2048
+CREATE datos/b.csv 100
+CREATE notas.txt 10
+WRITE datos/a.csv 1000 "se conserva"
+DELETE-MATCH logs/*.log
+LIST
+DELETE-MATCH *.zip
+DELETE-MATCH logs/*
+LIST
+CREATE logs/d.log 3000
+WRITE logs/d.log 2990 "nuevo log"
+READ logs/d.log 2990 9
+READ datos/a.csv 1000 11
+DELETE-MATCH *
+LIST
+EXIT
@@ -0,0 +1,49 @@
+CREATE cfg/u00.json 463
+WRITE cfg/u00.json 0 "{id:0,user:usuario0,email:usuario0@ejemplo.com,rol:admin,activo:true},{id:1,user:usuario1,email:usuario1@ejemplo.com,rol:editor,activo:true},{id:2,user:usuario2,email:usuario2@ejemplo.com,rol:viewer,activo:true},{id:3,user:usuario3,email:usuario3@ejemplo.com,rol:guest,activo:true},{id:4,user:usuario4,email:usuario4@ejemplo.com,rol:admin,activo:true},{id:5,user:usuario5,email:usuario5@ejemplo.com,rol:editor,activo:true},"
+CREATE cfg/u01.json 1070
+WRITE cfg/u01.json 0 "{id:37,user:usuario37,email:usuario37@ejemplo.com,rol:editor,activo:true},{id:38,user:usuario38,email:usuario38@ejemplo.com,rol:viewer,activo:true},{id:39,user:usuario39,email:usuario39@ejemplo.com,rol:guest,activo:true},{id:40,user:usuario40,email:usuario40@ejemplo.com,rol:admin,activo:true},{id:41,user:usuario41,email:usuario41@ejemplo.com,rol:editor,activo:true},{id:42,user:usuario42,email:usuario42@ejemplo.com,rol:viewer,activo:true},{id:43,user:usuario43,email:usuario43@ejemplo.com,rol:guest,activo:true},{id:44,user:usuario44,email:usuario44@ejemplo.com,rol:admin,activo:true},{id:45,user:usuario45,email:usuario45@ejemplo.com,rol:editor,activo:true},{id:46,user:usuario46,email:usuario46@ejemplo.com,rol:viewer,activo:true},{id:47,user:usuario47,email:usuario47@ejemplo.com,rol:guest,activo:true},{id:48,user:usuario48,email:usuario48@ejemplo.com,rol:admin,activo:true},{id:49,user:usuario49,email:usuario49@ejemplo.com,rol:editor,activo:true},{id:50,user:usuario50,email:usuario50@ejempl"
+WRITE cfg/u01.json 1000 "o.com,rol:viewer,activo:true},"
+CREATE cfg/u02.json 1657
+WRITE cfg/u02.json 0 "{id:74,user:usuario74,email:usuario74@ejemplo.com,rol:viewer,activo:true},{id:75,user:usuario75,email:usuario75@ejemplo.com,rol:guest,activo:true},{id:76,user:usuario76,email:usuario76@ejemplo.com,rol:admin,activo:true},{id:77,user:usuario77,email:usuario77@ejemplo.com,rol:editor,activo:true},{id:78,user:usuario78,email:usuario78@ejemplo.com,rol:viewer,activo:true},{id:79,user:usuario79,email:usuario79@ejemplo.com,rol:guest,activo:true},{id:80,user:usuario80,email:usuario80@ejemplo.com,rol:admin,activo:true},{id:81,user:usuario81,email:usuario81@ejemplo.com,rol:editor,activo:true},{id:82,user:usuario82,email:usuario82@ejemplo.com,rol:viewer,activo:true},{id:83,user:usuario83,email:usuario83@ejemplo.com,rol:guest,activo:true},{id:84,user:usuario84,email:usuario84@ejemplo.com,rol:admin,activo:true},{id:85,user:usuario85,email:usuario85@ejemplo.com,rol:editor,activo:true},{id:86,user:usuario86,email:usuario86@ejemplo.com,rol:viewer,activo:true},{id:87,user:usuario87,email:usuario87@ejempl"
+WRITE cfg/u02.json 1000 "o.com,rol:guest,activo:true},{id:88,user:usuario88,email:usuario88@ejemplo.com,rol:admin,activo:true},{id:89,user:usuario89,email:usuario89@ejemplo.com,rol:editor,activo:true},{id:90,user:usuario90,email:usuario90@ejemplo.com,rol:viewer,activo:true},{id:91,user:usuario91,email:usuario91@ejemplo.com,rol:guest,activo:true},{id:92,user:usuario92,email:usuario92@ejemplo.com,rol:admin,activo:true},{id:93,user:usuario93,email:usuario93@ejemplo.com,rol:editor,activo:true},{id:94,user:usuario94,email:usuario94@ejemplo.com,rol:viewer,activo:true},{id:95,user:usuario95,email:usuario95@ejemplo.com,rol:guest,activo:true},"
+CREATE cfg/u03.json 498
+WRITE cfg/u03.json 0 "{id:111,user:usuario111,email:usuario111@ejemplo.com,rol:guest,activo:true},{id:112,user:usuario112,email:usuario112@ejemplo.com,rol:admin,activo:true},{id:113,user:usuario113,email:usuario113@ejemplo.com,rol:editor,activo:true},{id:114,user:usuario114,email:usuario114@ejemplo.com,rol:viewer,activo:true},{id:115,user:usuario115,email:usuario115@ejemplo.com,rol:guest,activo:true},{id:116,user:usuario116,email:usuario116@ejemplo.com,rol:admin,activo:true},"
+CREATE cfg/u04.json 1111
+WRITE cfg/u04.json 0 "{id:148,user:usuario148,email:usuario148@ejemplo.com,rol:admin,activo:true},{id:149,user:usuario149,email:usuario149@ejemplo.com,rol:editor,activo:true},{id:150,user:usuario150,email:usuario150@ejemplo.com,rol:viewer,activo:true},{id:151,user:usuario151,email:usuario151@ejemplo.com,rol:guest,activo:true},{id:152,user:usuario152,email:usuario152@ejemplo.com,rol:admin,activo:true},{id:153,user:usuario153,email:usuario153@ejemplo.com,rol:editor,activo:true},{id:154,user:usuario154,email:usuario154@ejemplo.com,rol:viewer,activo:true},{id:155,user:usuario155,email:usuario155@ejemplo.com,rol:guest,activo:true},{id:156,user:usuario156,email:usuario156@ejemplo.com,rol:admin,activo:true},{id:157,user:usuario157,email:usuario157@ejemplo.com,rol:editor,activo:true},{id:158,user:usuario158,email:usuario158@ejemplo.com,rol:viewer,activo:true},{id:159,user:usuario159,email:usuario159@ejemplo.com,rol:guest,activo:true},{id:160,user:usuario160,email:usuario160@ejemplo.com,rol:admin,activo:true},{id:16"
+WRITE cfg/u04.json 1000 "1,user:usuario161,email:usuario161@ejemplo.com,rol:editor,activo:true},"
+CREATE cfg/u05.json 1724
+WRITE cfg/u05.json 0 "{id:185,user:usuario185,email:usuario185@ejemplo.com,rol:editor,activo:true},{id:186,user:usuario186,email:usuario186@ejemplo.com,rol:viewer,activo:true},{id:187,user:usuario187,email:usuario187@ejemplo.com,rol:guest,activo:true},{id:188,user:usuario188,email:usuario188@ejemplo.com,rol:admin,activo:true},{id:189,user:usuario189,email:usuario189@ejemplo.com,rol:editor,activo:true},{id:190,user:usuario190,email:usuario190@ejemplo.com,rol:viewer,activo:true},{id:191,user:usuario191,email:usuario191@ejemplo.com,rol:guest,activo:true},{id:192,user:usuario192,email:usuario192@ejemplo.com,rol:admin,activo:true},{id:193,user:usuario193,email:usuario193@ejemplo.com,rol:editor,activo:true},{id:194,user:usuario194,email:usuario194@ejemplo.com,rol:viewer,activo:true},{id:195,user:usuario195,email:usuario195@ejemplo.com,rol:guest,activo:true},{id:196,user:usuario196,email:usuario196@ejemplo.com,rol:admin,activo:true},{id:197,user:usuario197,email:usuario197@ejemplo.com,rol:editor,activo:true},{id:1"
+WRITE cfg/u05.json 1000 "98,user:usuario198,email:usuario198@ejemplo.com,rol:viewer,activo:true},{id:199,user:usuario199,email:usuario199@ejemplo.com,rol:guest,activo:true},{id:200,user:usuario200,email:usuario200@ejemplo.com,rol:admin,activo:true},{id:201,user:usuario201,email:usuario201@ejemplo.com,rol:editor,activo:true},{id:202,user:usuario202,email:usuario202@ejemplo.com,rol:viewer,activo:true},{id:203,user:usuario203,email:usuario203@ejemplo.com,rol:guest,activo:true},{id:204,user:usuario204,email:usuario204@ejemplo.com,rol:admin,activo:true},{id:205,user:usuario205,email:usuario205@ejemplo.com,rol:editor,activo:true},{id:206,user:usuario206,email:usuario206@ejemplo.com,rol:viewer,activo:true},"
+CREATE cfg/u06.json 499
+WRITE cfg/u06.json 0 "{id:222,user:usuario222,email:usuario222@ejemplo.com,rol:viewer,activo:true},{id:223,user:usuario223,email:usuario223@ejemplo.com,rol:guest,activo:true},{id:224,user:usuario224,email:usuario224@ejemplo.com,rol:admin,activo:true},{id:225,user:usuario225,email:usuario225@ejemplo.com,rol:editor,activo:true},{id:226,user:usuario226,email:usuario226@ejemplo.com,rol:viewer,activo:true},{id:227,user:usuario227,email:usuario227@ejemplo.com,rol:guest,activo:true},"
+CREATE cfg/u07.json 1110
+WRITE cfg/u07.json 0 "{id:259,user:usuario259,email:usuario259@ejemplo.com,rol:guest,activo:true},{id:260,user:usuario260,email:usuario260@ejemplo.com,rol:admin,activo:true},{id:261,user:usuario261,email:usuario261@ejemplo.com,rol:editor,activo:true},{id:262,user:usuario262,email:usuario262@ejemplo.com,rol:viewer,activo:true},{id:263,user:usuario263,email:usuario263@ejemplo.com,rol:guest,activo:true},{id:264,user:usuario264,email:usuario264@ejemplo.com,rol:admin,activo:true},{id:265,user:usuario265,email:usuario265@ejemplo.com,rol:editor,activo:true},{id:266,user:usuario266,email:usuario266@ejemplo.com,rol:viewer,activo:true},{id:267,user:usuario267,email:usuario267@ejemplo.com,rol:guest,activo:true},{id:268,user:usuario268,email:usuario268@ejemplo.com,rol:admin,activo:true},{id:269,user:usuario269,email:usuario269@ejemplo.com,rol:editor,activo:true},{id:270,user:usuario270,email:usuario270@ejemplo.com,rol:viewer,activo:true},{id:271,user:usuario271,email:usuario271@ejemplo.com,rol:guest,activo:true},{id:27"
+WRITE cfg/u07.json 1000 "2,user:usuario272,email:usuario272@ejemplo.com,rol:admin,activo:true},"
+CREATE cfg/u08.json 1723
+WRITE cfg/u08.json 0 "{id:296,user:usuario296,email:usuario296@ejemplo.com,rol:admin,activo:true},{id:297,user:usuario297,email:usuario297@ejemplo.com,rol:editor,activo:true},{id:298,user:usuario298,email:usuario298@ejemplo.com,rol:viewer,activo:true},{id:299,user:usuario299,email:usuario299@ejemplo.com,rol:guest,activo:true},{id:300,user:usuario300,email:usuario300@ejemplo.com,rol:admin,activo:true},{id:301,user:usuario301,email:usuario301@ejemplo.com,rol:editor,activo:true},{id:302,user:usuario302,email:usuario302@ejemplo.com,rol:viewer,activo:true},{id:303,user:usuario303,email:usuario303@ejemplo.com,rol:guest,activo:true},{id:304,user:usuario304,email:usuario304@ejemplo.com,rol:admin,activo:true},{id:305,user:usuario305,email:usuario305@ejemplo.com,rol:editor,activo:true},{id:306,user:usuario306,email:usuario306@ejemplo.com,rol:viewer,activo:true},{id:307,user:usuario307,email:usuario307@ejemplo.com,rol:guest,activo:true},{id:308,user:usuario308,email:usuario308@ejemplo.com,rol:admin,activo:true},{id:30"
+WRITE cfg/u08.json 1000 "9,user:usuario309,email:usuario309@ejemplo.com,rol:editor,activo:true},{id:310,user:usuario310,email:usuario310@ejemplo.com,rol:viewer,activo:true},{id:311,user:usuario311,email:usuario311@ejemplo.com,rol:guest,activo:true},{id:312,user:usuario312,email:usuario312@ejemplo.com,rol:admin,activo:true},{id:313,user:usuario313,email:usuario313@ejemplo.com,rol:editor,activo:true},{id:314,user:usuario314,email:usuario314@ejemplo.com,rol:viewer,activo:true},{id:315,user:usuario315,email:usuario315@ejemplo.com,rol:guest,activo:true},{id:316,user:usuario316,email:usuario316@ejemplo.com,rol:admin,activo:true},{id:317,user:usuario317,email:usuario317@ejemplo.com,rol:editor,activo:true},"
+CREATE cfg/u09.json 500
+WRITE cfg/u09.json 0 "{id:333,user:usuario333,email:usuario333@ejemplo.com,rol:editor,activo:true},{id:334,user:usuario334,email:usuario334@ejemplo.com,rol:viewer,activo:true},{id:335,user:usuario335,email:usuario335@ejemplo.com,rol:guest,activo:true},{id:336,user:usuario336,email:usuario336@ejemplo.com,rol:admin,activo:true},{id:337,user:usuario337,email:usuario337@ejemplo.com,rol:editor,activo:true},{id:338,user:usuario338,email:usuario338@ejemplo.com,rol:viewer,activo:true},"
+CREATE cfg/u10.json 1111
+WRITE cfg/u10.json 0 "{id:370,user:usuario370,email:usuario370@ejemplo.com,rol:viewer,activo:true},{id:371,user:usuario371,email:usuario371@ejemplo.com,rol:guest,activo:true},{id:372,user:usuario372,email:usuario372@ejemplo.com,rol:admin,activo:true},{id:373,user:usuario373,email:usuario373@ejemplo.com,rol:editor,activo:true},{id:374,user:usuario374,email:usuario374@ejemplo.com,rol:viewer,activo:true},{id:375,user:usuario375,email:usuario375@ejemplo.com,rol:guest,activo:true},{id:376,user:usuario376,email:usuario376@ejemplo.com,rol:admin,activo:true},{id:377,user:usuario377,email:usuario377@ejemplo.com,rol:editor,activo:true},{id:378,user:usuario378,email:usuario378@ejemplo.com,rol:viewer,activo:true},{id:379,user:usuario379,email:usuario379@ejemplo.com,rol:guest,activo:true},{id:380,user:usuario380,email:usuario380@ejemplo.com,rol:admin,activo:true},{id:381,user:usuario381,email:usuario381@ejemplo.com,rol:editor,activo:true},{id:382,user:usuario382,email:usuario382@ejemplo.com,rol:viewer,activo:true},{id:3"
+WRITE cfg/u10.json 1000 "83,user:usuario383,email:usuario383@ejemplo.com,rol:guest,activo:true},"
+CREATE cfg/u11.json 1722
+WRITE cfg/u11.json 0 "{id:407,user:usuario407,email:usuario407@ejemplo.com,rol:guest,activo:true},{id:408,user:usuario408,email:usuario408@ejemplo.com,rol:admin,activo:true},{id:409,user:usuario409,email:usuario409@ejemplo.com,rol:editor,activo:true},{id:410,user:usuario410,email:usuario410@ejemplo.com,rol:viewer,activo:true},{id:411,user:usuario411,email:usuario411@ejemplo.com,rol:guest,activo:true},{id:412,user:usuario412,email:usuario412@ejemplo.com,rol:admin,activo:true},{id:413,user:usuario413,email:usuario413@ejemplo.com,rol:editor,activo:true},{id:414,user:usuario414,email:usuario414@ejemplo.com,rol:viewer,activo:true},{id:415,user:usuario415,email:usuario415@ejemplo.com,rol:guest,activo:true},{id:416,user:usuario416,email:usuario416@ejemplo.com,rol:admin,activo:true},{id:417,user:usuario417,email:usuario417@ejemplo.com,rol:editor,activo:true},{id:418,user:usuario418,email:usuario418@ejemplo.com,rol:viewer,activo:true},{id:419,user:usuario419,email:usuario419@ejemplo.com,rol:guest,activo:true},{id:42"
+WRITE cfg/u11.json 1000 "0,user:usuario420,email:usuario420@ejemplo.com,rol:admin,activo:true},{id:421,user:usuario421,email:usuario421@ejemplo.com,rol:editor,activo:true},{id:422,user:usuario422,email:usuario422@ejemplo.com,rol:viewer,activo:true},{id:423,user:usuario423,email:usuario423@ejemplo.com,rol:guest,activo:true},{id:424,user:usuario424,email:usuario424@ejemplo.com,rol:admin,activo:true},{id:425,user:usuario425,email:usuario425@ejemplo.com,rol:editor,activo:true},{id:426,user:usuario426,email:usuario426@ejemplo.com,rol:viewer,activo:true},{id:427,user:usuario427,email:usuario427@ejemplo.com,rol:guest,activo:true},{id:428,user:usuario428,email:usuario428@ejemplo.com,rol:admin,activo:true},"
+CREATE grande.bin 9000
+WRITE grande.bin 8990 "no cabe"
+TRAINDICT cfg/*
+LIST
+READ cfg/u00.json 0 80
+READ cfg/u05.json 0 80
+READ cfg/u11.json 0 80
+READ cfg/u07.json 300 60
+WRITE cfg/u03.json 0 "{id:111,user:usuario111,email:usuario111@ejemplo.com,rol:guest,activo:true},{id:112,user:usuario112,email:usuario112@ejemplo.com,rol:admin,activo:true},{id:113,user:usuario113,email:usuario113@ejemplo.com,rol:editor,activo:true},{id:114,user:usuario114,email:usuario114@ejemplo.com,rol:viewer,activo:true},{id:115,user:usuario115,email:usuario115@ejemplo.com,rol:guest,activo:true},{id:116,user:usuario116,email:usuario116@ejemplo.com,rol:admin,activo:true},"
+READ cfg/u03.json 0 40
+TRAINDICT nada/*
+TRAINDICT
+LIST
+READ cfg/u03.json 0 40
+READ grande.bin 8990 7
+DELETE cfg/u05.json
+EXIT
@@ -0,0 +1,14 @@
+CREATE a.json 300
+WRITE a.json 0 "{nombre:uno,valor:1,activo:true}"
+CREATE b.json 300
+WRITE b.json 0 "{nombre:dos,valor:2,activo:true}"
+CREATE c.json 300
+WRITE c.json 0 "{nombre:tres,valor:3,activo:true}"
+CREATE d.json 300
+WRITE d.json 0 "{nombre:cuatro,valor:4,activo:true}"
+CORRUPT 0
+CORRUPT 1
+TRAINDICT *.json
+READ c.json 0 32
+READ d.json 0 34
+EXIT
@@ -0,0 +1,129 @@
+CREATE f00.dat 512
+WRITE f00.dat 0 "archivo 00"
+CREATE f01.dat 512
+WRITE f01.dat 0 "archivo 01"
+CREATE f02.dat 512
+WRITE f02.dat 0 "archivo 02"
+CREATE f03.dat 512
+WRITE f03.dat 0 "archivo 03"
+CREATE f04.dat 512
+WRITE f04.dat 0 "archivo 04"
+CREATE f05.dat 512
+WRITE f05.dat 0 "archivo 05"
+CREATE f06.dat 512
+WRITE f06.dat 0 "archivo 06"
+CREATE f07.dat 512
+WRITE f07.dat 0 "archivo 07"
+CREATE f08.dat 512
+WRITE f08.dat 0 "archivo 08"
+CREATE f09.dat 512
+WRITE f09.dat 0 "archivo 09"
+CREATE f10.dat 512
+WRITE f10.dat 0 "archivo 10"
+CREATE f11.dat 512
+WRITE f11.dat 0 "archivo 11"
+CREATE f12.dat 512
+WRITE f12.dat 0 "archivo 12"
+CREATE f13.dat 512
+WRITE f13.dat 0 "archivo 13"
+CREATE f14.dat 512
+WRITE f14.dat 0 "archivo 14"
+CREATE f15.dat 512
+WRITE f15.dat 0 "archivo 15"
+CREATE f16.dat 512
+WRITE f16.dat 0 "archivo 16"
+CREATE f17.dat 512
+WRITE f17.dat 0 "archivo 17"
+CREATE f18.dat 512
+WRITE f18.dat 0 "archivo 18"
+CREATE f19.dat 512
+WRITE f19.dat 0 "archivo 19"
+CREATE f20.dat 512
+WRITE f20.dat 0 "archivo 20"
+CREATE f21.dat 512
+WRITE f21.dat 0 "archivo 21"
+CREATE f22.dat 512
+WRITE f22.dat 0 "archivo 22"
+CREATE f23.dat 512
+WRITE f23.dat 0 "archivo 23"
+CREATE f24.dat 512
+WRITE f24.dat 0 "archivo 24"
+CREATE f25.dat 512
+WRITE f25.dat 0 "archivo 25"
+CREATE f26.dat 512
+WRITE f26.dat 0 "archivo 26"
+CREATE f27.dat 512
+WRITE f27.dat 0 "archivo 27"
+CREATE f28.dat 512
+WRITE f28.dat 0 "archivo 28"
+CREATE f29.dat 512
+WRITE f29.dat 0 "archivo 29"
+DELETE f00.dat
+DELETE f02.dat
+DELETE f04.dat
+DELETE f06.dat
+DELETE f08.dat
+DELETE f10.dat
+DELETE f12.dat
+DELETE f14.dat
+DELETE f16.dat
+DELETE f18.dat
+DELETE f20.dat
+DELETE f22.dat
+DELETE f24.dat
+DELETE f26.dat
+DELETE f28.dat
+CREATE grande.dat 12288
+WRITE grande.dat 440 "ahov29gnu18fmt07elsz6dkry5cjqx4bipw3ahov29gnu18fmt07elsz6dkry5cjqx4bipw3ahov29gnu18fmt07elsz6dkry5cjqx4bipw3ahov29gnu18fmt07elsz6dkry5cjqx4bipw3ahov29"
+WRITE grande.dat 1440 "bipw3ahov29gnu18fmt07elsz6dkry5cjqx4bipw3ahov29gnu18fmt07elsz6dkry5cjqx4bipw3ahov29gnu18fmt07elsz6dkry5cjqx4bipw3ahov29gnu18fmt07elsz6dkry5cjqx4bipw3a"
+WRITE grande.dat 2440 "cjqx4bipw3ahov29gnu18fmt07elsz6dkry5cjqx4bipw3ahov29gnu18fmt07elsz6dkry5cjqx4bipw3ahov29gnu18fmt07elsz6dkry5cjqx4bipw3ahov29gnu18fmt07elsz6dkry5cjqx4b"
+WRITE grande.dat 3440 "dkry5cjqx4bipw3ahov29gnu18fmt07elsz6dkry5cjqx4bipw3ahov29gnu18fmt07elsz6dkry5cjqx4bipw3ahov29gnu18fmt07elsz6dkry5cjqx4bipw3ahov29gnu18fmt07elsz6dkry5c"
+WRITE grande.dat 4440 "elsz6dkry5cjqx4bipw3ahov29gnu18fmt07elsz6dkry5cjqx4bipw3ahov29gnu18fmt07elsz6dkry5cjqx4bipw3ahov29gnu18fmt07elsz6dkry5cjqx4bipw3ahov29gnu18fmt07elsz6d"
+WRITE grande.dat 5440 "fmt07elsz6dkry5cjqx4bipw3ahov29gnu18fmt07elsz6dkry5cjqx4bipw3ahov29gnu18fmt07elsz6dkry5cjqx4bipw3ahov29gnu18fmt07elsz6dkry5cjqx4bipw3ahov29gnu18fmt07e"
+WRITE grande.dat 6440 "gnu18fmt07elsz6dkry5cjqx4bipw3ahov29gnu18fmt07elsz6dkry5cjqx4bipw3ahov29gnu18fmt07elsz6dkry5cjqx4bipw3ahov29gnu18fmt07elsz6dkry5cjqx4bipw3ahov29gnu18f"
+WRITE grande.dat 7440 "hov29gnu18fmt07elsz6dkry5cjqx4bipw3ahov29gnu18fmt07elsz6dkry5cjqx4bipw3ahov29gnu18fmt07elsz6dkry5cjqx4bipw3ahov29gnu18fmt07elsz6dkry5cjqx4bipw3ahov29g"
+WRITE grande.dat 8440 "ipw3ahov29gnu18fmt07elsz6dkry5cjqx4bipw3ahov29gnu18fmt07elsz6dkry5cjqx4bipw3ahov29gnu18fmt07elsz6dkry5cjqx4bipw3ahov29gnu18fmt07elsz6dkry5cjqx4bipw3ah"
+WRITE grande.dat 9440 "jqx4bipw3ahov29gnu18fmt07elsz6dkry5cjqx4bipw3ahov29gnu18fmt07elsz6dkry5cjqx4bipw3ahov29gnu18fmt07elsz6dkry5cjqx4bipw3ahov29gnu18fmt07elsz6dkry5cjqx4bi"
+WRITE grande.dat 10440 "kry5cjqx4bipw3ahov29gnu18fmt07elsz6dkry5cjqx4bipw3ahov29gnu18fmt07elsz6dkry5cjqx4bipw3ahov29gnu18fmt07elsz6dkry5cjqx4bipw3ahov29gnu18fmt07elsz6dkry5cj"
+WRITE grande.dat 11440 "lsz6dkry5cjqx4bipw3ahov29gnu18fmt07elsz6dkry5cjqx4bipw3ahov29gnu18fmt07elsz6dkry5cjqx4bipw3ahov29gnu18fmt07elsz6dkry5cjqx4bipw3ahov29gnu18fmt07elsz6dk"
+READ grande.dat 440 150
+READ grande.dat 1440 150
+READ grande.dat 2440 150
+READ grande.dat 3440 150
+READ grande.dat 4440 150
+READ grande.dat 5440 150
+READ grande.dat 6440 150
+READ grande.dat 7440 150
+READ grande.dat 8440 150
+READ grande.dat 9440 150
+READ grande.dat 10440 150
+READ grande.dat 11440 150
+READ f01.dat 0 10
+READ f03.dat 0 10
+READ f05.dat 0 10
+READ f07.dat 0 10
+READ f09.dat 0 10
+READ f11.dat 0 10
+READ f13.dat 0 10
+READ f15.dat 0 10
+READ f17.dat 0 10
+READ f19.dat 0 10
+READ f21.dat 0 10
+READ f23.dat 0 10
+READ f25.dat 0 10
+READ f27.dat 0 10
+READ f29.dat 0 10
+DELETE f01.dat
+DELETE f05.dat
+DELETE f09.dat
+DELETE f13.dat
+DELETE f17.dat
+DELETE f21.dat
+DELETE f25.dat
+DELETE f29.dat
+CREATE medio.dat 4000
+WRITE medio.dat 3450 "fmt07elsz6dkry5cjqx4bipw3ahov29gnu18fmt07elsz6dkry5cjqx4bipw3ahov29gnu18fmt07elsz6dkry5cjqx4bipw3ahov29gnu18fmt07elsz6dkry5cjqx4bipw3ahov29gnu18fmt07elsz6dkry5c"
+READ medio.dat 3450 160
+READ grande.dat 11440 150
+LIST
+EXIT
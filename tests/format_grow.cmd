@@ -0,0 +1,27 @@
+CREATE a.dat 20000
+WRITE a.dat 0 "datos viejos"
+CREATE b.dat 40000
+CREATE c.dat 10000
+GROW 0
+GROW 100000
+GROW 18014398509481985
+GROW 64
+CREATE c.dat 10000
+WRITE c.dat 9990 "final de c"
+READ c.dat 9990 10
+LIST
+FORMAT
+LIST
+READ a.dat 0 5
+CREATE a.dat 3000
+READ a.dat 0 5
+WRITE a.dat 0 "nueva generacion"
+READ a.dat 0 16
+CREATE nuevo.dat 60000
+LIST
+FORMAT
+FORMAT
+CREATE a.dat 100
+READ a.dat 0 10
+LIST
+EXIT
@@ -0,0 +1,9 @@
+CREATE a.dat 200000
+WRITE a.dat 0 "datos viejos"
+WRITE a.dat 150000 "mas datos"
+MEMSTAT
+FORMAT
+MEMSTAT
+CREATE a.dat 3000
+READ a.dat 0 5
+EXIT
@@ -0,0 +1,27 @@
+CREATE log.txt 8192
+LIST
+WRITE log.txt 0 "cabecera del registro"
+WRITE log.txt 2000 "bloque cuatro"
+WRITE log.txt 8000 "cola"
+PUNCH log.txt 512 3072
+READ log.txt 0 21
+READ log.txt 2000 13
+READ log.txt 8000 4
+LIST
+WRITE log.txt 2000 "reescrito tras el hueco"
+READ log.txt 2000 23
+PUNCH log.txt 0 8192
+READ log.txt 0 21
+LIST
+FALLOCATE log.txt 0 4096
+LIST
+WRITE log.txt 100 "reservado"
+READ log.txt 100 9
+FALLOCATE log.txt 4096 4096
+PUNCH log.txt 9000 10
+PUNCH nada.txt 0 10
+FALLOCATE log.txt 0 10000
+LIST
+DELETE log.txt
+LIST
+EXIT
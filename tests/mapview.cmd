@@ -0,0 +1,15 @@
+CREATE a.bin 4096
+WRITE a.bin 0 "vista contigua"
+WRITE a.bin 4080 "fin de pagina"
+MAPVIEW a.bin
+CREATE hueco.txt 100
+CREATE b.bin 9000
+WRITE b.bin 0 "segundo archivo"
+WRITE b.bin 8990 "final"
+MAPVIEW b.bin
+CORRUPT 0
+MAPVIEW a.bin
+COLDPASS 7200
+MAPVIEW a.bin
+MAPVIEW nada.txt
+EXIT
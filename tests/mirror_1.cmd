@@ -0,0 +1,13 @@
+CREATE logs/a.log 3000
+CREATE datos.bin 9000
+WRITE logs/a.log 0 "primera linea del registro"
+WRITE datos.bin 8000 "dato al final"
+CREATE temporal.txt 700
+WRITE temporal.txt 0 "se borra"
+DELETE temporal.txt
+PUNCH datos.bin 0 4096
+CREATE logs/b.log 100
+DELETE-MATCH logs/b*
+CORRUPT 0
+LIST
+EXIT
@@ -0,0 +1,9 @@
+LIST
+READ logs/a.log 0 26
+READ datos.bin 8000 13
+READ datos.bin 100 5
+READ temporal.txt 0 8
+CREATE nuevo.txt 600
+WRITE nuevo.txt 0 "tras montar"
+READ nuevo.txt 0 11
+EXIT
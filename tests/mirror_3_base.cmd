@@ -0,0 +1,6 @@
+READ logs/a.log 0 26
+WRITE logs/a.log 0 "capa superior"
+READ logs/a.log 0 26
+DELETE datos.bin
+LIST
+EXIT
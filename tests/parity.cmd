@@ -0,0 +1,12 @@
+CREATE a.dat 4096
+WRITE a.dat 0 "primer bloque del grupo"
+WRITE a.dat 1030 "tercer bloque, se danara"
+WRITE a.dat 3600 "ultimo bloque del grupo"
+CORRUPT 2
+READ a.dat 1030 24
+READ a.dat 0 23
+CORRUPT 2
+WRITE a.dat 1040 "escrito sobre bloque danado"
+READ a.dat 1030 37
+CORRUPT 5000
+EXIT
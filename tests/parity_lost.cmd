@@ -0,0 +1,14 @@
+CREATE a.dat 4096
+CREATE b.dat 4096
+WRITE a.dat 0 "primer bloque del grupo"
+WRITE a.dat 3600 "ultimo bloque del grupo"
+WRITE b.dat 10 "otro grupo"
+CORRUPT 7
+CORRUPT 0
+READ a.dat 3600 23
+READ a.dat 0 23
+CORRUPT 8
+CORRUPT 9
+CORRUPT 10
+READ b.dat 10 10
+EXIT
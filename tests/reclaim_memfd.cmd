@@ -0,0 +1,16 @@
+CREATE a.dat 20000
+WRITE a.dat 0 "primera pagina"
+WRITE a.dat 19000 "ultima pagina"
+MEMSTAT
+DELETE a.dat
+MEMSTAT
+CREATE b.dat 4000
+WRITE b.dat 10 "reutiliza paginas pendientes"
+CREATE c.dat 60000
+WRITE c.dat 59000 "final de c"
+DELETE c.dat
+MEMSTAT
+READ b.dat 10 28
+CREATE d.dat 60000
+READ d.dat 59000 10
+EXIT
@@ -0,0 +1,13 @@
+# Primario y réplica: la réplica arranca con la copia completa, recibe los
+# commits siguientes y rechaza los cambios. La sesión del primario se da
+# en línea; la salida comparada es la de la réplica.
+(
+    printf 'CREATE a.txt 1000\nWRITE a.txt 0 "hola replica"\nCREATE b.txt 5000\n'
+    sleep 2
+    printf 'WRITE a.txt 5 "mundo"\nDELETE b.txt\nCREATE c/d.txt 700\nWRITE c/d.txt 600 "tras conectar"\n'
+    sleep 3
+    printf 'EXIT\n'
+) | "$FS" --primary="$TMP/replica.sock" > /dev/null &
+sleep 1
+feed "$DIR/replica.session" | "$FS" --follow="$TMP/replica.sock"
+wait
@@ -0,0 +1,97 @@
+#!/bin/sh
+#
+# Pruebas de regresión: ejecuta cada sesión tests/<caso>.cmd con cada
+# configuración y compara la salida con tests/<caso>.out.
+#
+# - Sin tests/<caso>.flags, la sesión se ejecuta con todas las
+#   configuraciones de DEFAULT_FLAGS y todas deben dar la misma salida.
+# - Cada línea de tests/<caso>.flags es una configuración; $TMP se
+#   sustituye por un directorio temporal común a todos los casos, que se
+#   ejecutan en orden alfabético.
+# - En una sesión, "#sleep <s>" espera antes de enviar la línea siguiente
+#   y el resto de líneas que empiezan por '#' se ignoran.
+# - tests/<caso>.sh es un caso que lanza sus propios procesos (por
+#   ejemplo primario y réplica); se ejecuta con FS y TMP definidos y su
+#   salida se compara igual.
+#
+# Uso: tests/run.sh <ejecutable>
+
+FS=$1
+DIR=$(dirname "$0")
+if [ -z "$FS" ] || [ ! -x "$FS" ]; then
+    echo "Uso: $0 <ejecutable>" >&2
+    exit 2
+fi
+TMP=$(mktemp -d)
+trap 'rm -rf "$TMP"' EXIT
+
+DEFAULT_FLAGS='--policy=first-fit
+--policy=next-fit
+--policy=best-fit
+--policy=locality
+--policy=buddy
+--parity=1
+--parity=2 --policy=buddy
+--store=memfd
+--store=memfd --policy=locality --parity=2'
+
+# Envía una sesión al programa línea a línea
+feed() {
+    while IFS= read -r line; do
+        case $line in
+        '#sleep '*) sleep "${line#\#sleep }" ;;
+        '#'*) ;;
+        *) printf '%s\n' "$line" ;;
+        esac
+    done < "$1"
+}
+
+# Quita la cabecera (hasta la lista de comandos), las duraciones medidas y
+# las direcciones de las vistas de MAPVIEW
+normalize() {
+    sed -e '1,/^  EXIT$/d' -e 's/[0-9][0-9]*\.[0-9][0-9]* ms/<t> ms/g' -e 's/ en 0x[0-9a-f]*:/ en <dir>:/'
+}
+
+passed=0
+failed=0
+
+# Compara la salida de una ejecución con la esperada
+check() {
+    if diff -u "$2" "$TMP/salida" > "$TMP/diff"; then
+        passed=$((passed + 1))
+    else
+        failed=$((failed + 1))
+        echo "FALLO: $1"
+        cat "$TMP/diff"
+    fi
+}
+
+for test_file in "$DIR"/*.cmd "$DIR"/*.sh; do
+    [ -e "$test_file" ] || continue
+    case=${test_file%.*}
+    name=$(basename "$case")
+    [ "$name" = run ] && continue
+
+    if [ "${test_file##*.}" = sh ]; then
+        (. "$test_file") | normalize > "$TMP/salida"
+        check "$name" "$case.out"
+        continue
+    fi
+
+    if [ -f "$case.flags" ]; then
+        configs=$(cat "$case.flags")
+    else
+        configs=$DEFAULT_FLAGS
+    fi
+    echo "$configs" | while IFS= read -r flags; do
+        flags=$(echo "$flags" | sed "s|\\\$TMP|$TMP|g")
+        # shellcheck disable=SC2086
+        feed "$test_file" | "$FS" $flags 2>&1 | normalize > "$TMP/salida"
+        check "$name [$flags]" "$case.out"
+        echo "$passed $failed" > "$TMP/cuenta"
+    done
+    read -r passed failed < "$TMP/cuenta"
+done
+
+echo "$passed pruebas correctas, $failed fallidas."
+[ "$failed" -eq 0 ]
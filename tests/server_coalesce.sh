@@ -0,0 +1,53 @@
+# Coalescencia de READ con clientes que encadenan comandos (--pipeline):
+# cuatro clientes alternan escrituras en su archivo con lecturas repetidas
+# del suyo y de uno común. Las lecturas idénticas de un lote comparten
+# respuesta, pero nunca por encima de una escritura: cada cliente debe
+# obtener lo mismo que la misma sesión ejecutada sin servidor.
+SOCK=$TMP/coalescencia.sock
+"$FS" --serve="$SOCK" --loops=2 > "$TMP/servidor" 2>&1 &
+server=$!
+sleep 1
+printf 'CREATE comun.txt 600\nWRITE comun.txt 590 "compartido"\n' |
+    "$FS" --connect="$SOCK" > "$TMP/preparar"
+
+for c in 0 1 2 3; do
+    {
+        echo "CREATE c$c.txt 1000"
+        i=0
+        while [ $i -lt 100 ]; do
+            echo "WRITE c$c.txt 500 \"valor $i\""
+            echo "READ c$c.txt 500 9"
+            echo "READ comun.txt 590 10"
+            echo "READ c$c.txt 500 9"
+            i=$((i + 1))
+        done
+        echo "DELETE c$c.txt"
+        echo "READ c$c.txt 500 9"
+    } > "$TMP/sesion$c"
+done
+clients=
+for c in 0 1 2 3; do
+    if [ $((c % 2)) -eq 0 ]; then sock=$SOCK; else sock=$SOCK.1; fi
+    "$FS" --connect="$sock" --pipeline < "$TMP/sesion$c" > "$TMP/cliente$c" &
+    clients="$clients $!"
+done
+# shellcheck disable=SC2086
+wait $clients
+printf 'MEMSTAT\n' | "$FS" --connect="$SOCK" > "$TMP/memstat"
+kill -INT $server
+wait $server
+
+sed "s|$TMP|\$TMP|g" "$TMP/servidor"
+cat "$TMP/preparar"
+for c in 0 1 2 3; do
+    printf 'CREATE comun.txt 600\nWRITE comun.txt 590 "compartido"\n' | cat - "$TMP/sesion$c" |
+        "$FS" 2>&1 | sed -e '1,/^  EXIT$/d' -e 's/^> //' -e '/^$/d' | tail -n +3 > "$TMP/local$c"
+    grep -v '^\.$' "$TMP/cliente$c" > "$TMP/remoto$c"
+    if cmp -s "$TMP/local$c" "$TMP/remoto$c"; then
+        echo "Cliente $c: $(grep -c '^\.$' "$TMP/cliente$c") respuestas, iguales a la sesion local"
+    else
+        echo "Cliente $c: distinto de la sesion local"
+        diff "$TMP/local$c" "$TMP/remoto$c" | head -5
+    fi
+done
+awk '/READ atendidos/ { print "READ compartidos: " ($2 > 0 ? "si" : "no") }' "$TMP/memstat"
@@ -0,0 +1,34 @@
+# EXPORT con un cliente que encadena comandos (--pipeline): un archivo que
+# cruza el límite de bloque, una escritura enviada justo detrás del EXPORT
+# (los datos ya cargados en la tubería no deben cambiar), un archivo con
+# un hueco y uno comprimido por el nivel frío. Se repite con el almacén
+# anónimo y con memfd y se muestra la salida del primero; los tramos de
+# bytes no imprimibles (ceros) se resumen con su longitud.
+printf '%s\n' 'CREATE a.txt 600' 'WRITE a.txt 0 "inicio del archivo"' \
+    'WRITE a.txt 500 "cruza el limite entre bloques"' 'EXPORT a.txt' 'WRITE a.txt 0 "INICIO CAMBIADO!!!"' \
+    'EXPORT a.txt' 'CREATE h.txt 1100' 'WRITE h.txt 1090 "final"' 'PUNCH h.txt 0 1024' 'EXPORT h.txt' \
+    'COLDPASS 7200' 'EXPORT a.txt' 'EXPORT h.txt' 'READ a.txt 500 29' 'EXPORT nada.txt' > "$TMP/exportar"
+n=0
+for flags in '--cold=3600' '--cold=3600 --store=memfd --parity=1'; do
+    SOCK=$TMP/exportar$n.sock
+    # shellcheck disable=SC2086
+    "$FS" --serve="$SOCK" $flags > "$TMP/servidor$n" 2>&1 &
+    server=$!
+    sleep 1
+    "$FS" --connect="$SOCK" --pipeline < "$TMP/exportar" |
+        awk '{
+            out = ""
+            while (match($0, /\.\.\.\.\.\.\.\.+/)) {
+                out = out substr($0, 1, RSTART - 1) "<" RLENGTH " bytes>"
+                $0 = substr($0, RSTART + RLENGTH)
+            }
+            print out $0
+        }' > "$TMP/cliente$n"
+    kill -INT $server
+    wait $server
+    n=$((n + 1))
+done
+
+sed "s|$TMP|\$TMP|g" "$TMP/servidor0"
+cat "$TMP/cliente0"
+cmp -s "$TMP/cliente0" "$TMP/cliente1" || echo "Salida distinta con --store=memfd --parity=1"
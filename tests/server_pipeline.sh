@@ -0,0 +1,48 @@
+# Etapas del servidor con clientes que encadenan comandos (--pipeline):
+# las respuestas llegan en orden, los errores no cortan la conexión y las
+# líneas enviadas tras EXIT no se ejecutan. Cada cliente debe recibir lo
+# mismo que su sesión sin servidor, y el registro del servidor solo tiene
+# sus propios avisos: la salida de los comandos va a cada cliente.
+SOCK=$TMP/etapas.sock
+"$FS" --serve="$SOCK" --loops=2 > "$TMP/servidor" 2>&1 &
+server=$!
+sleep 1
+
+for c in 0 1; do
+    {
+        i=0
+        while [ $i -lt 10 ]; do
+            echo "CREATE d$c/f$i.txt $((100 + i * 300))"
+            echo "WRITE d$c/f$i.txt $((i * 300)) \"cliente $c archivo $i\""
+            i=$((i + 1))
+        done
+        echo "FOO d$c"
+        echo "READ d$c/f9.txt 2700 18"
+        echo "READ d$c/nada.txt 0 1"
+        echo "EXIT"
+        echo "DELETE-MATCH d$c/*"
+    } > "$TMP/sesion$c"
+done
+"$FS" --connect="$SOCK" --pipeline < "$TMP/sesion0" > "$TMP/cliente0" &
+first=$!
+"$FS" --connect="$SOCK.1" --pipeline < "$TMP/sesion1" > "$TMP/cliente1"
+wait $first
+printf 'LIST\n' | "$FS" --connect="$SOCK.1" > "$TMP/lista"
+kill -INT $server
+wait $server
+
+sed "s|$TMP|\$TMP|g" "$TMP/servidor"
+for c in 0 1; do
+    "$FS" < "$TMP/sesion$c" 2>&1 | sed -e '1,/^  EXIT$/d' -e 's/^> //' -e '/^$/d' > "$TMP/local$c"
+    grep -v '^\.$' "$TMP/cliente$c" > "$TMP/remoto$c"
+    if cmp -s "$TMP/local$c" "$TMP/remoto$c"; then
+        echo "Cliente $c: $(grep -c '^\.$' "$TMP/cliente$c") respuestas, iguales a la sesion local"
+    else
+        echo "Cliente $c: distinto de la sesion local"
+        diff "$TMP/local$c" "$TMP/remoto$c" | head -5
+    fi
+done
+tail -n 4 "$TMP/cliente0"
+# El orden de la lista depende de cómo se intercalaron los dos clientes
+grep '^d' "$TMP/lista" | sort
+grep '^Total' "$TMP/lista"
@@ -0,0 +1,37 @@
+# Servidor con dos bucles: ocho clientes, la mitad en cada socket, piden a
+# la vez el mismo READ. Los READ idénticos de un lote comparten una
+# respuesta cuyas referencias sueltan los hilos de respuesta de los dos
+# bucles; todos los clientes deben recibir la misma salida. Se muestra el
+# registro del servidor (con su cabecera) y después las comprobaciones.
+SOCK=$TMP/compartido.sock
+"$FS" --serve="$SOCK" --loops=2 > "$TMP/servidor" 2>&1 &
+server=$!
+sleep 1
+printf 'CREATE a.txt 600\nWRITE a.txt 0 "respuesta compartida"\n' |
+    "$FS" --connect="$SOCK" > "$TMP/preparar"
+
+i=0
+while [ $i -lt 300 ]; do
+    echo 'READ a.txt 0 20'
+    i=$((i + 1))
+done > "$TMP/lecturas"
+clients=
+for c in 0 1 2 3 4 5 6 7; do
+    if [ $((c % 2)) -eq 0 ]; then sock=$SOCK; else sock=$SOCK.1; fi
+    "$FS" --connect="$sock" < "$TMP/lecturas" > "$TMP/cliente$c" &
+    clients="$clients $!"
+done
+# shellcheck disable=SC2086
+wait $clients
+printf 'MEMSTAT\n' | "$FS" --connect="$SOCK" > "$TMP/memstat"
+kill -INT $server
+wait $server
+
+sed "s|$TMP|\$TMP|g" "$TMP/servidor"
+cat "$TMP/preparar"
+for c in 1 2 3 4 5 6 7; do
+    cmp -s "$TMP/cliente0" "$TMP/cliente$c" || echo "Cliente $c: salida distinta"
+done
+echo "Respuestas: $(grep -c '^\.$' "$TMP/cliente0")"
+sort -u "$TMP/cliente0"
+awk '/READ atendidos/ { print "READ compartidos: " ($2 > 0 ? "si" : "no") }' "$TMP/memstat"
@@ -0,0 +1,33 @@
+# WATCH en un servidor con dos bucles: el suscriptor está en el segundo
+# socket y los cambios llegan por el primero. Recibe los eventos de los
+# archivos que coinciden con sus patrones (una escritura por archivo, para
+# que la cuenta no dependa de cuándo se entregan) y ninguno tras UNWATCH.
+# Los eventos se muestran delante de la respuesta al comando siguiente.
+SOCK=$TMP/avisos.sock
+"$FS" --serve="$SOCK" --loops=2 > "$TMP/servidor" 2>&1 &
+server=$!
+sleep 1
+(
+    printf 'WATCH logs/*\nWATCH datos.bin\n'
+    sleep 2
+    printf 'UNWATCH\n'
+    sleep 2
+    printf 'READ logs/a.log 0 4\n'
+) | "$FS" --connect="$SOCK.1" > "$TMP/suscriptor" &
+watcher=$!
+sleep 1
+printf '%s\n' 'CREATE logs/a.log 1000' 'CREATE otro.txt 100' 'CREATE datos.bin 600' \
+    'WRITE logs/a.log 0 "hola"' 'WRITE otro.txt 0 "sin aviso"' 'CREATE logs/b.log 100' \
+    'WRITE datos.bin 10 "binario"' 'DELETE-MATCH logs/b*' |
+    "$FS" --connect="$SOCK" > "$TMP/escritor1"
+sleep 2
+printf 'WRITE logs/a.log 0 "tras UNWATCH"\nDELETE datos.bin\n' |
+    "$FS" --connect="$SOCK" > "$TMP/escritor2"
+wait $watcher
+kill -INT $server
+wait $server
+
+sed "s|$TMP|\$TMP|g" "$TMP/servidor"
+cat "$TMP/escritor1" "$TMP/escritor2"
+echo "Suscriptor:"
+cat "$TMP/suscriptor"
@@ -0,0 +1,18 @@
+# Slabs: cada escritura deja un registro para el espejo que se reserva en
+# un slab y se suelta al aplicarlo. Tras tres tandas de 300 escrituras
+# (más objetos de los que caben en un chunk) la memoria de los slabs no
+# crece: los objetos se reutilizan. Se omiten las líneas de cada WRITE.
+{
+    echo 'CREATE a.dat 60000'
+    for round in 1 2 3; do
+        i=0
+        while [ $i -lt 300 ]; do
+            echo "WRITE a.dat $((i * 150)) \"tanda $round escritura $i\""
+            i=$((i + 1))
+        done
+        echo '#sleep 1'
+        echo 'MEMSTAT'
+    done
+    echo 'READ a.dat 44850 21'
+} > "$TMP/slab.cmd"
+feed "$TMP/slab.cmd" | "$FS" --mirror="$TMP/slab.img" 2>&1 | grep -v '^> Escritos'
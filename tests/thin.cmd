@@ -0,0 +1,12 @@
+CREATE a.dat 8000
+CREATE b.dat 5000
+CREATE c.dat 2000
+CREATE d.dat 1000
+CREATE e.dat 2000
+DELETE b.dat
+CREATE e.dat 2000
+CREATE f.dat 4000
+GROW 64
+CREATE g.dat 1000
+LIST
+EXIT